@@ -0,0 +1,988 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <json.hpp>
+#include <dsp/bench/speed_tester.h>
+#include <dsp/taps/windowed_sinc.h>
+#include <dsp/taps/low_pass.h>
+#include <dsp/window/nuttall.h>
+#include <dsp/filter/fir.h>
+#include <dsp/filter/fft_fir.h>
+#include <dsp/filter/decimating_fir.h>
+#include <dsp/filter/deephasis.h>
+#include <dsp/multirate/power_decimator.h>
+#include <dsp/multirate/raw_decimator.h>
+#include <dsp/multirate/decim/kernels.h>
+#include <dsp/multirate/rational_resampler.h>
+#include <dsp/channel/frequency_xlator.h>
+#include <dsp/channel/rx_vfo.h>
+#include <dsp/channel/channelizer.h>
+#include <dsp/demod/quadrature.h>
+#include <dsp/demod/broadcast_fm.h>
+#include <dsp/demod/fm.h>
+#include <dsp/demod/am.h>
+#include <dsp/demod/ssb.h>
+#include <dsp/demod/psk.h>
+#include <dsp/loop/agc.h>
+#include <dsp/loop/fast_agc.h>
+#include <dsp/clock_recovery/mm.h>
+#include <dsp/correction/dc_blocker.h>
+#include <dsp/noise_reduction/noise_blanker.h>
+#include <dsp/noise_reduction/fm_if.h>
+#include <dsp/compression/sample_stream_compressor.h>
+#include <dsp/compression/sample_stream_decompressor.h>
+
+using nlohmann::json;
+
+// Default duration of each benchmark
+#define BENCH_DEFAULT_DURATION_MS   500
+
+// Default slowdown in percent above which a result is reported as a regression
+#define BENCH_DEFAULT_THRESHOLD     10.0
+
+// Default chunk size, about what a VFO gets at common samplerates
+#define BENCH_DEFAULT_CHUNK         8192
+
+struct Result {
+    double msps;
+    double nsPerSample;
+    double cyclesPerSample;
+};
+
+struct Case {
+    std::string name;
+    std::function<Result(int durationMs)> run;
+};
+
+// A check returns an empty string if the block behaves as expected, or what went wrong
+struct Check {
+    std::string name;
+    std::function<std::string()> run;
+};
+
+std::vector<Case> cases;
+std::vector<Check> checks;
+
+void addCase(std::string name, std::function<Result(int durationMs)> run) {
+    cases.push_back({ name, run });
+}
+
+void addCheck(std::string name, std::function<std::string()> run) {
+    checks.push_back({ name, run });
+}
+
+// Measure the input rate of a block by running it between a speed tester's streams
+template <class I, class O>
+Result measure(dsp::block& blk, dsp::stream<I>* in, dsp::stream<O>* out, int durationMs, int chunk, const I* data = NULL) {
+    dsp::bench::SpeedTester<I, O> tester(in, out);
+    blk.start();
+    double rate = data ? tester.benchmark(durationMs, data, chunk) : tester.benchmark(durationMs, chunk);
+    blk.stop();
+
+    Result res;
+    res.msps = rate / 1e6;
+    res.nsPerSample = (rate > 0.0) ? 1e9 / rate : 0.0;
+    res.cyclesPerSample = tester.getSampleCount() ? (double)tester.getCycles() / (double)tester.getSampleCount() : 0.0;
+    return res;
+}
+
+// Send chunks through a running block and wait until it has output outCount samples, returns the number it output
+template <class I, class O>
+uint64_t feed(dsp::block& blk, dsp::stream<I>* in, dsp::stream<O>* out, const I* data, int chunk, int chunks, uint64_t outCount) {
+    uint64_t received = 0;
+    std::thread reader([&]() {
+        while (received < outCount) {
+            int count = out->read();
+            if (count < 0) { return; }
+            received += count;
+            out->flush();
+        }
+    });
+
+    blk.start();
+    for (int i = 0; i < chunks; i++) {
+        memcpy(in->writeBuf, data, chunk * sizeof(I));
+        if (!in->swap(chunk)) { break; }
+    }
+    reader.join();
+    blk.stop();
+    return received;
+}
+
+// Made up samples between -1 and 1, the same for a given seed
+template <class T>
+std::vector<T> makeSignal(int count, uint32_t seed = 1) {
+    std::vector<T> data(count);
+    float* values = (float*)data.data();
+    for (int i = 0; i < count * (int)(sizeof(T) / sizeof(float)); i++) {
+        seed = seed * 1664525 + 1013904223;
+        values[i] = (float)(seed >> 8) / (float)(1 << 23) - 1.0f;
+    }
+    return data;
+}
+
+// Largest difference between the components of two runs of samples
+template <class T>
+double maxError(const T* a, const T* b, int count) {
+    const float* fa = (const float*)a;
+    const float* fb = (const float*)b;
+    double err = 0.0;
+    for (int i = 0; i < count * (int)(sizeof(T) / sizeof(float)); i++) {
+        err = std::max<double>(err, fabs((double)fa[i] - (double)fb[i]));
+    }
+    return err;
+}
+
+// Awkward and changing chunk sizes the checks feed the blocks with
+const std::vector<int> checkChunks = { 1, 37, 8192, 500, 3, 4096, 1021, 2 };
+
+// Run samples through a process function in chunks of checkChunks sizes times scale, returns the number of outputs
+template <class I, class O, class F>
+int processChunks(F process, const I* in, O* out, int count, int scale = 1) {
+    int outCount = 0;
+    for (int i = 0, offset = 0; offset < count; i++) {
+        int n = std::min<int>(checkChunks[i % checkChunks.size()] * scale, count - offset);
+        outCount += process(n, &in[offset], &out[outCount]);
+        offset += n;
+    }
+    return outCount;
+}
+
+/**
+ * Run a block with setParallel(true) in place, out of place and switching form every chunk, and compare it with
+ * the per-sample loop. The input is noise whose level steps over three orders of magnitude, on top of an offset.
+ * Returns the largest difference relative to the largest output, or -1 if the output counts differ.
+ */
+template <class T, class B, class F>
+double compareParallel(F init) {
+    const int count = 200000;
+    std::vector<T> data = makeSignal<T>(count);
+    float* values = (float*)data.data();
+    const int components = sizeof(T) / sizeof(float);
+    for (int i = 0; i < count; i++) {
+        float level = 250.0f * powf(10.0f, (float)((i / 20011) % 4) - 3.0f);
+        for (int c = 0; c < components; c++) { values[i * components + c] = level * (values[i * components + c] + 0.3f); }
+    }
+
+    B scalar;
+    init(scalar);
+    scalar.setParallel(false);
+    std::vector<T> ref(count);
+    processChunks([&](int n, const T* in, T* out) { return scalar.process(n, (T*)in, out); }, data.data(), ref.data(), count);
+    double peak = maxError(ref.data(), std::vector<T>(count).data(), count);
+
+    double err = 0.0;
+    for (int mode = 0; mode < 3; mode++) {
+        B blk;
+        init(blk);
+        blk.setParallel(true);
+        bool parallel = true;
+        std::vector<T> out(count);
+        int outCount = processChunks([&](int n, const T* in, T* out) {
+            if (mode == 0) { return blk.process(n, (T*)in, out); }
+            if (mode == 2) {
+                parallel = !parallel;
+                blk.setParallel(parallel);
+            }
+            memcpy(out, in, n * sizeof(T));
+            return blk.process(n, out, out);
+        }, data.data(), out.data(), count);
+        if (outCount != count) { return -1.0; }
+        err = std::max<double>(err, maxError(out.data(), ref.data(), count) / peak);
+    }
+    return err;
+}
+
+// Formatted message for a failed check
+std::string failure(const char* fmt, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return buf;
+}
+
+dsp::tap<float> makeTaps(int count) {
+    return dsp::taps::windowedSinc<float>(count, DB_M_PI / 4.0, dsp::window::nuttall);
+}
+
+void registerCases() {
+    // FIR filters
+    for (int tapCount : { 32, 128, 512 }) {
+        for (int chunk : { 1024, 16384 }) {
+            std::string params = "/taps=" + std::to_string(tapCount) + "/chunk=" + std::to_string(chunk);
+            addCase("fir/complex" + params, [=](int durationMs) {
+                dsp::tap<float> taps = makeTaps(tapCount);
+                Result res;
+                {
+                    dsp::stream<dsp::complex_t> in;
+                    dsp::filter::FIR<dsp::complex_t, float> fir(&in, taps);
+                    res = measure(fir, &in, &fir.out, durationMs, chunk);
+                }
+                dsp::taps::free(taps);
+                return res;
+            });
+        }
+        addCase("fir/real/taps=" + std::to_string(tapCount), [=](int durationMs) {
+            dsp::tap<float> taps = makeTaps(tapCount);
+            Result res;
+            {
+                dsp::stream<float> in;
+                dsp::filter::FIR<float, float> fir(&in, taps);
+                res = measure(fir, &in, &fir.out, durationMs, BENCH_DEFAULT_CHUNK);
+            }
+            dsp::taps::free(taps);
+            return res;
+        });
+    }
+
+    // Fast convolution, FIR switches to it on its own for long filters
+    for (int tapCount : { 128, 512, 2048 }) {
+        for (int chunk : { 1024, 16384 }) {
+            std::string params = "/taps=" + std::to_string(tapCount) + "/chunk=" + std::to_string(chunk);
+            addCase("fft_fir/complex" + params, [=](int durationMs) {
+                dsp::tap<float> taps = makeTaps(tapCount);
+                Result res;
+                {
+                    dsp::stream<dsp::complex_t> in;
+                    dsp::filter::FFTFIR<dsp::complex_t, float> fir(&in, taps);
+                    res = measure(fir, &in, &fir.out, durationMs, chunk);
+                }
+                dsp::taps::free(taps);
+                return res;
+            });
+        }
+        addCase("fft_fir/real/taps=" + std::to_string(tapCount), [=](int durationMs) {
+            dsp::tap<float> taps = makeTaps(tapCount);
+            Result res;
+            {
+                dsp::stream<float> in;
+                dsp::filter::FFTFIR<float, float> fir(&in, taps);
+                res = measure(fir, &in, &fir.out, durationMs, BENCH_DEFAULT_CHUNK);
+            }
+            dsp::taps::free(taps);
+            return res;
+        });
+    }
+
+    for (int decim : { 2, 8, 32 }) {
+        addCase("decimating_fir/complex/taps=128/decim=" + std::to_string(decim), [=](int durationMs) {
+            dsp::tap<float> taps = makeTaps(128);
+            Result res;
+            {
+                dsp::stream<dsp::complex_t> in;
+                dsp::filter::DecimatingFIR<dsp::complex_t, float> fir(&in, taps, decim);
+                res = measure(fir, &in, &fir.out, durationMs, BENCH_DEFAULT_CHUNK);
+            }
+            dsp::taps::free(taps);
+            return res;
+        });
+    }
+
+    // Stages of the decimation plans, through the generic filter and through their specialised kernel
+    using namespace dsp::multirate::decim;
+    const std::vector<stage> stages = {
+        { 2, fir_2_2_len, fir_2_2_taps },
+        { 2, fir_4_2_len, fir_4_2_taps },
+        { 4, fir_8_4_len, fir_8_4_taps },
+        { 8, fir_16_8_len, fir_16_8_taps },
+        { 8, fir_32_8_len, fir_32_8_taps },
+        { 8, fir_64_8_len, fir_64_8_taps },
+        { 16, fir_128_16_len, fir_128_16_taps },
+        { 32, fir_256_32_len, fir_256_32_taps },
+        { 32, fir_512_32_len, fir_512_32_taps }
+    };
+    for (const auto& stage : stages) {
+        std::string params = "/taps=" + std::to_string(stage.tapcount) + "/decim=" + std::to_string(stage.decimation);
+        for (bool specialised : { false, true }) {
+            addCase("decim_stage/complex" + params + (specialised ? "/specialised" : "/generic"), [=](int durationMs) {
+                dsp::tap<float> taps = dsp::taps::fromArray<float>(stage.tapcount, stage.taps);
+                Result res;
+                {
+                    dsp::stream<dsp::complex_t> in;
+                    dsp::filter::DecimatingFIR<dsp::complex_t, float> fir(&in, taps, stage.decimation);
+                    if (specialised) { fir.setKernel(getKernel<dsp::complex_t>(stage)); }
+                    res = measure(fir, &in, &fir.out, durationMs, BENCH_DEFAULT_CHUNK * 4);
+                }
+                dsp::taps::free(taps);
+                return res;
+            });
+        }
+    }
+
+    // Resamplers
+    for (int ratio : { 2, 16, 256 }) {
+        addCase("power_decimator/complex/ratio=" + std::to_string(ratio), [=](int durationMs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::multirate::PowerDecimator<dsp::complex_t> decim(&in, ratio);
+            return measure(decim, &in, &decim.out, durationMs, BENCH_DEFAULT_CHUNK * 4);
+        });
+    }
+    for (int threads : { 2, 4 }) {
+        addCase("power_decimator/complex/ratio=2/threads=" + std::to_string(threads), [=](int durationMs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::multirate::PowerDecimator<dsp::complex_t> decim(&in, 2);
+            decim.setThreadCount(threads);
+            return measure(decim, &in, &decim.out, durationMs, BENCH_DEFAULT_CHUNK * 4);
+        });
+    }
+    for (int ratio : { 2, 16 }) {
+        addCase("raw_decimator/complex16/ratio=" + std::to_string(ratio), [=](int durationMs) {
+            dsp::stream<dsp::complex16_t> in;
+            dsp::multirate::RawDecimator<dsp::complex16_t> decim(&in, ratio, 32768.0f);
+            return measure(decim, &in, &decim.out, durationMs, BENCH_DEFAULT_CHUNK * 4);
+        });
+    }
+
+    // The last two have ratios too awkward for an exact polyphase filter and use the fractional resampler
+    const std::vector<std::pair<double, double>> rates = { { 2.4e6, 48e3 }, { 250e3, 48e3 }, { 48e3, 44.1e3 }, { 10e6, 200e3 }, { 61.44e6, 48e3 }, { 2.4e6, 44.1e3 }, { 10e6, 48e3 } };
+    for (auto& [inSr, outSr] : rates) {
+        std::string params = "/in=" + std::to_string((int)inSr) + "/out=" + std::to_string((int)outSr);
+        addCase("rational_resampler/complex" + params, [=](int durationMs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::multirate::RationalResampler<dsp::complex_t> resamp(&in, inSr, outSr);
+            return measure(resamp, &in, &resamp.out, durationMs, BENCH_DEFAULT_CHUNK * 4);
+        });
+    }
+    addCase("rational_resampler/stereo/in=48000/out=44100", [=](int durationMs) {
+        dsp::stream<dsp::stereo_t> in;
+        dsp::multirate::RationalResampler<dsp::stereo_t> resamp(&in, 48e3, 44.1e3);
+        return measure(resamp, &in, &resamp.out, durationMs, BENCH_DEFAULT_CHUNK);
+    });
+
+    // Channelization
+    addCase("frequency_xlator", [=](int durationMs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::channel::FrequencyXlator xlator(&in, 123456.0, 2.4e6);
+        return measure(xlator, &in, &xlator.out, durationMs, BENCH_DEFAULT_CHUNK);
+    });
+    for (double inSr : { 2.4e6, 20e6 }) {
+        addCase("rx_vfo/in=" + std::to_string((int)inSr) + "/out=250000", [=](int durationMs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::channel::RxVFO vfo(&in, inSr, 250e3, 200e3, 300e3);
+            return measure(vfo, &in, &vfo.out, durationMs, BENCH_DEFAULT_CHUNK * 16);
+        });
+    }
+
+    for (int decim : { 16, 256 }) {
+        addCase("xlating_decimator/decim=" + std::to_string(decim), [=](int durationMs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::channel::XlatingDecimator xdecim(&in, 300e3, 20e6, decim, 20e6 / (double)(decim * RXVFO_SHIFT_OVERSAMPLING));
+            return measure(xdecim, &in, &xdecim.out, durationMs, BENCH_DEFAULT_CHUNK * 16);
+        });
+    }
+
+    // A narrow VFO on its own costs about as much as the channelizer feeding any number of them
+    addCase("rx_vfo/in=2400000/out=25000", [=](int durationMs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::channel::RxVFO vfo(&in, 2.4e6, 25e3, 12.5e3, 300e3);
+        return measure(vfo, &in, &vfo.out, durationMs, BENCH_DEFAULT_CHUNK * 16);
+    });
+    for (int channels : { 64, 256 }) {
+        addCase("channelizer/channels=" + std::to_string(channels), [=](int durationMs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::stream<dsp::complex_t> out;
+            dsp::channel::Channelizer chan(&in, channels);
+            chan.bindStream(&out, 1);
+            return measure(chan, &in, &out, durationMs, BENCH_DEFAULT_CHUNK * 16);
+        });
+    }
+
+    // Demodulators
+    addCase("quadrature", [=](int durationMs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::Quadrature demod(&in, 75e3, 250e3);
+        return measure(demod, &in, &demod.out, durationMs, BENCH_DEFAULT_CHUNK);
+    });
+    addCase("quadrature/fast", [=](int durationMs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::Quadrature demod(&in, 75e3, 250e3);
+        demod.setAccuracy(dsp::demod::Quadrature::FAST);
+        return measure(demod, &in, &demod.out, durationMs, BENCH_DEFAULT_CHUNK);
+    });
+    for (bool stereo : { false, true }) {
+        addCase(std::string("broadcast_fm/") + (stereo ? "stereo" : "mono"), [=](int durationMs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::demod::BroadcastFM demod(&in, 75e3, 250e3, stereo);
+            return measure(demod, &in, &demod.out, durationMs, BENCH_DEFAULT_CHUNK);
+        });
+    }
+    addCase("fm/nfm", [=](int durationMs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::FM<dsp::stereo_t> demod;
+        demod.init(&in, 50e3, 12.5e3, true, true);
+        return measure(demod, &in, &demod.out, durationMs, BENCH_DEFAULT_CHUNK);
+    });
+    addCase("am", [=](int durationMs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::AM<dsp::stereo_t> demod(&in, dsp::demod::AM<dsp::stereo_t>::AGCMode::CARRIER, 10e3, 50.0 / 24e3, 5.0 / 24e3, 100.0 / 24e3, 24e3);
+        return measure(demod, &in, &demod.out, durationMs, BENCH_DEFAULT_CHUNK);
+    });
+    addCase("ssb/usb", [=](int durationMs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::SSB<dsp::stereo_t> demod(&in, dsp::demod::SSB<dsp::stereo_t>::Mode::USB, 2.8e3, 24e3, 50.0 / 24e3, 5.0 / 24e3);
+        return measure(demod, &in, &demod.out, durationMs, BENCH_DEFAULT_CHUNK);
+    });
+    addCase("psk/qpsk", [=](int durationMs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::PSK<4> demod(&in, 72e3, 144e3, 31, 0.6, 1e-6, 0.005, 1e-6, 0.01);
+        return measure(demod, &in, &demod.out, durationMs, BENCH_DEFAULT_CHUNK);
+    });
+
+    // Loops and clock recovery
+    for (bool parallel : { true, false }) {
+        std::string suffix = parallel ? "" : "/scalar";
+        addCase("agc/real" + suffix, [=](int durationMs) {
+            dsp::stream<float> in;
+            dsp::loop::AGC<float> agc(&in, 1.0, 50.0 / 48e3, 5.0 / 48e3, 10e6, 10.0);
+            agc.setParallel(parallel);
+            return measure(agc, &in, &agc.out, durationMs, BENCH_DEFAULT_CHUNK);
+        });
+        addCase("agc/complex" + suffix, [=](int durationMs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::loop::AGC<dsp::complex_t> agc(&in, 1.0, 50.0 / 48e3, 5.0 / 48e3, 10e6, 10.0);
+            agc.setParallel(parallel);
+            return measure(agc, &in, &agc.out, durationMs, BENCH_DEFAULT_CHUNK);
+        });
+        addCase("fast_agc/complex" + suffix, [=](int durationMs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::loop::FastAGC<dsp::complex_t> agc(&in, 1.0, 10e6, 1e-3);
+            agc.setParallel(parallel);
+            return measure(agc, &in, &agc.out, durationMs, BENCH_DEFAULT_CHUNK);
+        });
+    }
+    addCase("mm/real/omega=10", [=](int durationMs) {
+        dsp::stream<float> in;
+        dsp::clock_recovery::MM<float> recov(&in, 10.0, 1e-6, 0.01, 0.01);
+        return measure(recov, &in, &recov.out, durationMs, BENCH_DEFAULT_CHUNK);
+    });
+    addCase("mm/complex/omega=2", [=](int durationMs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::clock_recovery::MM<dsp::complex_t> recov(&in, 2.0, 1e-6, 0.01, 0.01);
+        return measure(recov, &in, &recov.out, durationMs, BENCH_DEFAULT_CHUNK);
+    });
+
+    // Corrections
+    for (bool parallel : { true, false }) {
+        std::string suffix = parallel ? "" : "/scalar";
+        addCase("dc_blocker/complex" + suffix, [=](int durationMs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::correction::DCBlocker<dsp::complex_t> dcBlock(&in, 50.0, 2.4e6);
+            dcBlock.setParallel(parallel);
+            return measure(dcBlock, &in, &dcBlock.out, durationMs, BENCH_DEFAULT_CHUNK);
+        });
+        addCase("deemphasis/stereo" + suffix, [=](int durationMs) {
+            dsp::stream<dsp::stereo_t> in;
+            dsp::filter::Deemphasis<dsp::stereo_t> deemp;
+            deemp.init(&in, 50e-6, 48e3);
+            deemp.setParallel(parallel);
+            return measure(deemp, &in, &deemp.out, durationMs, BENCH_DEFAULT_CHUNK);
+        });
+    }
+    addCase("noise_blanker", [=](int durationMs) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::noise_reduction::NoiseBlanker blanker(&in, 500.0 / 24e3, 10.0);
+        return measure(blanker, &in, &blanker.out, durationMs, BENCH_DEFAULT_CHUNK);
+    });
+    for (int bins : { 9, 31, 32 }) {
+        addCase("fm_if/bins=" + std::to_string(bins), [=](int durationMs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::noise_reduction::FMIF fmif(&in, bins);
+            return measure(fmif, &in, &fmif.out, durationMs, BENCH_DEFAULT_CHUNK);
+        });
+    }
+
+    // Network compression
+    const std::vector<std::pair<dsp::compression::PCMType, std::string>> pcmTypes = {
+        { dsp::compression::PCMType::PCM_TYPE_I8, "i8" },
+        { dsp::compression::PCMType::PCM_TYPE_I16, "i16" },
+        { dsp::compression::PCMType::PCM_TYPE_F32, "f32" }
+    };
+    for (auto& [type, typeName] : pcmTypes) {
+        addCase("compressor/" + typeName, [=](int durationMs) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::compression::SampleStreamCompressor comp(&in, type);
+            return measure(comp, &in, &comp.out, durationMs, BENCH_DEFAULT_CHUNK);
+        });
+        addCase("decompressor/" + typeName, [=](int durationMs) {
+            // Generate a valid compressed frame to send over and over
+            dsp::complex_t* samples = dsp::buffer::alloc<dsp::complex_t>(BENCH_DEFAULT_CHUNK);
+            for (int i = 0; i < BENCH_DEFAULT_CHUNK; i++) {
+                samples[i] = { (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f, (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f };
+            }
+            uint8_t* frame = dsp::buffer::alloc<uint8_t>(BENCH_DEFAULT_CHUNK * sizeof(dsp::complex_t) + 8);
+            int frameSize = dsp::compression::SampleStreamCompressor::process(BENCH_DEFAULT_CHUNK, type, samples, frame);
+
+            Result res;
+            {
+                dsp::stream<uint8_t> in;
+                in.setBufferSize(frameSize);
+                dsp::compression::SampleStreamDecompressor decomp(&in);
+                res = measure(decomp, &in, &decomp.out, durationMs, frameSize, frame);
+            }
+
+            // Report per decompressed sample rather than per byte
+            double scale = (double)frameSize / (double)BENCH_DEFAULT_CHUNK;
+            res.msps /= scale;
+            res.nsPerSample *= scale;
+            res.cyclesPerSample *= scale;
+
+            dsp::buffer::free(samples);
+            dsp::buffer::free(frame);
+            return res;
+        });
+    }
+}
+
+void registerChecks() {
+    // Profiling counters, every sample and chunk going through a block is counted once
+    addCheck("perf/counters", []() {
+        const int chunk = BENCH_DEFAULT_CHUNK;
+        const int chunks = 100;
+        std::vector<dsp::complex_t> data = makeSignal<dsp::complex_t>(chunk);
+
+        bool wasEnabled = dsp::perf::isEnabled();
+        dsp::perf::setEnabled(true);
+        dsp::stream<dsp::complex_t> in;
+        dsp::multirate::PowerDecimator<dsp::complex_t> decim(&in, 16);
+        uint64_t received = feed(decim, &in, &decim.out, data.data(), chunk, chunks, (uint64_t)chunks * chunk / 16);
+        dsp::perf::setEnabled(wasEnabled);
+
+        auto& c = decim.getCounters();
+        uint64_t counted = 0;
+        for (auto& n : c.chunkSizes) { counted += n; }
+        if (c.samplesIn != (uint64_t)chunks * chunk) { return failure("%llu samples in, %llu sent", (unsigned long long)c.samplesIn, (unsigned long long)chunks * chunk); }
+        if (c.samplesOut != received) { return failure("%llu samples out, %llu received", (unsigned long long)c.samplesOut, (unsigned long long)received); }
+        if (counted != chunks) { return failure("%llu chunks in the histogram, %d sent", (unsigned long long)counted, chunks); }
+        return std::string();
+    });
+
+    // Fast convolution against a direct convolution, FIR switches between the two as the chunk size changes
+    for (int tapCount : { 15, 127, 1001 }) {
+        addCheck("filter/fft_fir/taps=" + std::to_string(tapCount), [tapCount]() {
+            const int count = 50000;
+            std::vector<dsp::complex_t> data = makeSignal<dsp::complex_t>(count);
+            dsp::tap<float> taps = makeTaps(tapCount);
+
+            std::vector<dsp::complex_t> ref(count);
+            for (int i = 0; i < count; i++) {
+                double re = 0.0, im = 0.0;
+                for (int k = 0; k < tapCount && k <= i; k++) {
+                    re += (double)taps.taps[k] * data[i - k].re;
+                    im += (double)taps.taps[k] * data[i - k].im;
+                }
+                ref[i] = { (float)re, (float)im };
+            }
+
+            std::vector<dsp::complex_t> fftOut(count);
+            dsp::filter::FFTFIR<dsp::complex_t, float> fft;
+            fft.init(NULL, taps);
+            processChunks([&](int n, const dsp::complex_t* in, dsp::complex_t* out) { return fft.process(n, in, out); }, data.data(), fftOut.data(), count);
+
+            std::vector<dsp::complex_t> firOut(count);
+            dsp::filter::FIR<dsp::complex_t, float> fir;
+            fir.init(NULL, taps);
+            processChunks([&](int n, const dsp::complex_t* in, dsp::complex_t* out) { return fir.process(n, in, out); }, data.data(), firOut.data(), count);
+            dsp::taps::free(taps);
+
+            double fftErr = maxError(fftOut.data(), ref.data(), count);
+            double firErr = maxError(firOut.data(), ref.data(), count);
+            if (fftErr > 1e-5) { return failure("FFTFIR off by %g", fftErr); }
+            if (firErr > 1e-5) { return failure("FIR off by %g", firErr); }
+            return std::string();
+        });
+    }
+
+    // Channelizer against filtering with its prototype shifted to each channel, then shifting the channel to baseband
+    addCheck("channel/channelizer", []() {
+        const int channelCount = 64;
+        const int count = 30000;
+        const int decim = channelCount / CHANNELIZER_OVERSAMPLING;
+        const int channels[] = { 0, 1, 5, channelCount / 2 - 1, channelCount - 3 };
+        const int used = sizeof(channels) / sizeof(channels[0]);
+        std::vector<dsp::complex_t> data = makeSignal<dsp::complex_t>(count);
+
+        dsp::stream<dsp::complex_t> in;
+        dsp::stream<dsp::complex_t> outs[used];
+        std::vector<dsp::complex_t> results[used];
+        dsp::channel::Channelizer chan(&in, channelCount);
+        for (int c = 0; c < used; c++) { chan.bindStream(&outs[c], channels[c]); }
+
+        // Drive the block from this thread, one chunk at a time
+        for (int i = 0, offset = 0; offset < count; i++) {
+            int n = std::min<int>(checkChunks[i % checkChunks.size()], count - offset);
+            memcpy(in.writeBuf, &data[offset], n * sizeof(dsp::complex_t));
+            in.swap(n);
+            chan.run();
+            for (int c = 0; c < used; c++) {
+                if (!outs[c].readable()) { continue; }
+                int outCount = outs[c].read();
+                results[c].insert(results[c].end(), outs[c].readBuf, outs[c].readBuf + outCount);
+                outs[c].flush();
+            }
+            offset += n;
+        }
+
+        dsp::tap<float> taps = dsp::taps::lowPass((double)CHANNELIZER_OVERSAMPLING / 2.0, (double)CHANNELIZER_OVERSAMPLING - 2.0 * CHANNELIZER_PASSBAND, channelCount);
+        int expected = (count + decim - 1) / decim;
+        std::string error;
+        for (int c = 0; c < used && error.empty(); c++) {
+            if ((int)results[c].size() != expected) {
+                error = failure("channel %d has %d samples instead of %d", channels[c], (int)results[c].size(), expected);
+                break;
+            }
+            double err = 0.0;
+            for (int m = 0; m < expected; m++) {
+                int n = m * decim;
+                double re = 0.0, im = 0.0;
+                for (int k = 0; k < (int)taps.size && k <= n; k++) {
+                    double phase = -2.0 * M_PI * (double)channels[c] * (double)(n - k) / (double)channelCount;
+                    double xre = (double)data[n - k].re * cos(phase) - (double)data[n - k].im * sin(phase);
+                    double xim = (double)data[n - k].re * sin(phase) + (double)data[n - k].im * cos(phase);
+                    re += (double)taps.taps[k] * xre;
+                    im += (double)taps.taps[k] * xim;
+                }
+                err = std::max<double>(err, std::max<double>(fabs(re - results[c][m].re), fabs(im - results[c][m].im)));
+            }
+            if (err > 1e-4) { error = failure("channel %d off by %g", channels[c], err); }
+        }
+        dsp::taps::free(taps);
+        return error;
+    });
+
+    // Fractional resampler output count, output j falls on input j * decim / interp so there must be exactly
+    // ceil(inputs * interp / decim) of them at any point, however large the ratio and whatever the chunk sizes
+    addCheck("multirate/fractional_resampler/count", []() {
+        const int interp = 44100;
+        const int decim = 100003;
+        const int chunks = 2000;
+        int maxChunk = *std::max_element(checkChunks.begin(), checkChunks.end());
+        std::vector<dsp::complex_t> data = makeSignal<dsp::complex_t>(maxChunk);
+        dsp::tap<float> taps = makeTaps(4 * FRACTIONAL_RESAMPLER_PHASES + 1);
+
+        dsp::multirate::FractionalResampler<dsp::complex_t> resamp;
+        resamp.init(NULL, interp, decim, taps);
+        std::vector<dsp::complex_t> out(resamp.maxOutputCount(maxChunk));
+        std::string error;
+        int64_t inputs = 0;
+        int64_t outputs = 0;
+        for (int i = 0; i < chunks; i++) {
+            int n = checkChunks[i % checkChunks.size()];
+            int outCount = resamp.process(n, data.data(), out.data());
+            if (outCount > resamp.maxOutputCount(n)) {
+                error = failure("%d outputs for %d inputs, more than the %d announced", outCount, n, resamp.maxOutputCount(n));
+                break;
+            }
+            inputs += n;
+            outputs += outCount;
+            int64_t expected = (inputs * interp + decim - 1) / decim;
+            if (outputs != expected) {
+                error = failure("%lld outputs after %lld inputs instead of %lld", (long long)outputs, (long long)inputs, (long long)expected);
+                break;
+            }
+        }
+        dsp::taps::free(taps);
+        return error;
+    });
+
+    // Rational resampler at a ratio it hands over to the fractional resampler, must keep the exact rate over a long run
+    addCheck("multirate/rational_resampler/count", []() {
+        const double inSamplerate = 2.4e6;
+        const double outSamplerate = 44.1e3;
+        const int64_t count = 3 * (int64_t)inSamplerate;
+        int maxChunk = *std::max_element(checkChunks.begin(), checkChunks.end());
+        std::vector<dsp::complex_t> data = makeSignal<dsp::complex_t>(maxChunk);
+
+        dsp::multirate::RationalResampler<dsp::complex_t> resamp;
+        resamp.init(NULL, inSamplerate, outSamplerate);
+        std::vector<dsp::complex_t> out(resamp.maxOutputCount(maxChunk));
+        int64_t inputs = 0;
+        int64_t outputs = 0;
+        for (int i = 0; inputs < count; i++) {
+            int n = std::min<int64_t>(checkChunks[i % checkChunks.size()], count - inputs);
+            outputs += resamp.process(n, data.data(), out.data());
+            inputs += n;
+
+            // The decimation ahead of the resampler may hold back a few samples, but the rate must not drift
+            double drift = (double)outputs - (double)inputs * outSamplerate / inSamplerate;
+            if (fabs(drift) > 2.0) { return failure("%lld outputs after %lld inputs", (long long)outputs, (long long)inputs); }
+        }
+        int64_t expected = (int64_t)(count * outSamplerate / inSamplerate);
+        if (outputs != expected) { return failure("%lld outputs instead of %lld", (long long)outputs, (long long)expected); }
+        return std::string();
+    });
+
+    // Decimation split across threads, each output only depends on its input window so it must be bit-identical
+    for (int ratio : { 2, 16, 256 }) {
+        addCheck("multirate/power_decimator/threads/ratio=" + std::to_string(ratio), [ratio]() {
+            // Large chunks, so that every stage has enough outputs to be split
+            const int count = 2000000;
+            const int scale = 37;
+            std::vector<dsp::complex_t> data = makeSignal<dsp::complex_t>(count);
+
+            dsp::multirate::PowerDecimator<dsp::complex_t> serial;
+            serial.init(NULL, ratio);
+            std::vector<dsp::complex_t> ref(count);
+            int refCount = processChunks([&](int n, const dsp::complex_t* in, dsp::complex_t* out) { return serial.process(n, in, out); }, data.data(), ref.data(), count, scale);
+
+            for (int threads : { 2, 4 }) {
+                for (bool inPlace : { false, true }) {
+                    dsp::multirate::PowerDecimator<dsp::complex_t> decim;
+                    decim.init(NULL, ratio);
+                    decim.setThreadCount(threads);
+                    std::vector<dsp::complex_t> out(count);
+                    int outCount = processChunks([&](int n, const dsp::complex_t* src, dsp::complex_t* dst) {
+                        if (!inPlace) { return decim.process(n, src, dst); }
+                        memcpy(dst, src, n * sizeof(dsp::complex_t));
+                        return decim.process(n, dst, dst);
+                    }, data.data(), out.data(), count, scale);
+                    if (outCount != refCount) { return failure("%d outputs with %d threads instead of %d", outCount, threads, refCount); }
+                    if (memcmp(out.data(), ref.data(), refCount * sizeof(dsp::complex_t))) {
+                        return failure("output with %d threads%s differs", threads, inPlace ? " in place" : "");
+                    }
+                }
+            }
+            return std::string();
+        });
+    }
+
+    // FM IF noise reduction against the windowed FFT and inverse FFT of the strongest bin it replaced, on a noisy
+    // FM signal and over several resyncs of its sliding DFT. Samples where two bins are almost as strong may pick
+    // another bin than the reference and are left out, so are the first ones whose window is mostly empty.
+    for (int bins : { 9, 31, 32 }) {
+        addCheck("noise_reduction/fm_if/bins=" + std::to_string(bins), [bins]() {
+            const int count = 6 * FMIF_RESYNC_INTERVAL + 123;
+            std::vector<dsp::complex_t> noise = makeSignal<dsp::complex_t>(count);
+            std::vector<dsp::complex_t> data(count);
+            for (int i = 0; i < count; i++) {
+                double phase = 2.0 * M_PI * 0.1 * (double)i + 2.0 * sin(2.0 * M_PI * 0.001 * (double)i);
+                data[i] = dsp::complex_t{ (float)cos(phase), (float)sin(phase) } + noise[i] * 0.3f;
+            }
+
+            dsp::noise_reduction::FMIF fmif;
+            fmif.init(NULL, bins);
+            std::vector<dsp::complex_t> out(count);
+            processChunks([&](int n, const dsp::complex_t* in, dsp::complex_t* out) { return fmif.process(n, in, out); }, data.data(), out.data(), count);
+
+            // Window and twiddle factors of the reference DFT
+            std::vector<double> win(bins), twRe(bins), twIm(bins);
+            for (int j = 0; j < bins; j++) {
+                win[j] = dsp::window::nuttall(j, bins - 1);
+                twRe[j] = cos(-2.0 * M_PI * (double)j / (double)bins);
+                twIm[j] = sin(-2.0 * M_PI * (double)j / (double)bins);
+            }
+
+            double err = 0.0;
+            int compared = 0;
+            std::vector<double> re(bins), im(bins), amp(bins);
+            for (int i = bins; i < count; i++) {
+                for (int k = 0; k < bins; k++) {
+                    re[k] = 0.0;
+                    im[k] = 0.0;
+                    for (int j = 0; j < bins; j++) {
+                        const dsp::complex_t& x = data[i - (bins - 1) + j];
+                        int t = (k * j) % bins;
+                        re[k] += win[j] * ((double)x.re * twRe[t] - (double)x.im * twIm[t]);
+                        im[k] += win[j] * ((double)x.re * twIm[t] + (double)x.im * twRe[t]);
+                    }
+                    amp[k] = sqrt(re[k] * re[k] + im[k] * im[k]);
+                }
+                int idx = std::max_element(amp.begin(), amp.end()) - amp.begin();
+                double second = 0.0;
+                for (int k = 0; k < bins; k++) {
+                    if (k != idx) { second = std::max<double>(second, amp[k]); }
+                }
+                if (amp[idx] - second < 1e-3 * amp[idx]) { continue; }
+
+                double phase = 2.0 * M_PI * (double)idx * (double)(bins / 2) / (double)bins;
+                double oRe = re[idx] * cos(phase) - im[idx] * sin(phase);
+                double oIm = re[idx] * sin(phase) + im[idx] * cos(phase);
+                err = std::max<double>(err, std::max<double>(fabs(oRe - out[i].re), fabs(oIm - out[i].im)) / amp[idx]);
+                compared++;
+            }
+            if (compared < count * 9 / 10) { return failure("only %d of %d samples compared", compared, count); }
+            if (err > 1e-4) { return failure("off by %g of the amplitude", err); }
+            return std::string();
+        });
+    }
+
+    // Block-parallel AGC and look-ahead first order IIR against their per-sample loops
+    auto addParallelCheck = [](std::string name, double tolerance, std::function<double()> compare) {
+        addCheck(name, [tolerance, compare]() {
+            double err = compare();
+            if (err < 0.0) { return failure("output count differs"); }
+            if (err > tolerance) { return failure("off by %g of the largest output", err); }
+            return std::string();
+        });
+    };
+    addParallelCheck("parallel/agc/real", 0.0, []() {
+        return compareParallel<float, dsp::loop::AGC<float>>([](auto& b) { b.init(NULL, 1.0, 50.0 / 48e3, 5.0 / 48e3, 10e6, 10.0); });
+    });
+    addParallelCheck("parallel/agc/complex", 0.0, []() {
+        return compareParallel<dsp::complex_t, dsp::loop::AGC<dsp::complex_t>>([](auto& b) { b.init(NULL, 1.0, 50.0 / 48e3, 5.0 / 48e3, 10e6, 10.0); });
+    });
+    addParallelCheck("parallel/fast_agc/complex", 2e-4, []() {
+        return compareParallel<dsp::complex_t, dsp::loop::FastAGC<dsp::complex_t>>([](auto& b) { b.init(NULL, 1.0, 10e6, 1e-3); });
+    });
+    addParallelCheck("parallel/dc_blocker/real", 2e-6, []() {
+        return compareParallel<float, dsp::correction::DCBlocker<float>>([](auto& b) { b.init(NULL, 50.0, 2.4e6); });
+    });
+    addParallelCheck("parallel/dc_blocker/complex", 2e-6, []() {
+        return compareParallel<dsp::complex_t, dsp::correction::DCBlocker<dsp::complex_t>>([](auto& b) { b.init(NULL, 50.0, 2.4e6); });
+    });
+    addParallelCheck("parallel/deemphasis/real", 2e-6, []() {
+        return compareParallel<float, dsp::filter::Deemphasis<float>>([](auto& b) { b.init(NULL, 50e-6, 48e3); });
+    });
+    addParallelCheck("parallel/deemphasis/stereo", 2e-6, []() {
+        return compareParallel<dsp::stereo_t, dsp::filter::Deemphasis<dsp::stereo_t>>([](auto& b) { b.init(NULL, 50e-6, 48e3); });
+    });
+}
+
+void printUsage(const char* name) {
+    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "  -d, --duration <ms>       Duration of each benchmark (default: %d)\n", BENCH_DEFAULT_DURATION_MS);
+    fprintf(stderr, "  -f, --filter <text>       Only run benchmarks whose name contains the text\n");
+    fprintf(stderr, "  -o, --output <file>       Write the JSON results to a file instead of stdout\n");
+    fprintf(stderr, "  -b, --baseline <file>     Compare against results saved from a previous run\n");
+    fprintf(stderr, "  -t, --threshold <pct>     Slowdown reported as regression (default: %.1f)\n", BENCH_DEFAULT_THRESHOLD);
+    fprintf(stderr, "  -c, --check               Run the behaviour checks instead of the benchmarks\n");
+    fprintf(stderr, "  -l, --list                List the benchmarks, or the checks with -c, and exit\n");
+}
+
+int main(int argc, char* argv[]) {
+    int durationMs = BENCH_DEFAULT_DURATION_MS;
+    double threshold = BENCH_DEFAULT_THRESHOLD;
+    std::string filter = "";
+    std::string outputPath = "";
+    std::string baselinePath = "";
+    bool listOnly = false;
+    bool checkOnly = false;
+
+    // Parse arguments
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if ((arg == "-d" || arg == "--duration") && hasValue) { durationMs = atoi(argv[++i]); }
+        else if ((arg == "-f" || arg == "--filter") && hasValue) { filter = argv[++i]; }
+        else if ((arg == "-o" || arg == "--output") && hasValue) { outputPath = argv[++i]; }
+        else if ((arg == "-b" || arg == "--baseline") && hasValue) { baselinePath = argv[++i]; }
+        else if ((arg == "-t" || arg == "--threshold") && hasValue) { threshold = atof(argv[++i]); }
+        else if (arg == "-c" || arg == "--check") { checkOnly = true; }
+        else if (arg == "-l" || arg == "--list") { listOnly = true; }
+        else {
+            printUsage(argv[0]);
+            return (arg == "-h" || arg == "--help") ? 0 : -1;
+        }
+    }
+
+    registerCases();
+    registerChecks();
+
+    if (listOnly) {
+        if (checkOnly) {
+            for (auto& c : checks) { printf("%s\n", c.name.c_str()); }
+        }
+        else {
+            for (auto& c : cases) { printf("%s\n", c.name.c_str()); }
+        }
+        return 0;
+    }
+
+    // Run the checks, the benchmarks' options other than the filter don't apply
+    if (checkOnly) {
+        int failures = 0;
+        for (auto& c : checks) {
+            if (!filter.empty() && c.name.find(filter) == std::string::npos) { continue; }
+            std::string error = c.run();
+            fprintf(stderr, "%-50s %s\n", c.name.c_str(), error.empty() ? "OK" : ("FAILED: " + error).c_str());
+            if (!error.empty()) { failures++; }
+        }
+        if (failures) {
+            fprintf(stderr, "%d check(s) failed\n", failures);
+            return 1;
+        }
+        return 0;
+    }
+
+    // Load baseline if any
+    json baseline = json::object();
+    if (!baselinePath.empty()) {
+        std::ifstream file(baselinePath);
+        if (!file.is_open()) {
+            fprintf(stderr, "Could not open baseline file '%s'\n", baselinePath.c_str());
+            return -1;
+        }
+        try {
+            file >> baseline;
+        }
+        catch (const std::exception& e) {
+            fprintf(stderr, "Invalid baseline file: %s\n", e.what());
+            return -1;
+        }
+    }
+
+    // Run benchmarks, the progress goes to stderr so that stdout only gets the JSON
+    srand(0);
+    json out;
+    out["durationMs"] = durationMs;
+    out["cycleCounter"] = (dsp::bench::readCycleCounter() != 0);
+    out["results"] = json::object();
+    int regressions = 0;
+
+    fprintf(stderr, "%-50s %12s %12s %14s %10s\n", "Benchmark", "MS/s", "ns/sample", "cycles/sample", "Change");
+    for (auto& c : cases) {
+        if (!filter.empty() && c.name.find(filter) == std::string::npos) { continue; }
+
+        Result res = c.run(durationMs);
+        json& entry = out["results"][c.name];
+        entry["msps"] = res.msps;
+        entry["nsPerSample"] = res.nsPerSample;
+        entry["cyclesPerSample"] = res.cyclesPerSample;
+
+        std::string change = "";
+        if (baseline.contains("results") && baseline["results"].contains(c.name)) {
+            double base = baseline["results"][c.name]["msps"];
+            double diff = (base > 0.0) ? 100.0 * (res.msps - base) / base : 0.0;
+            entry["baselineMsps"] = base;
+            entry["change"] = diff;
+
+            char buf[32];
+            sprintf(buf, "%+.1f%%", diff);
+            change = buf;
+            if (diff < -threshold) {
+                change += " !";
+                regressions++;
+            }
+        }
+
+        fprintf(stderr, "%-50s %12.3f %12.3f %14.2f %10s\n", c.name.c_str(), res.msps, res.nsPerSample, res.cyclesPerSample, change.c_str());
+    }
+
+    // Write results
+    if (outputPath.empty()) {
+        printf("%s\n", out.dump(4).c_str());
+    }
+    else {
+        std::ofstream file(outputPath);
+        if (!file.is_open()) {
+            fprintf(stderr, "Could not write to '%s'\n", outputPath.c_str());
+            return -1;
+        }
+        file << out.dump(4);
+    }
+
+    if (regressions) {
+        fprintf(stderr, "%d benchmark(s) got more than %.1f%% slower than the baseline\n", regressions, threshold);
+        return 1;
+    }
+    return 0;
+}
@@ -19,6 +19,10 @@
 #include <stb_image_resize.h>
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
+#include <dsp/scheduler.h>
+#include <dsp/buffer/pool.h>
+#include <dsp/kernel/kernels.h>
+#include <dsp/fft/plan.h>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -247,9 +251,21 @@ int sdrpp_main(int argc, char* argv[]) {
     defConfig["showWaterfall"] = true;
     defConfig["source"] = "";
     defConfig["decimation"] = 1;
+    defConfig["inputBufferDepth"] = FRAME_BUFFER_DEFAULT_DEPTH;
+    defConfig["vfoChannels"] = 0;
     defConfig["iqCorrection"] = false;
     defConfig["invertIQ"] = false;
 
+    defConfig["dspScheduler"]["enabled"] = false;
+    defConfig["dspScheduler"]["threads"] = 0;
+
+    defConfig["dspBufferPool"]["hugePages"] = false;
+    defConfig["dspBufferPool"]["cacheSizeMB"] = 256;
+
+    defConfig["dspKernels"]["autoTune"] = true;
+
+    defConfig["dspFFT"]["rigor"] = "measure";
+
     defConfig["streams"]["Radio"]["muted"] = false;
     defConfig["streams"]["Radio"]["sink"] = "Audio";
     defConfig["streams"]["Radio"]["volume"] = 1.0f;
@@ -354,6 +370,48 @@ int sdrpp_main(int argc, char* argv[]) {
     // Load UI scaling
     style::uiScale = core::configManager.conf["uiScale"];
 
+    // Select the DSP kernels saved for this CPU, or measure them the first time if enabled
+    std::string kernelProfile = root + "/dsp_kernels.txt";
+    dsp::kernel::init();
+    if (!dsp::kernel::loadProfile(kernelProfile) && core::configManager.conf["dspKernels"]["autoTune"]) {
+        flog::info("Measuring DSP kernels for {0}", dsp::kernel::cpuName());
+        dsp::kernel::tune();
+        if (!dsp::kernel::saveProfile(kernelProfile)) {
+            flog::warn("Could not save DSP kernel profile to {0}", kernelProfile);
+        }
+    }
+
+    // Reuse the FFT plans measured before and measure the new ones in the background
+    std::string fftWisdom = root + "/fftw_wisdom.txt";
+    std::string fftRigor = core::configManager.conf["dspFFT"]["rigor"];
+    if (std::filesystem::exists(fftWisdom) && !dsp::fft::loadWisdom(fftWisdom)) {
+        flog::warn("Could not load FFTW wisdom from {0}", fftWisdom);
+    }
+    if (fftRigor == "patient") {
+        dsp::fft::startUpgrades(dsp::fft::RIGOR_PATIENT, fftWisdom);
+    }
+    else if (fftRigor == "measure") {
+        dsp::fft::startUpgrades(dsp::fft::RIGOR_MEASURE, fftWisdom);
+    }
+    else if (fftRigor != "estimate") {
+        flog::warn("Unknown FFT planning rigor '{0}', using estimated plans", fftRigor);
+    }
+
+    // Start the DSP thread pool if enabled, blocks started from now on will run in it.
+    // It is never freed since blocks that are destroyed on exit may still be attached to it.
+    if (core::configManager.conf["dspScheduler"]["enabled"]) {
+        int threads = core::configManager.conf["dspScheduler"]["threads"];
+        dsp::Scheduler* scheduler = new dsp::Scheduler();
+        scheduler->start(threads);
+        dsp::Scheduler::setDefault(scheduler);
+        flog::info("DSP scheduler running with {0} threads", scheduler->getThreadCount());
+    }
+
+    // Configure the DSP buffer pool
+    int poolCacheSize = core::configManager.conf["dspBufferPool"]["cacheSizeMB"];
+    dsp::buffer::pool::setCacheLimit((size_t)poolCacheSize * 1024 * 1024);
+    dsp::buffer::pool::setHugePages(core::configManager.conf["dspBufferPool"]["hugePages"]);
+
     core::configManager.release(true);
 
     if (serverMode) { return server::main(); }
@@ -412,6 +470,8 @@ int sdrpp_main(int argc, char* argv[]) {
 
     sigpath::iqFrontEnd.stop();
 
+    dsp::fft::stopUpgrades();
+
     core::configManager.disableAutoSave();
     core::configManager.save();
 #endif
@@ -1,10 +1,29 @@
 #pragma once
 #include <thread>
+#include <chrono>
 #include <assert.h>
 #include "../stream.h"
 #include "../types.h"
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define SPEED_TESTER_HAS_CYCLE_COUNTER
+#endif
+
 namespace dsp::bench {
+    // Read the CPU's timestamp counter, always 0 on architectures that don't have one
+    inline uint64_t readCycleCounter() {
+#ifdef SPEED_TESTER_HAS_CYCLE_COUNTER
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
     template<class I,  class O>
     class SpeedTester {
     public:
@@ -32,29 +51,60 @@ namespace dsp::bench {
             assert(_init);
 
             // Allocate and fill buffer
-            inCount = bufferSize;
-            randBuf = buffer::alloc<I>(inCount);
-            for (int i = 0; i < inCount; i++) {
+            I* data = buffer::alloc<I>(bufferSize);
+            for (int i = 0; i < bufferSize; i++) {
                 if constexpr (std::is_same_v<I, complex_t>) {
-                    randBuf[i].re = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
-                    randBuf[i].im = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+                    data[i].re = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+                    data[i].im = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+                }
+                else if constexpr (std::is_same_v<I, stereo_t>) {
+                    data[i].l = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+                    data[i].r = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
                 }
                 else if constexpr (std::is_same_v<I, float>) {
-                    randBuf[i] = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+                    data[i] = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+                }
+                else if constexpr (std::is_same_v<I, complex16_t>) {
+                    data[i].re = (int16_t)(rand() % 65536 - 32768);
+                    data[i].im = (int16_t)(rand() % 65536 - 32768);
                 }
                 else {
-                    randBuf[i] = rand();
+                    data[i] = rand();
                 }
             }
 
+            double rate = benchmark(durationMs, data, bufferSize);
+            buffer::free(data);
+            return rate;
+        }
+
+        // Run the benchmark by sending the same given buffer over and over, returns the input rate in samples per second
+        double benchmark(int durationMs, const I* data, int count) {
+            assert(_init);
+            randBuf = data;
+            inCount = count;
+
             // Run test
+            auto startTime = std::chrono::steady_clock::now();
+            uint64_t startCycles = readCycleCounter();
             start();
             std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
             stop();
-            buffer::free(randBuf);
-            return (double)sampCount * 1000.0 / (double)durationMs;
+            lastCycles = readCycleCounter() - startCycles;
+            lastDuration = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            lastSampleCount = sampCount;
+            return (double)lastSampleCount / lastDuration;
         }
 
+        // Number of input samples sent during the last benchmark
+        uint64_t getSampleCount() { return lastSampleCount; }
+
+        // Actual duration of the last benchmark in seconds
+        double getDuration() { return lastDuration; }
+
+        // Timestamp counter cycles elapsed during the last benchmark, 0 if not available
+        uint64_t getCycles() { return lastCycles; }
+
     protected:
         void start() {
             if (running) { return; }
@@ -96,10 +146,14 @@ namespace dsp::bench {
         int inCount;
         stream<I>* _in;
         stream<O>* _out;
-        I* randBuf;
+        const I* randBuf;
         std::thread wthr;
         std::thread rthr;
-        uint64_t sampCount;
+        std::atomic<uint64_t> sampCount;
+
+        uint64_t lastSampleCount = 0;
+        double lastDuration = 0.0;
+        uint64_t lastCycles = 0;
 
     };
 }
\ No newline at end of file
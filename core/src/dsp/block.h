@@ -1,9 +1,14 @@
 #pragma once
 #include <assert.h>
+#include <atomic>
+#include <functional>
 #include <thread>
 #include <vector>
 #include <algorithm>
+#include <string>
 #include "stream.h"
+#include "scheduler.h"
+#include "perf.h"
 #include "types.h"
 
 namespace dsp {
@@ -15,9 +20,10 @@ namespace dsp {
         virtual int run() { return -1; }
     };
 
-    class block : public generic_block {
+    class block : public generic_block, public task {
     public:
         virtual ~block() {
+            perf::unregisterBlock(this);
             if (!_block_init) { return; }
             stop();
             _block_init = false;
@@ -30,6 +36,7 @@ namespace dsp {
                 return;
             }
             running = true;
+            registerProfiling();
             doStart();
         }
 
@@ -41,6 +48,7 @@ namespace dsp {
             }
             doStop();
             running = false;
+            applyUpdates();
         }
 
         void tempStart() {
@@ -58,21 +66,146 @@ namespace dsp {
             if (running && !tempStopped) {
                 doStop();
                 tempStopped = true;
+                applyUpdates();
             }
         }
 
+        /**
+         * Apply a parameter change without stopping the block. While the worker is running, the change is
+         * queued in a lock-free mailbox and applied by the worker itself before it processes its next chunk.
+         * Otherwise it's applied right away. Changes are always applied in the order they were posted.
+         */
+        void postUpdate(std::function<void()> update) {
+            std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+            if (!updatesDeferred()) {
+                update();
+                return;
+            }
+            Update* u = new Update{ std::move(update), perf::now(), updates.load(std::memory_order_relaxed) };
+            while (!updates.compare_exchange_weak(u->next, u)) {}
+        }
+
+        // True if changes posted now would be applied by the worker, false if they would be applied right away
+        bool updatesDeferred() {
+            return running && !tempStopped;
+        }
+
         virtual int run() = 0;
 
+        // Ready to run if all inputs have data and all outputs have room
+        virtual bool ready() {
+            for (auto& in : inputs) {
+                if (!in->readable()) { return false; }
+            }
+            for (auto& out : outputs) {
+                if (!out->writable()) { return false; }
+            }
+            return true;
+        }
+
+        void acquire() {
+            ctrlMtx.lock();
+        }
+
+        void release() {
+            ctrlMtx.unlock();
+        }
+
+        int runTask() {
+            return profiledRun();
+        }
+
+        // Make the block visible to the profiler, done automatically when it is started
+        void registerProfiling() {
+            if (typeName.empty()) { typeName = perf::typeName(typeid(*this)); }
+            perf::registerBlock(this);
+        }
+
+        perf::Counters& getCounters() { return counters; }
+
+        const std::string& getTypeName() { return typeName; }
+
+        // Get the streams the block is connected to, returns false if they're being changed
+        bool getStreams(std::vector<untyped_stream*>& in, std::vector<untyped_stream*>& out) {
+            if (!ctrlMtx.try_lock()) { return false; }
+            in = inputs;
+            out = outputs;
+            ctrlMtx.unlock();
+            return true;
+        }
+
     protected:
         void workerLoop() {
-            while (run() >= 0) {}
+            while (profiledRun() >= 0) {}
+        }
+
+        // Run once, recording the block's counters if profiling is enabled
+        int profiledRun() {
+            if (updates.load(std::memory_order_relaxed)) { applyUpdates(); }
+            if (!perf::isEnabled()) { return run(); }
+
+            // The stream counters this block's thread updates are diffed around the run
+            uint64_t inCount = 0, inWait = 0, outCount = 0, outWait = 0;
+            for (auto& in : inputs) {
+                inCount -= in->readSamples;
+                inWait -= in->readWaitTime;
+            }
+            for (auto& out : outputs) {
+                outCount -= out->writeSamples;
+                outWait -= out->writeWaitTime;
+            }
+
+            uint64_t start = perf::now();
+            int ret = run();
+            uint64_t total = perf::now() - start;
+
+            for (auto& in : inputs) {
+                inCount += in->readSamples;
+                inWait += in->readWaitTime;
+            }
+            for (auto& out : outputs) {
+                outCount += out->writeSamples;
+                outWait += out->writeWaitTime;
+            }
+
+            counters.runs.fetch_add(1, std::memory_order_relaxed);
+            counters.samplesIn.fetch_add(inCount, std::memory_order_relaxed);
+            counters.samplesOut.fetch_add(outCount, std::memory_order_relaxed);
+            counters.readWaitTime.fetch_add(inWait, std::memory_order_relaxed);
+            counters.swapWaitTime.fetch_add(outWait, std::memory_order_relaxed);
+            counters.processTime.fetch_add((total > inWait + outWait) ? (total - inWait - outWait) : 0, std::memory_order_relaxed);
+            if (inputs.empty() ? outCount : inCount) { counters.addChunk(inputs.empty() ? outCount : inCount); }
+
+            return ret;
+        }
+
+        /**
+         * Blocks can only be run by a scheduler if each run() does a single read per input and a single
+         * swap per output, all of them registered. Blocks that may wait on anything else must return false.
+         */
+        virtual bool schedulable() {
+            return !inputs.empty();
         }
 
         virtual void doStart() {
+            Scheduler* sched = Scheduler::getDefault();
+            if (sched && sched->isRunning() && schedulable()) {
+                scheduler = sched;
+                for (auto& in : inputs) { in->setReaderTask(this); }
+                for (auto& out : outputs) { out->setWriterTask(this); }
+                scheduler->add(this);
+                return;
+            }
             workerThread = std::thread(&block::workerLoop, this);
         }
 
         virtual void doStop() {
+            // Detach from the streams first so that no notification can come in once removed
+            if (scheduler) {
+                for (auto& in : inputs) { in->setReaderTask(NULL); }
+                for (auto& out : outputs) { out->setWriterTask(NULL); }
+            }
+
             for (auto& in : inputs) {
                 in->stopReader();
             }
@@ -84,6 +217,10 @@ namespace dsp {
             if (workerThread.joinable()) {
                 workerThread.join();
             }
+            if (scheduler) {
+                scheduler->remove(this);
+                scheduler = NULL;
+            }
 
             for (auto& in : inputs) {
                 in->clearReadStop();
@@ -92,13 +229,30 @@ namespace dsp {
                 out->clearWriteStop();
             }
         }
-    
-        void acquire() {
-            ctrlMtx.lock();
-        }
 
-        void release() {
-            ctrlMtx.unlock();
+        // Apply the changes waiting in the mailbox, only called by the worker or while it isn't running
+        void applyUpdates() {
+            // Take the whole list at once, it's in reverse posting order
+            Update* list = updates.exchange(NULL);
+            Update* ordered = NULL;
+            while (list) {
+                Update* next = list->next;
+                list->next = ordered;
+                ordered = list;
+                list = next;
+            }
+
+            bool profile = perf::isEnabled();
+            while (ordered) {
+                Update* next = ordered->next;
+                ordered->apply();
+                if (profile) {
+                    counters.updates.fetch_add(1, std::memory_order_relaxed);
+                    counters.updateLatency.fetch_add(perf::now() - ordered->posted, std::memory_order_relaxed);
+                }
+                delete ordered;
+                ordered = next;
+            }
         }
 
         void registerInput(untyped_stream* inStream) {
@@ -128,5 +282,18 @@ namespace dsp {
         bool tempStopped = false;
         int tempStopDepth = 0;
         std::thread workerThread;
+        Scheduler* scheduler = NULL;
+
+        perf::Counters counters;
+        std::string typeName;
+
+    private:
+        struct Update {
+            std::function<void()> apply;
+            uint64_t posted;
+            Update* next;
+        };
+
+        std::atomic<Update*> updates = NULL;
     };
 }
\ No newline at end of file
@@ -1,11 +1,12 @@
 #pragma once
 #include <volk/volk.h>
 #include <string.h>
+#include "pool.h"
 
 namespace dsp::buffer {
     template<class T>
-    inline T* alloc(int count) {
-        return (T*)volk_malloc(count * sizeof(T), volk_get_alignment());
+    inline T* alloc(int count, int tag = pool::CURRENT_TAG) {
+        return (T*)pool::alloc(count * sizeof(T), tag);
     }
 
     template<class T>
@@ -14,6 +15,26 @@ namespace dsp::buffer {
     }
 
     inline void free(void* buffer) {
-        volk_free(buffer);
+        pool::free(buffer);
     }
-}
\ No newline at end of file
+
+    // Number of elements a buffer can hold
+    template<class T>
+    inline int capacity(const T* buffer) {
+        return pool::capacity(buffer) / sizeof(T);
+    }
+
+    /**
+     * Make sure a buffer can hold at least count elements, reallocating it if it can't.
+     * The first keep elements are preserved. Returns true if the buffer was reallocated.
+     */
+    template<class T>
+    inline bool reserve(T*& buffer, int count, int keep = 0) {
+        if (count <= capacity(buffer)) { return false; }
+        T* newBuf = alloc<T>(count, pool::getTag(buffer));
+        memcpy(newBuf, buffer, keep * sizeof(T));
+        free(buffer);
+        buffer = newBuf;
+        return true;
+    }
+}
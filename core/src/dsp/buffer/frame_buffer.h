@@ -1,36 +1,53 @@
 #pragma once
 #include "../block.h"
-#define TEST_BUFFER_SIZE 32
 
-// IMPORTANT: THIS IS TRASH AND MUST BE REWRITTEN IN THE FUTURE
+// Maximum number of chunks that can be buffered, whatever their size
+#define FRAME_BUFFER_MAX_CHUNKS     1024
+
+// Default buffer depth in milliseconds
+#define FRAME_BUFFER_DEFAULT_DEPTH  250.0
 
 namespace dsp::buffer {
+    /**
+     * Input buffer decoupling a source from the rest of the DSP. Incoming chunks are queued in a lock-free ring
+     * holding up to a configurable duration of samples and passed on as shared buffers. Chunks filling most of
+     * the input buffer are taken over without copying, smaller ones are copied once into a right-sized buffer.
+     * When the ring is full, incoming chunks are dropped and counted as overruns. In bypass mode, the input
+     * waits for the ring to empty instead so that nothing is ever dropped.
+     */
     template <class T>
     class SampleFrameBuffer : public block {
         using base_type = block;
     public:
+        struct Stats {
+            uint64_t overruns;          // Number of chunks dropped because the buffer was full
+            uint64_t droppedSamples;    // Number of samples in the dropped chunks
+            int buffered;               // Samples currently buffered
+            int highWater;              // Maximum number of samples ever buffered
+        };
+
         SampleFrameBuffer() {}
 
-        SampleFrameBuffer(stream<T>* in) { init(in); }
+        SampleFrameBuffer(stream<T>* in, double samplerate = 0.0, double depth = FRAME_BUFFER_DEFAULT_DEPTH) { init(in, samplerate, depth); }
 
         ~SampleFrameBuffer() {
             if (!base_type::_block_init) { return; }
             base_type::stop();
-            for (int i = 0; i < TEST_BUFFER_SIZE; i++) {
-                buffer::free(buffers[i]);
-            }
+            discard();
         }
 
-        void init(stream<T>* in) {
+        void init(stream<T>* in, double samplerate = 0.0, double depth = FRAME_BUFFER_DEFAULT_DEPTH) {
             _in = in;
-
-            for (int i = 0; i < TEST_BUFFER_SIZE; i++) {
-                buffers[i] = buffer::alloc<T>(STREAM_BUFFER_SIZE);
-            }
+            _samplerate = samplerate;
+            _depth = depth;
+            updateDepthSamples();
 
             base_type::registerInput(in);
             base_type::registerOutput(&out);
             base_type::_block_init = true;
+
+            // Only shared buffers are published, the output's own buffers are never used
+            out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
         }
 
         void setInput(stream<T>* in) {
@@ -43,9 +60,57 @@ namespace dsp::buffer {
             base_type::tempStart();
         }
 
+        // Samplerate of the input, used to convert the depth to samples. Zero only limits the number of chunks.
+        void setSamplerate(double samplerate) {
+            _samplerate = samplerate;
+            updateDepthSamples();
+        }
+
+        // Maximum duration of the buffered samples in milliseconds
+        void setDepth(double depth) {
+            _depth = depth;
+            updateDepthSamples();
+        }
+
+        double getDepth() { return _depth; }
+
+        void setBypass(bool enabled) {
+            bypass = enabled;
+            { std::lock_guard<std::mutex> lck(waitMtx); }
+            cnd.notify_all();
+        }
+
+        bool getBypass() { return bypass; }
+
+        // Discard all buffered chunks
         void flush() {
-            std::unique_lock lck(bufMtx);
-            readCur = writeCur;
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            // Without a worker the ring can be emptied from here, otherwise the worker is asked to do it
+            if (!base_type::running || base_type::tempStopped) {
+                discard();
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lck(waitMtx);
+                flushPending = true;
+            }
+            cnd.notify_all();
+        }
+
+        Stats getStats() {
+            Stats stats;
+            stats.overruns = overruns;
+            stats.droppedSamples = droppedSamples;
+            stats.buffered = std::max<int>(buffered, 0);
+            stats.highWater = highWater;
+            return stats;
+        }
+
+        void resetStats() {
+            overruns = 0;
+            droppedSamples = 0;
+            highWater = 0;
         }
 
         int run() {
@@ -53,52 +118,81 @@ namespace dsp::buffer {
             int count = _in->read();
             if (count < 0) { return -1; }
 
+            // In bypass mode, wait for the worker to have passed everything on so that the input gets back pressure
             if (bypass) {
-                memcpy(out.writeBuf, _in->readBuf, count * sizeof(T));
+                std::unique_lock<std::mutex> lck(waitMtx);
+                cnd.wait(lck, [this]() { return !used() || !bypass || stopWorker; });
+                if (stopWorker) {
+                    _in->flush();
+                    return -1;
+                }
+            }
+
+            // Drop the chunk if it doesn't fit, a single chunk is always accepted even if larger than the depth
+            int b = buffered.load();
+            int limit = depthSamples.load(std::memory_order_relaxed);
+            if (used() >= FRAME_BUFFER_MAX_CHUNKS || (limit && b && b + count > limit)) {
+                overruns.fetch_add(1, std::memory_order_relaxed);
+                droppedSamples.fetch_add(count, std::memory_order_relaxed);
                 _in->flush();
-                if (!out.swap(count)) { return -1; }
                 return count;
             }
 
             // Push it on the ring buffer
-            {
-                std::lock_guard<std::mutex> lck(bufMtx);
-                memcpy(buffers[writeCur], _in->readBuf, count * sizeof(T));
-                sizes[writeCur] = count;
-                writeCur++;
-                writeCur = ((writeCur) % TEST_BUFFER_SIZE);
-            }
-            cnd.notify_all();
+            uint32_t w = writeIdx.load(std::memory_order_relaxed);
+            chunks[w % FRAME_BUFFER_MAX_CHUNKS] = take(count);
+            sizes[w % FRAME_BUFFER_MAX_CHUNKS] = count;
             _in->flush();
+            b = (buffered += count);
+            if (b > highWater.load(std::memory_order_relaxed)) { highWater.store(b, std::memory_order_relaxed); }
+            writeIdx.store(w + 1);
+
+            // Notify the worker
+            { std::lock_guard<std::mutex> lck(waitMtx); }
+            cnd.notify_all();
+
             return count;
         }
 
         void worker() {
             while (true) {
                 // Wait for data
-                std::unique_lock lck(bufMtx);
-                cnd.wait(lck, [this]() { return (((writeCur - readCur + TEST_BUFFER_SIZE) % TEST_BUFFER_SIZE) > 0) || stopWorker; });
-                if (stopWorker) { break; }
-
-                // Write one to output buffer and unlock in preparation to swap buffers
-                int count = sizes[readCur];
-                memcpy(out.writeBuf, buffers[readCur], count * sizeof(T));
-                readCur++;
-                readCur = ((readCur) % TEST_BUFFER_SIZE);
-                lck.unlock();
-
-                // Swap
-                if (!out.swap(count)) { break; }
+                {
+                    std::unique_lock<std::mutex> lck(waitMtx);
+                    cnd.wait(lck, [this]() { return used() || flushPending || stopWorker; });
+                    if (stopWorker) { break; }
+                    if (flushPending) {
+                        flushPending = false;
+                        lck.unlock();
+                        discard();
+                        continue;
+                    }
+                }
+
+                // Pop the oldest chunk
+                uint32_t r = readIdx.load(std::memory_order_relaxed);
+                SharedBuffer<T>* buf = chunks[r % FRAME_BUFFER_MAX_CHUNKS];
+                int count = sizes[r % FRAME_BUFFER_MAX_CHUNKS];
+                chunks[r % FRAME_BUFFER_MAX_CHUNKS] = NULL;
+                buffered -= count;
+                readIdx.store(r + 1);
+
+                // Notify the input in case it's waiting in bypass mode
+                if (bypass) {
+                    { std::lock_guard<std::mutex> lck(waitMtx); }
+                    cnd.notify_all();
+                }
+
+                // Pass it on, the output takes over our reference
+                if (!out.swapShared(buf, count)) {
+                    buf->release();
+                    break;
+                }
             }
         }
 
         stream<T> out;
 
-        int writeCur = 0;
-        int readCur = 0;
-
-        bool bypass = false;
-
     private:
         void doStart() {
             base_type::workerThread = std::thread(&SampleFrameBuffer<T>::workerLoop, this);
@@ -108,7 +202,10 @@ namespace dsp::buffer {
         void doStop() {
             _in->stopReader();
             out.stopWriter();
-            stopWorker = true;
+            {
+                std::lock_guard<std::mutex> lck(waitMtx);
+                stopWorker = true;
+            }
             cnd.notify_all();
 
             if (base_type::workerThread.joinable()) { base_type::workerThread.join(); }
@@ -119,14 +216,73 @@ namespace dsp::buffer {
             stopWorker = false;
         }
 
+        // Get the chunk being read from the input into a shared buffer with a single reference
+        SharedBuffer<T>* take(int count) {
+            // If the input already holds a shared buffer, just keep a reference to it
+            SharedBuffer<T>* buf = _in->shareReadBuf();
+            if (buf) { return buf; }
+
+            // Take over the input buffer if the chunk fills most of it, otherwise it would pin a lot of unused memory
+            int inSize = _in->getBufferSize();
+            if (count >= inSize / 2) {
+                buf = pool->acquire(inSize);
+                int size = buf->capacity;
+                T* data = _in->exchangeReadBuf(buf->data, size);
+                buf->data = data;
+                buf->capacity = size;
+                return buf;
+            }
+
+            // Copy it to a buffer rounded up to limit reallocations when the chunk size varies slightly
+            buf = pool->acquire((count + 4095) & ~4095);
+            memcpy(buf->data, _in->readBuf, count * sizeof(T));
+            return buf;
+        }
+
+        // Release all buffered chunks, must only be called by the reader side
+        void discard() {
+            uint32_t w = writeIdx.load();
+            uint32_t r = readIdx.load(std::memory_order_relaxed);
+            for (; r != w; r++) {
+                chunks[r % FRAME_BUFFER_MAX_CHUNKS]->release();
+                chunks[r % FRAME_BUFFER_MAX_CHUNKS] = NULL;
+                buffered -= sizes[r % FRAME_BUFFER_MAX_CHUNKS];
+            }
+            readIdx.store(w);
+
+            // Notify the input in case it's waiting in bypass mode
+            { std::lock_guard<std::mutex> lck(waitMtx); }
+            cnd.notify_all();
+        }
+
+        void updateDepthSamples() {
+            depthSamples = (int)std::min<double>(_samplerate * _depth / 1000.0, (double)INT32_MAX);
+        }
+
+        inline uint32_t used() { return writeIdx.load() - readIdx.load(); }
+
         stream<T>* _in;
 
+        double _samplerate = 0.0;
+        double _depth = FRAME_BUFFER_DEFAULT_DEPTH;
+        std::atomic<int> depthSamples = 0;
+        std::atomic<bool> bypass = false;
+
         std::thread readWorkerThread;
-        std::mutex bufMtx;
+        std::mutex waitMtx;
         std::condition_variable cnd;
-        T* buffers[TEST_BUFFER_SIZE];
-        int sizes[TEST_BUFFER_SIZE];
-
         bool stopWorker = false;
+        bool flushPending = false;
+
+        SharedBuffer<T>* chunks[FRAME_BUFFER_MAX_CHUNKS] = {};
+        int sizes[FRAME_BUFFER_MAX_CHUNKS];
+        std::atomic<uint32_t> writeIdx = 0;
+        std::atomic<uint32_t> readIdx = 0;
+        std::shared_ptr<SharedPool<T>> pool = std::make_shared<SharedPool<T>>();
+
+        std::atomic<int> buffered = 0;
+        std::atomic<int> highWater = 0;
+        std::atomic<uint64_t> overruns = 0;
+        std::atomic<uint64_t> droppedSamples = 0;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <algorithm>
+#include "buffer.h"
+
+namespace dsp::buffer {
+    /**
+     * Delay line of a filter reading windows of size() + 1 samples from the sequence formed by the last
+     * size() samples it got followed by the current chunk. Rather than copying each chunk after the previous
+     * samples, only the boundary is: windows starting in the first size() samples of the sequence are read
+     * from a copy of the history and the start of the chunk, all others directly from the caller's buffer.
+     */
+    template <class T>
+    class History {
+    public:
+        History() {}
+
+        History(int size) { init(size); }
+
+        ~History() {
+            if (!buf) { return; }
+            buffer::free(buf);
+        }
+
+        void init(int size) {
+            _size = size;
+            buf = buffer::alloc<T>(std::max<int>(3 * _size, 1));
+            clear();
+        }
+
+        // Change the length of the history, keeping the most recent samples
+        void resize(int size) {
+            if (size < _size) {
+                memmove(buf, &buf[_size - size], size * sizeof(T));
+            }
+            else if (size > _size) {
+                buffer::reserve(buf, 3 * size, _size);
+                memmove(&buf[size - _size], buf, _size * sizeof(T));
+                buffer::clear<T>(buf, size - _size);
+            }
+            _size = size;
+        }
+
+        void clear() {
+            buffer::clear<T>(buf, _size);
+        }
+
+        /**
+         * Start reading windows from a chunk, which must not be modified until end() is called.
+         * If overwritten is true, the chunk may be overwritten back to front while it's being processed,
+         * as filters working in place do.
+         */
+        inline void begin(const T* in, int count, bool overwritten = false) {
+            _in = in;
+            _count = count;
+            memcpy(&buf[_size], in, std::min<int>(count, _size) * sizeof(T));
+            if (count < _size) { return; }
+            tail = &in[count - _size];
+            if (overwritten) {
+                memcpy(&buf[2 * _size], tail, _size * sizeof(T));
+                tail = &buf[2 * _size];
+            }
+        }
+
+        /**
+         * Start reading windows from a copy of the whole chunk, for processors whose
+         * output may overtake their input when working in place.
+         */
+        inline void load(const T* in, int count) {
+            buffer::reserve(buf, std::max<int>(_size + count, 3 * _size), _size);
+            memcpy(&buf[_size], in, count * sizeof(T));
+            _in = &buf[_size];
+            _count = count;
+            tail = &buf[count];
+        }
+
+        // Window starting at the given index of the sequence, only valid for indices below the chunk's size
+        inline const T* window(int index) {
+            return (index < _size) ? &buf[index] : &_in[index - _size];
+        }
+
+        // Done with the chunk, its last samples become the history
+        inline void end() {
+            memmove(buf, (_count >= _size) ? tail : &buf[_count], _size * sizeof(T));
+        }
+
+        // History samples, oldest first
+        inline T* data() { return buf; }
+
+        inline int size() { return _size; }
+
+    private:
+        T* buf = NULL;
+        int _size = 0;
+
+        const T* _in;
+        int _count;
+        const T* tail;
+    };
+}
@@ -62,6 +62,9 @@ namespace dsp::buffer {
         stream<T> out;
 
     private:
+        // Several packets can be sent per run, so this block needs its own thread
+        bool schedulable() { return false; }
+
         int samples = 1;
         int read = 0;
         stream<T>* _in;
@@ -0,0 +1,260 @@
+#include "pool.h"
+#include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stdlib.h>
+#include <volk/volk.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Every buffer is preceded by a header, its size keeps the data aligned
+#define POOL_HEADER_SIZE        64
+#define POOL_MAGIC              0x42554650
+
+// Size classes, four per power of two between the minimum and maximum sizes
+#define POOL_MIN_SIZE_LOG2      8
+#define POOL_MAX_SIZE_LOG2      34
+#define POOL_CLASS_COUNT        (1 + 4 * (POOL_MAX_SIZE_LOG2 - POOL_MIN_SIZE_LOG2))
+#define POOL_NOT_POOLED         0xFFFF
+
+#define POOL_HUGE_PAGE_SIZE     (2 * 1024 * 1024)
+#define POOL_DEFAULT_CACHE      (256 * 1024 * 1024)
+#define POOL_MAX_TAGS           256
+
+namespace dsp::buffer::pool {
+    enum {
+        FLAG_HUGE_PAGES = (1 << 0)
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint16_t sizeClass;
+        uint16_t tag;
+        uint32_t flags;
+        size_t capacity;
+    };
+
+    struct State {
+        std::mutex mtx;
+        std::vector<void*> freeLists[POOL_CLASS_COUNT];
+        size_t cacheLimit = POOL_DEFAULT_CACHE;
+        bool hugePages = false;
+
+        std::atomic<size_t> inUse = 0;
+        std::atomic<size_t> cached = 0;
+        std::atomic<size_t> huge = 0;
+        std::atomic<uint64_t> allocs = 0;
+        std::atomic<uint64_t> hits = 0;
+
+        std::mutex tagMtx;
+        std::vector<std::string> tagNames = { "Other" };
+        std::atomic<int64_t> tagBytes[POOL_MAX_TAGS] = {};
+    };
+
+    // Streams are allocated by static constructors, so the state must exist before them and outlive them
+    static State& state() {
+        static State* s = new State;
+        return *s;
+    }
+
+    static thread_local int scopeTag = UNTAGGED;
+
+    static inline Header* header(const void* ptr) {
+        return (Header*)((uint8_t*)ptr - POOL_HEADER_SIZE);
+    }
+
+    static int sizeClass(size_t size, size_t& classSize) {
+        if (size <= ((size_t)1 << POOL_MIN_SIZE_LOG2)) {
+            classSize = (size_t)1 << POOL_MIN_SIZE_LOG2;
+            return 0;
+        }
+
+        // Find k such that 2^k < size <= 2^(k+1), then round up to the next quarter of 2^k
+        int k = POOL_MIN_SIZE_LOG2;
+        while (((size_t)2 << k) < size) { k++; }
+        size_t step = (size_t)1 << (k - 2);
+        int sub = (int)((size - 1 - ((size_t)1 << k)) / step);
+        classSize = ((size_t)1 << k) + (sub + 1) * step;
+        if (k >= POOL_MAX_SIZE_LOG2) { return POOL_NOT_POOLED; }
+        return 1 + 4 * (k - POOL_MIN_SIZE_LOG2) + sub;
+    }
+
+    static void* sysAlloc(size_t total, bool huge) {
+#ifdef __linux__
+        if (huge) {
+            void* base = NULL;
+            size_t rounded = (total + POOL_HUGE_PAGE_SIZE - 1) & ~((size_t)POOL_HUGE_PAGE_SIZE - 1);
+            if (posix_memalign(&base, POOL_HUGE_PAGE_SIZE, rounded)) { return NULL; }
+            madvise(base, rounded, MADV_HUGEPAGE);
+            return base;
+        }
+#endif
+        return volk_malloc(total, POOL_HEADER_SIZE);
+    }
+
+    static void sysFree(void* base, uint32_t flags) {
+        if (flags & FLAG_HUGE_PAGES) {
+            ::free(base);
+            return;
+        }
+        volk_free(base);
+    }
+
+    static void release(State& s, Header* hdr) {
+        if (hdr->flags & FLAG_HUGE_PAGES) { s.huge -= hdr->capacity; }
+        sysFree(hdr, hdr->flags);
+    }
+
+    void* alloc(size_t size, int tag) {
+        State& s = state();
+        if (tag == CURRENT_TAG) { tag = scopeTag; }
+        s.allocs.fetch_add(1, std::memory_order_relaxed);
+
+        size_t classSize;
+        int cls = sizeClass(size, classSize);
+
+        // Reuse a cached buffer of the same class if there is one
+        Header* hdr = NULL;
+        if (cls != POOL_NOT_POOLED) {
+            std::lock_guard<std::mutex> lck(s.mtx);
+            if (!s.freeLists[cls].empty()) {
+                hdr = header(s.freeLists[cls].back());
+                s.freeLists[cls].pop_back();
+                s.cached -= classSize;
+                s.hits.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        if (!hdr) {
+            bool huge = s.hugePages && (classSize + POOL_HEADER_SIZE) >= POOL_HUGE_PAGE_SIZE;
+            hdr = (Header*)sysAlloc(classSize + POOL_HEADER_SIZE, huge);
+            if (!hdr) { return NULL; }
+            hdr->magic = POOL_MAGIC;
+            hdr->sizeClass = cls;
+            hdr->flags = huge ? FLAG_HUGE_PAGES : 0;
+            hdr->capacity = classSize;
+            if (huge) { s.huge += classSize; }
+        }
+
+        hdr->tag = tag;
+        s.inUse += classSize;
+        s.tagBytes[tag] += classSize;
+        return (uint8_t*)hdr + POOL_HEADER_SIZE;
+    }
+
+    void free(void* ptr) {
+        if (!ptr) { return; }
+        State& s = state();
+        Header* hdr = header(ptr);
+        assert(hdr->magic == POOL_MAGIC);
+        s.inUse -= hdr->capacity;
+        s.tagBytes[hdr->tag] -= hdr->capacity;
+
+        // Keep the buffer for later unless the cache is full
+        if (hdr->sizeClass != POOL_NOT_POOLED) {
+            std::lock_guard<std::mutex> lck(s.mtx);
+            if (s.cached + hdr->capacity <= s.cacheLimit) {
+                s.freeLists[hdr->sizeClass].push_back(ptr);
+                s.cached += hdr->capacity;
+                return;
+            }
+        }
+        release(s, hdr);
+    }
+
+    size_t capacity(const void* ptr) {
+        return header(ptr)->capacity;
+    }
+
+    int getTag(const void* ptr) {
+        return header(ptr)->tag;
+    }
+
+    void setHugePages(bool enabled) {
+        State& s = state();
+        {
+            std::lock_guard<std::mutex> lck(s.mtx);
+            if (s.hugePages == enabled) { return; }
+            s.hugePages = enabled;
+        }
+        trim();
+    }
+
+    bool getHugePages() {
+        State& s = state();
+        std::lock_guard<std::mutex> lck(s.mtx);
+        return s.hugePages;
+    }
+
+    void setCacheLimit(size_t bytes) {
+        State& s = state();
+        {
+            std::lock_guard<std::mutex> lck(s.mtx);
+            s.cacheLimit = bytes;
+            if (s.cached <= bytes) { return; }
+        }
+        trim();
+    }
+
+    void trim() {
+        State& s = state();
+        std::vector<void*> buffers;
+        {
+            std::lock_guard<std::mutex> lck(s.mtx);
+            for (auto& list : s.freeLists) {
+                buffers.insert(buffers.end(), list.begin(), list.end());
+                list.clear();
+            }
+            s.cached = 0;
+        }
+        for (auto& buf : buffers) {
+            release(s, header(buf));
+        }
+    }
+
+    Stats getStats() {
+        State& s = state();
+        Stats stats;
+        stats.inUse = s.inUse;
+        stats.cached = s.cached;
+        stats.hugePages = s.huge;
+        stats.allocs = s.allocs;
+        stats.hits = s.hits;
+        return stats;
+    }
+
+    int currentTag() {
+        return scopeTag;
+    }
+
+    void forEachTag(std::function<void(const std::string& name, size_t bytes)> func) {
+        State& s = state();
+        std::lock_guard<std::mutex> lck(s.tagMtx);
+        for (int i = 0; i < (int)s.tagNames.size(); i++) {
+            func(s.tagNames[i], (size_t)std::max<int64_t>(s.tagBytes[i], 0));
+        }
+    }
+
+    static int findTag(const std::string& name) {
+        State& s = state();
+        std::lock_guard<std::mutex> lck(s.tagMtx);
+        for (int i = 0; i < (int)s.tagNames.size(); i++) {
+            if (s.tagNames[i] == name) { return i; }
+        }
+        if (s.tagNames.size() >= POOL_MAX_TAGS) { return UNTAGGED; }
+        s.tagNames.push_back(name);
+        return s.tagNames.size() - 1;
+    }
+
+    Scope::Scope(const std::string& name) {
+        prev = scopeTag;
+        scopeTag = findTag(name);
+    }
+
+    Scope::~Scope() {
+        scopeTag = prev;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+
+namespace dsp::buffer::pool {
+    // Tag of the allocations made outside of any scope
+    constexpr int UNTAGGED = 0;
+
+    // Use the tag of the calling thread's innermost scope
+    constexpr int CURRENT_TAG = -1;
+
+    struct Stats {
+        size_t inUse;       // Bytes handed out, size class rounding included
+        size_t cached;      // Bytes kept in the free lists for reuse
+        size_t hugePages;   // Bytes of in use or cached buffers backed by huge pages
+        uint64_t allocs;    // Number of allocations
+        uint64_t hits;      // Number of allocations served from the free lists
+    };
+
+    /**
+     * Allocate an aligned buffer of at least the given size. The size is rounded up to one of four classes
+     * per power of two and freed buffers are kept per class to be handed out again.
+     */
+    void* alloc(size_t size, int tag = CURRENT_TAG);
+
+    // Give a buffer back to the pool, NULL is ignored
+    void free(void* ptr);
+
+    // Usable size of a buffer in bytes, at least what was asked for
+    size_t capacity(const void* ptr);
+
+    // Tag a buffer is accounted to
+    int getTag(const void* ptr);
+
+    /**
+     * Back large buffers with huge pages where the OS supports it (transparent huge pages on Linux).
+     * Only affects new allocations, the buffers already cached are released.
+     */
+    void setHugePages(bool enabled);
+    bool getHugePages();
+
+    // Maximum number of bytes kept in the free lists, anything over is returned to the OS
+    void setCacheLimit(size_t bytes);
+
+    // Return all cached buffers to the OS
+    void trim();
+
+    Stats getStats();
+
+    // Tag of the calling thread's innermost scope
+    int currentTag();
+
+    // Call a function with the name and bytes in use of every tag that ever had allocations
+    void forEachTag(std::function<void(const std::string& name, size_t bytes)> func);
+
+    /**
+     * Account all allocations made by the calling thread to a name while the scope exists,
+     * e.g. everything a VFO or a module allocates when it's created. Scopes can be nested.
+     */
+    class Scope {
+    public:
+        Scope(const std::string& name);
+        ~Scope();
+
+    private:
+        int prev;
+    };
+}
@@ -75,7 +75,7 @@ namespace dsp::buffer {
         }
 
         void loop() {
-            while (run() >= 0)
+            while (base_type::profiledRun() >= 0)
                 ;
         }
 
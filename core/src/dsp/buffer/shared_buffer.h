@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "buffer.h"
+
+namespace dsp::buffer {
+    template <class T>
+    class SharedPool;
+
+    /**
+     * Reference counted buffer that can be published to several streams at once without copying.
+     * Readers must treat it as read-only. It goes back to its pool when the last reference is released.
+     */
+    template <class T>
+    class SharedBuffer {
+    public:
+        void retain(int count = 1) {
+            refs.fetch_add(count);
+        }
+
+        void release() {
+            if (refs.fetch_sub(1) != 1) { return; }
+            std::shared_ptr<SharedPool<T>> owner = std::move(pool);
+            owner->recycle(this);
+        }
+
+        T* data = NULL;
+        int capacity = 0;
+
+    private:
+        friend SharedPool<T>;
+        std::atomic<int> refs = 0;
+        std::shared_ptr<SharedPool<T>> pool;
+    };
+
+    /**
+     * Pool of shared buffers. Buffers in flight keep the pool alive, so it can safely
+     * be dropped by its owner while readers still hold some of its buffers.
+     */
+    template <class T>
+    class SharedPool : public std::enable_shared_from_this<SharedPool<T>> {
+    public:
+        ~SharedPool() {
+            for (auto& buf : freeList) {
+                buffer::free(buf->data);
+                delete buf;
+            }
+        }
+
+        // Get a buffer of exactly the given capacity, with a single reference owned by the caller
+        SharedBuffer<T>* acquire(int capacity) {
+            SharedBuffer<T>* buf = NULL;
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                if (!freeList.empty()) {
+                    buf = freeList.back();
+                    freeList.pop_back();
+                }
+            }
+            if (!buf) {
+                buf = new SharedBuffer<T>;
+                allocated++;
+            }
+            if (buf->capacity != capacity) {
+                if (buf->data) { buffer::free(buf->data); }
+                buf->data = buffer::alloc<T>(capacity);
+                buf->capacity = capacity;
+            }
+            buf->refs.store(1);
+            buf->pool = this->shared_from_this();
+            return buf;
+        }
+
+        // Number of buffers that were ever allocated by this pool
+        int allocatedCount() {
+            return allocated;
+        }
+
+    private:
+        friend SharedBuffer<T>;
+
+        void recycle(SharedBuffer<T>* buf) {
+            std::lock_guard<std::mutex> lck(mtx);
+            freeList.push_back(buf);
+        }
+
+        std::mutex mtx;
+        std::vector<SharedBuffer<T>*> freeList;
+        std::atomic<int> allocated = 0;
+    };
+}
@@ -1,7 +1,9 @@
 #pragma once
 #include <vector>
 #include <map>
+#include <functional>
 #include "processor.h"
+#include "fused_executor.h"
 
 namespace dsp {
     template<class T>
@@ -11,6 +13,10 @@ namespace dsp {
 
         chain(stream<T>* in) { init(in); }
 
+        ~chain() {
+            for (auto& ex : executors) { delete ex; }
+        }
+
         void init(stream<T>* in) {
             _in = in;
             out = _in;
@@ -19,6 +25,10 @@ namespace dsp {
         template<typename Func>
         void setInput(stream<T>* in, Func onOutputChange) {
             _in = in;
+            if (fused) {
+                rebuild(onOutputChange);
+                return;
+            }
             for (auto& ln : links) {
                 if (states[ln]) {
                     ln->setInput(_in);
@@ -29,7 +39,8 @@ namespace dsp {
             onOutputChange(out);
         }
         
-        void addBlock(Processor<T, T>* block, bool enabled) {
+        template<class B>
+        void addBlock(B* block, bool enabled) {
             // Check if block is already part of the chain
             if (blockExists(block)) {
                 throw std::runtime_error("[chain] Tried to add a block that is already part of the chain");
@@ -39,6 +50,11 @@ namespace dsp {
             links.push_back(block);
             states[block] = false;
 
+            // Remember how to call the block synchronously if it supports it
+            if constexpr (is_fusable<B, T>::value) {
+                fusers[block] = [block](int count, T* in, T* out) { return (int)block->process(count, in, out); };
+            }
+
             // Enable if needed
             if (enabled) { enableBlock(block, [](stream<T>* out){}); }
         }
@@ -55,6 +71,7 @@ namespace dsp {
         
             // Remove block from the list
             states.erase(block);
+            fusers.erase(block);
             links.erase(std::find(links.begin(), links.end(), block));
         }
 
@@ -68,6 +85,13 @@ namespace dsp {
             // If already enable, don't do anything
             if (states[block]) { return; }
 
+            // In fused mode, the whole chain is re-planned
+            if (fused) {
+                states[block] = true;
+                rebuild(onOutputChange);
+                return;
+            }
+
             // Gather blocks before and after the block to enable
             Processor<T, T>* before = blockBefore(block);
             Processor<T, T>* after = blockAfter(block);
@@ -99,6 +123,13 @@ namespace dsp {
             // If already disabled, don't do anything
             if (!states[block]) { return; }
 
+            // In fused mode, the whole chain is re-planned
+            if (fused) {
+                states[block] = false;
+                rebuild(onOutputChange);
+                return;
+            }
+
             // Stop disabled block
             block->stop();
             states[block] = false;
@@ -141,8 +172,56 @@ namespace dsp {
             }
         }
 
+        /**
+         * In fused mode, consecutive enabled blocks that expose a process(count, in, out) function are run
+         * back-to-back in a single thread, in place, instead of each having their own thread and output buffer.
+         * Blocks that can't be fused keep running in their own thread.
+         */
+        template<typename Func>
+        void setFused(bool enabled, Func onOutputChange) {
+            if (enabled == fused) { return; }
+            bool wasRunning = running;
+            stop();
+            fused = enabled;
+            if (fused) {
+                rebuild(onOutputChange);
+            }
+            else {
+                // Wire all enabled blocks one after the other again
+                stream<T>* cur = _in;
+                for (auto& ln : links) {
+                    if (!states[ln]) { continue; }
+                    ln->setInput(cur);
+                    cur = &ln->out;
+                }
+                units.clear();
+                setOutput(cur, onOutputChange);
+                freeExecutors();
+            }
+            if (wasRunning) { start(); }
+        }
+
+        bool isFused() {
+            return fused;
+        }
+
+        // Number of threads used by the chain when running
+        int threadCount() {
+            if (fused) { return units.size(); }
+            int count = 0;
+            for (auto& ln : links) {
+                if (states[ln]) { count++; }
+            }
+            return count;
+        }
+
         void start() {
             if (running) { return; }
+            if (fused) {
+                for (auto& unit : units) { unit->start(); }
+                running = true;
+                return;
+            }
             for (auto& ln : links) {
                 if (!states[ln]) { continue; }
                 ln->start();
@@ -152,6 +231,11 @@ namespace dsp {
 
         void stop() {
             if (!running) { return; }
+            if (fused) {
+                for (auto& unit : units) { unit->stop(); }
+                running = false;
+                return;
+            }
             for (auto& ln : links) {
                 if (!states[ln]) { continue; }
                 ln->stop();
@@ -162,11 +246,75 @@ namespace dsp {
         stream<T>* out;
 
     private:
+        template<typename Func>
+        void rebuild(Func onOutputChange) {
+            // Stop everything that's currently running
+            if (running) {
+                for (auto& unit : units) { unit->stop(); }
+            }
+
+            // Group consecutive fusable blocks into executors, other blocks get their own thread
+            std::vector<FusedExecutor<T>*> oldExecutors = executors;
+            executors.clear();
+            units.clear();
+            stream<T>* cur = _in;
+            std::vector<Processor<T, T>*> group;
+            auto flushGroup = [&]() {
+                if (group.size() == 1) {
+                    group[0]->setInput(cur);
+                    cur = &group[0]->out;
+                    units.push_back(group[0]);
+                }
+                else if (group.size() > 1) {
+                    FusedExecutor<T>* ex = new FusedExecutor<T>(cur);
+                    for (auto& blk : group) { ex->addStage(blk, fusers[blk]); }
+                    executors.push_back(ex);
+                    cur = &ex->out;
+                    units.push_back(ex);
+                }
+                group.clear();
+            };
+            for (auto& ln : links) {
+                if (!states[ln]) { continue; }
+                if (fusers.find(ln) != fusers.end()) {
+                    group.push_back(ln);
+                    continue;
+                }
+                flushGroup();
+                ln->setInput(cur);
+                cur = &ln->out;
+                units.push_back(ln);
+            }
+            flushGroup();
+
+            // Update the output, the old executors can only be deleted once nothing reads from them anymore
+            setOutput(cur, onOutputChange);
+            for (auto& ex : oldExecutors) { delete ex; }
+
+            // Restart if needed
+            if (running) {
+                for (auto& unit : units) { unit->start(); }
+            }
+        }
+
+        template<typename Func>
+        void setOutput(stream<T>* newOut, Func onOutputChange) {
+            if (newOut == out) { return; }
+            out = newOut;
+            onOutputChange(out);
+        }
+
+        void freeExecutors() {
+            for (auto& ex : executors) { delete ex; }
+            executors.clear();
+        }
+
         Processor<T, T>* blockBefore(Processor<T, T>* block) {
-            // TODO: This is wrong and must be fixed when I get more time
+            // Find the last enabled block before the given one
+            Processor<T, T>* before = NULL;
             for (auto& ln : links) {
-                if (ln == block) { return NULL; }
-                if (states[ln]) { return ln; }
+                if (ln == block) { return before; }
+                if (states[ln]) { before = ln; }
             }
             return NULL;
         }
@@ -190,6 +338,10 @@ namespace dsp {
         stream<T>* _in;
         std::vector<Processor<T, T>*> links;
         std::map<Processor<T, T>*, bool> states;
+        std::map<Processor<T, T>*, std::function<int(int, T*, T*)>> fusers;
+        std::vector<FusedExecutor<T>*> executors;
+        std::vector<block*> units;
+        bool fused = false;
         bool running = false;
     };
 }
\ No newline at end of file
@@ -0,0 +1,278 @@
+#pragma once
+#include <math.h>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include "../sink.h"
+#include "../fft/plan.h"
+#include "../math/constants.h"
+#include "../taps/low_pass.h"
+#include "../buffer/history.h"
+
+// Channels are sampled at this many times their spacing, so that neighbouring channels overlap
+#define CHANNELIZER_OVERSAMPLING    2
+
+// Alias-free band on each side of a channel's center, relative to the channel spacing
+#define CHANNELIZER_PASSBAND        0.75
+
+namespace dsp::channel {
+    /**
+     * Polyphase filter bank channelizer, splitting its input into channelCount uniform channels at once for
+     * the cost of a short polyphase filter and one FFT every channelCount / CHANNELIZER_OVERSAMPLING samples,
+     * whatever the number of channels used. Channel i is centered on i * samplerate / channelCount, the upper
+     * half wrapping around to negative frequencies, and is sampled at CHANNELIZER_OVERSAMPLING times the
+     * channel spacing. Each output stream is bound either to a channel, or to the whole band (channel -1)
+     * in which case it gets a copy of the input.
+     */
+    class Channelizer : public Sink<complex_t> {
+        using base_type = Sink<complex_t>;
+    public:
+        Channelizer() {}
+
+        Channelizer(stream<complex_t>* in, int channelCount) { init(in, channelCount); }
+
+        ~Channelizer() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(proto);
+            buffer::free(prod);
+            buffer::free(rot);
+            plan.destroy();
+            fftwf_free(fftIn);
+            fftwf_free(fftOut);
+        }
+
+        void init(stream<complex_t>* in, int channelCount) {
+            assert(channelCount >= 2 && !(channelCount % CHANNELIZER_OVERSAMPLING));
+            _channelCount = channelCount;
+            decim = _channelCount / CHANNELIZER_OVERSAMPLING;
+
+            // Design the prototype filter with the samplerate normalised to one per channel. It passes the
+            // channel's alias-free band and stops everything that would alias into it after decimation.
+            double cutoff = (double)CHANNELIZER_OVERSAMPLING / 2.0;
+            double transWidth = (double)CHANNELIZER_OVERSAMPLING - 2.0 * CHANNELIZER_PASSBAND;
+            tap<float> taps = taps::lowPass(cutoff, transWidth, _channelCount);
+
+            // Zero-pad it to a whole number of taps per branch and reverse it to match the order of the samples
+            branchTaps = (taps.size + _channelCount - 1) / _channelCount;
+            length = branchTaps * _channelCount;
+            proto = buffer::alloc<float>(length);
+            buffer::clear(proto, length);
+            for (int i = 0; i < (int)taps.size; i++) { proto[length - 1 - i] = taps.taps[i]; }
+            taps::free(taps);
+
+            prod = buffer::alloc<complex_t>(length);
+            history.init(length - 1);
+
+            // Phase of each channel due to the order of the branches, see process()
+            rot = buffer::alloc<complex_t>(_channelCount);
+            for (int i = 0; i < _channelCount; i++) {
+                double phase = -2.0 * DB_M_PI * (double)i / (double)_channelCount;
+                rot[i] = { (float)cos(phase), (float)sin(phase) };
+            }
+
+            fftIn = (complex_t*)fftwf_malloc(_channelCount * sizeof(complex_t));
+            fftOut = (complex_t*)fftwf_malloc(_channelCount * sizeof(complex_t));
+            plan.create(fft::FORWARD, _channelCount, fftIn, fftOut);
+
+            base_type::init(in);
+        }
+
+        // Bind an output stream to a channel, or to the whole band if channel is -1
+        void bindStream(stream<complex_t>* stream, int channel = -1) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            // Check that the stream isn't already bound
+            if (find(stream) != routes.end()) {
+                throw std::runtime_error("[Channelizer] Tried to bind stream to that is already bound");
+            }
+
+            // Add to the list
+            base_type::tempStop();
+            base_type::registerOutput(stream);
+            routes.push_back({ stream, channel });
+            base_type::tempStart();
+        }
+
+        void unbindStream(stream<complex_t>* stream) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            // Check that the stream is bound
+            auto rit = find(stream);
+            if (rit == routes.end()) {
+                throw std::runtime_error("[Channelizer] Tried to unbind stream to that isn't bound");
+            }
+
+            // Remove from the list
+            base_type::tempStop();
+            routes.erase(rit);
+            base_type::unregisterOutput(stream);
+            base_type::tempStart();
+        }
+
+        /**
+         * Switch a bound stream to another channel, from the next chunk on. Unless mark is 0, the first chunk
+         * of the new channel is marked with it, see stream::mark(), so that the reader can switch along with it.
+         */
+        void setChannel(stream<complex_t>* stream, int channel, int mark = 0) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::postUpdate([this, stream, channel, mark]() {
+                auto rit = find(stream);
+                if (rit == routes.end()) { return; }
+                rit->channel = channel;
+                rit->mark = mark;
+            });
+        }
+
+        int getChannelCount() { return _channelCount; }
+
+        // Samplerate of the channels for a given input samplerate
+        double getChannelSamplerate(double samplerate) {
+            return samplerate * (double)CHANNELIZER_OVERSAMPLING / (double)_channelCount;
+        }
+
+        // Center frequency of a channel relative to the center of the input
+        double getChannelOffset(int channel, double samplerate) {
+            int index = (channel < _channelCount / 2) ? channel : (channel - _channelCount);
+            return (double)index * samplerate / (double)_channelCount;
+        }
+
+        /**
+         * Channel containing a band of the given width centered on offset, or -1 if none does and the whole
+         * band is needed. The current channel is kept for as long as the band fits in it, so that a band
+         * moving back and forth across the middle of two channels doesn't keep switching between them.
+         */
+        int select(double offset, double bandwidth, double samplerate, int current = -1) {
+            // The channels must be at a samplerate the resamplers can handle exactly
+            double chanSamplerate = getChannelSamplerate(samplerate);
+            if (fabs(chanSamplerate - round(chanSamplerate)) > 1e-6) { return -1; }
+
+            if (current >= 0 && current < _channelCount && fits(current, offset, bandwidth, samplerate)) {
+                return current;
+            }
+
+            // The channels at the edge of the input are half outside of it, so they're never used
+            int index = round(offset * (double)_channelCount / samplerate);
+            if (abs(index) >= _channelCount / 2) { return -1; }
+            int channel = (index + _channelCount) % _channelCount;
+            return fits(channel, offset, bandwidth, samplerate) ? channel : -1;
+        }
+
+        inline int process(int count, const complex_t* in) {
+            history.begin(in, count);
+
+            int outCount = 0;
+            for (; offset < count; offset += decim) {
+                // Weight the window with the prototype and fold it into one sample per branch.
+                // The FFT of the branches then gives all channels, each a rotation away from the
+                // output of the prototype after shifting the channel down to baseband.
+                volk_32fc_32f_multiply_32fc((lv_32fc_t*)prod, (lv_32fc_t*)history.window(offset), proto, length);
+                memcpy(fftIn, prod, _channelCount * sizeof(complex_t));
+                for (int i = _channelCount; i < length; i += _channelCount) {
+                    volk_32f_x2_add_32f((float*)fftIn, (float*)fftIn, (float*)&prod[i], 2 * _channelCount);
+                }
+                plan.execute(fftIn, fftOut);
+
+                // Correct the phase of the channels in use. Shifting channel i down advances its
+                // phase by i * pi every output, so odd channels flip sign every other output.
+                for (auto& r : routes) {
+                    if (r.channel < 0) { continue; }
+                    complex_t val = fftOut[r.channel] * rot[r.channel];
+                    r.out->writeBuf[outCount] = (odd && (r.channel & 1)) ? val * -1.0f : val;
+                }
+                odd = !odd;
+                outCount++;
+            }
+            offset -= count;
+
+            history.end();
+
+            return outCount;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            // Only filter if a stream needs a channel, the history is kept up to date either way
+            int outCount = 0;
+            bool filter = false;
+            for (auto& r : routes) {
+                if (r.channel < 0) {
+                    r.out->reserve(count);
+                    memcpy(r.out->writeBuf, base_type::_in->readBuf, count * sizeof(complex_t));
+                    continue;
+                }
+                r.out->reserve(count / decim + 1);
+                filter = true;
+            }
+            if (filter) {
+                outCount = process(count, base_type::_in->readBuf);
+            }
+            else {
+                skip(count, base_type::_in->readBuf);
+            }
+
+            base_type::_in->flush();
+
+            // Swap the streams that got some data
+            for (auto& r : routes) {
+                int n = (r.channel < 0) ? count : outCount;
+                if (!n) { continue; }
+                if (r.mark) {
+                    r.out->mark(r.mark);
+                    r.mark = 0;
+                }
+                if (!r.out->swap(n)) { return -1; }
+            }
+
+            return count;
+        }
+
+    protected:
+        struct Route {
+            stream<complex_t>* out;
+            int channel;
+            int mark = 0;   // Mark of the next chunk, set when switching channels
+        };
+
+        std::vector<Route>::iterator find(stream<complex_t>* stream) {
+            return std::find_if(routes.begin(), routes.end(), [stream](const Route& r) { return r.out == stream; });
+        }
+
+        bool fits(int channel, double offset, double bandwidth, double samplerate) {
+            double spacing = samplerate / (double)_channelCount;
+            return fabs(offset - getChannelOffset(channel, samplerate)) + bandwidth / 2.0 <= CHANNELIZER_PASSBAND * spacing;
+        }
+
+        // Go through a chunk without computing the channels
+        void skip(int count, const complex_t* in) {
+            history.begin(in, count);
+            int outputs = (count - offset + decim - 1) / decim;
+            offset += outputs * decim - count;
+            if (outputs & 1) { odd = !odd; }
+            history.end();
+        }
+
+        int _channelCount;
+        int decim;
+        int branchTaps;
+        int length;
+
+        float* proto;
+        complex_t* prod;
+        complex_t* rot;
+        buffer::History<complex_t> history;
+        int offset = 0;
+        bool odd = false;
+
+        complex_t* fftIn;
+        complex_t* fftOut;
+        fft::Plan plan;
+
+        std::vector<Route> routes;
+    };
+}
@@ -16,6 +16,9 @@ namespace dsp::channel {
             phase = lv_cmake(1.0f, 0.0f);
             phaseDelta = lv_cmake(cos(offset), sin(offset));
             base_type::init(in);
+
+            // The output grows to the size of the chunks, see run()
+            base_type::out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
         }
 
         void init(stream<complex_t>* in, double offset, double samplerate) {
@@ -24,8 +27,8 @@ namespace dsp::channel {
 
         void setOffset(double offset) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            phaseDelta = lv_cmake(cos(offset), sin(offset));
+            lv_32fc_t delta = lv_cmake(cos(offset), sin(offset));
+            base_type::postUpdate([this, delta]() { phaseDelta = delta; });
         }
 
         void setOffset(double offset, double samplerate) {
@@ -34,10 +37,7 @@ namespace dsp::channel {
 
         void reset() {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            tempStop();
-            phase = lv_cmake(1.0f, 0.0f);
-            tempStart();
+            base_type::postUpdate([this]() { phase = lv_cmake(1.0f, 0.0f); });
         }
 
         inline int process(int count, const complex_t* in, complex_t* out) {
@@ -53,6 +53,7 @@ namespace dsp::channel {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            base_type::out.reserve(count);
             process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
             base_type::_in->flush();
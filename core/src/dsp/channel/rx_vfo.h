@@ -1,8 +1,22 @@
 #pragma once
+#include <deque>
 #include "frequency_xlator.h"
+#include "xlating_decimator.h"
+#include "channelizer.h"
 #include "../multirate/rational_resampler.h"
 
+// Smallest decimation worth translating after the first filter instead of before it
+#define RXVFO_SHIFT_MIN_DECIM       8
+
+// Samplerate left after the shifted filter, relative to the output samplerate
+#define RXVFO_SHIFT_OVERSAMPLING    4
+
 namespace dsp::channel {
+    /**
+     * Channel VFO, translating a band of the input down to baseband and resampling it to the output samplerate.
+     * When the band is decimated by a large enough ratio, the translation is folded into the first decimation
+     * stage by shifting its taps to the offset, leaving only a rotation at the decimated samplerate.
+     */
     class RxVFO : public Processor<complex_t, complex_t> {
         using base_type = Processor<complex_t, complex_t>;
     public:
@@ -22,87 +36,131 @@ namespace dsp::channel {
             _bandwidth = bandwidth;
             _offset = offset;
             filterNeeded = (_bandwidth != _outSamplerate);
-            ftaps.taps = NULL;
+            _bandSamplerate = _inSamplerate;
+            _bandOffset = 0.0;
+            _shiftDecim = shiftDecimation(_inSamplerate, _outSamplerate);
+            shiftDecim = _shiftDecim;
 
             xlator.init(NULL, -_offset, _inSamplerate);
-            resamp.init(NULL, _inSamplerate, _outSamplerate);
-            generateTaps();
+            xdecim.init(NULL, _offset, _inSamplerate, _shiftDecim, _outSamplerate);
+            resamp.init(NULL, _inSamplerate / (double)_shiftDecim, _outSamplerate);
+            ftaps = designTaps();
             filter.init(NULL, ftaps);
 
             base_type::init(in);
+
+            // The output grows to the size of the chunks, see run()
+            base_type::out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
         }
 
+        // The setters prepare the new filters and resampling plan, the worker only swaps them in at the next chunk
+
         void setInSamplerate(double inSamplerate) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
             _inSamplerate = inSamplerate;
-            xlator.setOffset(-_offset, _inSamplerate);
-            resamp.setInSamplerate(_inSamplerate);
-            base_type::tempStart();
+            route();
+            retune(true);
         }
 
         void setOutSamplerate(double outSamplerate, double bandwidth) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
             _outSamplerate = outSamplerate;
             _bandwidth = bandwidth;
-            filterNeeded = (_bandwidth != _outSamplerate);
-            resamp.setOutSamplerate(_outSamplerate);
-            if (filterNeeded) {
-                generateTaps();
-                filter.setTaps(ftaps);
-            }
-            base_type::tempStart();
+            bool needed = (_bandwidth != _outSamplerate);
+            route();
+            tap<float> newTaps = needed ? designTaps() : tap<float>();
+            retune(true, [this, needed, newTaps]() mutable {
+                if (needed) { swapTaps(newTaps); }
+                filterNeeded = needed;
+            });
         }
 
         void setBandwidth(double bandwidth) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            std::lock_guard<std::mutex> lck2(filterMtx);
             _bandwidth = bandwidth;
-            filterNeeded = (_bandwidth != _outSamplerate);
-            if (filterNeeded) {
-                generateTaps();
-                filter.setTaps(ftaps);
-            }
+            bool needed = (_bandwidth != _outSamplerate);
+
+            // A wider band may not fit in the current channel anymore
+            bool replan = route();
+            tap<float> newTaps = needed ? designTaps() : tap<float>();
+            retune(replan, [this, needed, newTaps]() mutable {
+                if (needed) { swapTaps(newTaps); }
+                filterNeeded = needed;
+            });
         }
 
         void setOffset(double offset) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             _offset = offset;
-            xlator.setOffset(-_offset, _inSamplerate);
+            retune(route());
         }
 
-        void reset() {
+        /**
+         * Read the input from a channel of a channelizer feeding the input stream, or from the whole band
+         * if chan is NULL. The channel is picked to contain the VFO's band and follows it as it's retuned,
+         * the whole band is used whenever it doesn't fit in a single channel. The input stream must be
+         * bound to the channelizer before it's set, and only unbound after it's been unset.
+         */
+        void setChannelizer(Channelizer* chan) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            xlator.reset();
-            resamp.reset();
-            filter.reset();
-            base_type::tempStart();
+            if (this->chan && channel >= 0) { this->chan->setChannel(base_type::_in, -1); }
+
+            // The old channelizer may be unbound before it marks anything, so the changes held for it go through now
+            base_type::postUpdate([this]() { switchTo(0); });
+            this->chan = chan;
+            channel = -1;
+            route();
+            retune(true);
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            base_type::postUpdate([this]() {
+                xlator.reset();
+                xdecim.reset();
+                resamp.reset();
+                filter.reset();
+            });
         }
 
         inline int process(int count, const complex_t* in, complex_t* out) {
-            xlator.process(count, in, out);
+            if (shiftDecim > 1) {
+                count = xdecim.process(count, in, out);
+            }
+            else {
+                xlator.process(count, in, out);
+            }
             if (!filterNeeded) {
                 return resamp.process(count, out, out);
             }
             count = resamp.process(count, out, out);
-            {
-                std::lock_guard<std::mutex> lck(filterMtx);
-                filter.process(count, out, out);
-            }
+            filter.process(count, out, out);
             return count;
         }
 
+        // Upper bound of the number of samples process() writes to out, the translated input included
+        inline int maxOutputCount(int count) {
+            return std::max<int>(count, resamp.maxOutputCount(count));
+        }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            // The first chunk of a new channel is marked. The changes planned for it are posted before the
+            // channelizer is asked to switch, but may not have been applied yet.
+            int mark = base_type::_in->readMark();
+            if (mark) {
+                base_type::applyUpdates();
+                switchTo(mark);
+            }
+
+            out.reserve(maxOutputCount(count));
             int outCount = process(count, base_type::_in->readBuf, out.writeBuf);
 
             // Swap if some data was generated
@@ -114,13 +172,113 @@ namespace dsp::channel {
         }
 
     protected:
-        void generateTaps() {
-            taps::free(ftaps);
+        /**
+         * Pick the band to read from for the current settings. A new channel is only requested from the
+         * channelizer by retune(), once the changes for it are posted. Returns true if the samplerate of the band changed.
+         */
+        bool route() {
+            double samplerate = _inSamplerate;
+            _bandOffset = 0.0;
+            if (chan) {
+                // The channel needs to hold everything the resampler and filter let through
+                int ch = chan->select(_offset, std::min<double>(_bandwidth, _outSamplerate), _inSamplerate, channel);
+                if (ch != channel) {
+                    if (++lastMark <= 0) { lastMark = 1; }
+                    switchMark = lastMark;
+                    channel = ch;
+                }
+                if (channel >= 0) {
+                    samplerate = chan->getChannelSamplerate(_inSamplerate);
+                    _bandOffset = chan->getChannelOffset(channel, _inSamplerate);
+                }
+            }
+            bool changed = (samplerate != _bandSamplerate);
+            _bandSamplerate = samplerate;
+            return changed;
+        }
+
+        /**
+         * Tune to the offset within the band, and replan the resampler if asked to or if the translation moves
+         * to another stage. The worker then runs the then callback, if any, along with the rest of the change.
+         * If route() picked another channel, the change is held until the first chunk of that channel.
+         */
+        void retune(bool replan, std::function<void()> then = NULL) {
+            double offset = _offset - _bandOffset;
+            double samplerate = _bandSamplerate;
+
+            // Shifting the taps means designing a new filter, so it's done here rather than by the worker
+            int decim = shiftDecimation(samplerate, _outSamplerate);
+            if (decim != _shiftDecim) { replan = true; }
+            bool enter = (decim > 1 && _shiftDecim == 1);
+            _shiftDecim = decim;
+            auto xcfg = (decim > 1) ? XlatingDecimator::plan(offset, samplerate, decim, _outSamplerate) : XlatingDecimator::Config{};
+            auto cfg = replan ? resamp.plan(samplerate / (double)decim, _outSamplerate) : multirate::RationalResampler<complex_t>::Config{};
+
+            std::function<void()> update = [this, offset, samplerate, decim, enter, xcfg, replan, cfg, then]() mutable {
+                if (decim > 1) {
+                    xdecim.apply(xcfg);
+                    if (enter) { xdecim.reset(); }
+                }
+                else {
+                    xlator.setOffset(-offset, samplerate);
+                }
+                shiftDecim = decim;
+                if (replan) { resamp.apply(cfg); }
+                if (then) { then(); }
+            };
+
+            // Chunks still queued for the old channel must go through the old plan
+            int mark = switchMark;
+            base_type::postUpdate([this, mark, update]() {
+                if (mark) { switches.push_back({ mark, { update } }); }
+                else if (!switches.empty()) { switches.back().updates.push_back(update); }
+                else { update(); }
+            });
+            if (mark) {
+                chan->setChannel(base_type::_in, channel, mark);
+                switchMark = 0;
+            }
+        }
+
+        /**
+         * Apply the changes held for the channel switches up to the one with the given mark, all of them if
+         * there's none, and clear the samples of the old channel from the stages running at its samplerate.
+         * The output filter is left alone, its input is at baseband either way. Only called by the worker.
+         */
+        void switchTo(int mark) {
+            while (!switches.empty()) {
+                Switch sw = std::move(switches.front());
+                switches.pop_front();
+                for (auto& update : sw.updates) { update(); }
+                if (sw.mark == mark) { break; }
+            }
+            xlator.reset();
+            xdecim.reset();
+            resamp.reset();
+        }
+
+        // Decimation of the shifted filter for a band and output samplerate, 1 if translating before resampling is cheaper
+        static int shiftDecimation(double samplerate, double outSamplerate) {
+            int decim = 1;
+            while (samplerate / (double)(decim * 2) >= RXVFO_SHIFT_OVERSAMPLING * outSamplerate) { decim *= 2; }
+            return (decim >= RXVFO_SHIFT_MIN_DECIM) ? decim : 1;
+        }
+
+        tap<float> designTaps() {
             double filterWidth = _bandwidth / 2.0;
-            ftaps = taps::lowPass(filterWidth, filterWidth * 0.1, _outSamplerate);
+            return taps::lowPass(filterWidth, filterWidth * 0.1, _outSamplerate);
+        }
+
+        // Switch the filter to new taps, only called by the worker or while it isn't running
+        void swapTaps(tap<float>& newTaps) {
+            filter.setTaps(newTaps);
+            taps::free(ftaps);
+            ftaps = newTaps;
         }
 
         FrequencyXlator xlator;
+        XlatingDecimator xdecim;
+        int shiftDecim;
         multirate::RationalResampler<complex_t> resamp;
         filter::FIR<complex_t, float> filter;
         tap<float> ftaps;
@@ -131,6 +289,20 @@ namespace dsp::channel {
         double _bandwidth;
         double _offset;
 
-        std::mutex filterMtx;
+        // Band the input is read from, the whole input or a channel of the channelizer
+        Channelizer* chan = NULL;
+        int channel = -1;
+        double _bandSamplerate;
+        double _bandOffset;
+        int _shiftDecim;
+
+        // Channel switches requested from the channelizer, each with the changes to apply from its first chunk on
+        struct Switch {
+            int mark;
+            std::vector<std::function<void()>> updates;
+        };
+        std::deque<Switch> switches;
+        int lastMark = 0;
+        int switchMark = 0;
     };
 }
\ No newline at end of file
@@ -0,0 +1,175 @@
+#pragma once
+#include "frequency_xlator.h"
+#include "../filter/symmetric.h"
+#include "../taps/low_pass.h"
+#include "../buffer/history.h"
+
+namespace dsp::channel {
+    /**
+     * Frequency translating decimator, bringing the band around an offset down to baseband while decimating.
+     * Rather than rotating every input sample before a lowpass filter, the lowpass is shifted up to the offset
+     * and only the outputs are rotated back down, at the output samplerate. Retuning changes the taps and the
+     * rotation but keeps the phase of the rotation, so the output stays continuous like with FrequencyXlator.
+     */
+    class XlatingDecimator : public Processor<complex_t, complex_t> {
+        using base_type = Processor<complex_t, complex_t>;
+    public:
+        // Taps for a tuning, computed ahead of time so that only cheap changes are left to the worker
+        struct Config {
+            double offset;
+            double samplerate;
+            int decimation;
+            filter::symmetric::Shifted folded;
+            tap<complex_t> taps;    // Taps in full, only if they couldn't be folded
+        };
+
+        XlatingDecimator() {}
+
+        XlatingDecimator(stream<complex_t>* in, double offset, double samplerate, int decimation, double passband) { init(in, offset, samplerate, decimation, passband); }
+
+        ~XlatingDecimator() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            filter::symmetric::free(folded);
+            taps::free(ftaps);
+        }
+
+        void init(stream<complex_t>* in, double offset, double samplerate, int decimation, double passband) {
+            _samplerate = samplerate;
+            _decimation = decimation;
+            _passband = passband;
+
+            xlator.init(NULL, 0.0, 1.0);
+            Config cfg = plan(offset, _samplerate, _decimation, _passband);
+            history.init(0);
+            apply(cfg);
+
+            base_type::init(in);
+
+            // The output grows to the size of the chunks, see run()
+            base_type::out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
+        }
+
+        void setOffset(double offset) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            Config cfg = plan(offset, _samplerate, _decimation, _passband);
+            base_type::postUpdate([this, cfg]() mutable { apply(cfg); });
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            base_type::postUpdate([this]() {
+                history.clear();
+                xlator.reset();
+                offset = 0;
+            });
+        }
+
+        /**
+         * Compute the taps for a tuning without touching the decimator. The lowpass passes passband / 2 on each
+         * side of the offset and stops everything that would alias into that band after decimation.
+         */
+        static Config plan(double offset, double samplerate, int decimation, double passband) {
+            Config cfg;
+            cfg.offset = offset;
+            cfg.samplerate = samplerate;
+            cfg.decimation = decimation;
+            cfg.taps.taps = NULL;
+            cfg.taps.size = 0;
+
+            double outSamplerate = samplerate / (double)decimation;
+            tap<float> lp = taps::lowPass(outSamplerate / 2.0, outSamplerate - passband, samplerate, true);
+            double omega = math::hzToRads(offset, samplerate);
+
+            // Without a kernel for folded taps, apply the shifted taps in full. They're in the order they're
+            // applied to the window, the oldest sample being delayed by size - 1.
+            if (!filter::symmetric::shift(lp, omega, cfg.folded)) {
+                cfg.taps = taps::alloc<complex_t>(lp.size);
+                for (int i = 0; i < (int)lp.size; i++) {
+                    double phase = omega * (double)(lp.size - 1 - i);
+                    cfg.taps.taps[i] = { (float)(lp.taps[i] * cos(phase)), (float)(lp.taps[i] * sin(phase)) };
+                }
+            }
+
+            taps::free(lp);
+            return cfg;
+        }
+
+        /**
+         * Switch to a tuning, taking over its taps. Must only be called by the worker or while it isn't running,
+         * e.g. from an update posted by a block using the decimator through process().
+         */
+        void apply(Config& cfg) {
+            // A different decimation restarts the output phase
+            if (cfg.decimation != _decimation) { offset = 0; }
+            _samplerate = cfg.samplerate;
+            _decimation = cfg.decimation;
+
+            // Swap the taps, keeping the most recent history
+            filter::symmetric::free(folded);
+            taps::free(ftaps);
+            folded = cfg.folded;
+            ftaps = cfg.taps;
+            history.resize((folded.pairs ? folded.size : ftaps.size) - 1);
+
+            xlator.setOffset(-cfg.offset, _samplerate / (double)_decimation);
+        }
+
+        inline int process(int count, const complex_t* in, complex_t* out) {
+            // Outputs can't overwrite the input before it's used, so the chunk is only read directly when not in place
+            if (in == out) {
+                history.load(in, count);
+            }
+            else {
+                history.begin(in, count);
+            }
+
+            // Filter the band at the offset
+            int outCount = 0;
+            for (; offset < count; offset += _decimation) {
+#if defined(DSP_SYMMETRIC_AVX) || defined(DSP_SYMMETRIC_NEON)
+                if (folded.pairs) {
+                    filter::symmetric::dotShifted(&out[outCount++], history.window(offset), folded);
+                    continue;
+                }
+#endif
+                volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)history.window(offset), (lv_32fc_t*)ftaps.taps, ftaps.size);
+            }
+            offset -= count;
+
+            history.end();
+
+            // Bring it down to baseband
+            xlator.process(outCount, out, out);
+
+            return outCount;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            base_type::out.reserve(count / _decimation + 1);
+            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            // Swap if some data was generated
+            base_type::_in->flush();
+            if (outCount) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return outCount;
+        }
+
+    protected:
+        FrequencyXlator xlator;
+        filter::symmetric::Shifted folded;
+        tap<complex_t> ftaps;
+        buffer::History<complex_t> history;
+        int offset = 0;
+
+        double _samplerate;
+        int _decimation;
+        double _passband;
+    };
+}
@@ -4,6 +4,7 @@
 #include "../taps/windowed_sinc.h"
 #include "../multirate/polyphase_bank.h"
 #include "../math/step.h"
+#include "../buffer/history.h"
 
 namespace dsp::clock_recovery {
     template<class T>
@@ -18,7 +19,6 @@ namespace dsp::clock_recovery {
             if (!base_type::_block_init) { return; }
             base_type::stop();
             dsp::multirate::freePolyphaseBank(interpBank);
-            buffer::free(buffer);
         }
 
         void init(stream<T>* in, double omega, double omegaGain, double muGain, double omegaRelLimit, int interpPhaseCount = 128, int interpTapCount = 8) {
@@ -31,9 +31,8 @@ namespace dsp::clock_recovery {
 
             pcl.init(_muGain, _omegaGain, 0.0, 0.0, 1.0, _omega, _omega * (1.0 - omegaRelLimit), _omega * (1.0 + omegaRelLimit));
             generateInterpTaps();
-            buffer = buffer::alloc<T>(STREAM_BUFFER_SIZE + _interpTapCount);
-            bufStart = &buffer[_interpTapCount - 1];
-        
+            history.init(_interpTapCount - 1);
+
             base_type::init(in);
         }
 
@@ -77,10 +76,8 @@ namespace dsp::clock_recovery {
             _interpPhaseCount = interpPhaseCount;
             _interpTapCount = interpTapCount;
             dsp::multirate::freePolyphaseBank(interpBank);
-            buffer::free(buffer);
             generateInterpTaps();
-            buffer = buffer::alloc<T>(STREAM_BUFFER_SIZE + _interpTapCount);
-            bufStart = &buffer[_interpTapCount - 1];
+            history.resize(_interpTapCount - 1);
             base_type::tempStart();
         }
 
@@ -98,8 +95,13 @@ namespace dsp::clock_recovery {
         }
 
         inline int process(int count, const T* in, T* out) {
-            // Copy data to work buffer
-            memcpy(bufStart, in, count * sizeof(T));
+            // Symbols are written over the samples when recovering in place, so the chunk is only read directly when not in place
+            if (in == out) {
+                history.load(in, count);
+            }
+            else {
+                history.begin(in, count);
+            }
 
             // Process all samples
             int outCount = 0;
@@ -110,10 +112,10 @@ namespace dsp::clock_recovery {
                 // Calculate new output value
                 int phase = std::clamp<int>(floorf(pcl.phase * (float)_interpPhaseCount), 0, _interpPhaseCount - 1);
                 if constexpr (std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&outVal, &buffer[offset], interpBank.phases[phase], _interpTapCount);
+                    volk_32f_x2_dot_prod_32f(&outVal, history.window(offset), interpBank.phases[phase], _interpTapCount);
                 }
                 if constexpr (std::is_same_v<T, complex_t>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&outVal, (lv_32fc_t*)&buffer[offset], interpBank.phases[phase], _interpTapCount);
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&outVal, (lv_32fc_t*)history.window(offset), interpBank.phases[phase], _interpTapCount);
                 }
                 out[outCount++] = outVal;
 
@@ -149,8 +151,7 @@ namespace dsp::clock_recovery {
             }
             offset -= count;
 
-            // Update delay buffer
-            memmove(buffer, &buffer[count], (_interpTapCount - 1) * sizeof(T));
+            history.end();
 
             return outCount;
         }
@@ -193,7 +194,6 @@ namespace dsp::clock_recovery {
         complex_t _c_0T = { 0.0f, 0.0f }, _c_1T = { 0.0f, 0.0f }, _c_2T = { 0.0f, 0.0f };
 
         int offset = 0;
-        T* buffer;
-        T* bufStart;
+        buffer::History<T> history;
     };
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "../processor.h"
+#include "../filter/iir1.h"
 
 namespace dsp::correction {
     template<class T>
@@ -20,6 +21,8 @@ namespace dsp::correction {
             if constexpr (std::is_same_v<T, complex_t> || std::is_same_v<T, stereo_t>) {
                 offset = { 0.0f, 0.0f };
             }
+            lookahead.setCoeffs(_rate, 1.0 - _rate);
+            lookahead.reset();
             base_type::init(in);
         }
 
@@ -31,12 +34,31 @@ namespace dsp::correction {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             _rate = rate;
+            lookahead.setCoeffs(_rate, 1.0 - _rate);
         }
 
         void setRate(double rate, double samplerate)  {
             setRate(rate / samplerate);
         }
 
+        // Filter in look-ahead form (default), see filter::iir1::Lookahead, or one sample at a time
+        void setParallel(bool parallel) {
+            assert(base_type::_block_init);
+            base_type::postUpdate([this, parallel]() {
+                if (parallel == _parallel) { return; }
+
+                // Carry the offset over to the other form
+                float* off = (float*)&offset;
+                if (parallel) {
+                    lookahead.reset(off);
+                }
+                else {
+                    for (int c = 0; c < CHANNELS; c++) { off[c] = lookahead.last(c); }
+                }
+                _parallel = parallel;
+            });
+        }
+
         void reset() {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
@@ -47,11 +69,16 @@ namespace dsp::correction {
             if constexpr (std::is_same_v<T, complex_t> || std::is_same_v<T, stereo_t>) {
                 offset = { 0.0f, 0.0f };
             }
+            lookahead.reset();
             base_type::tempStart();
         }
 
         // TODO: Add back the const
         int process(int count, T* in, T* out) {
+            if (_parallel) {
+                lookahead.highPass((const float*)in, (float*)out, count);
+                return count;
+            }
             for (int i = 0; i < count; i++) {
                 out[i] = in[i] - offset;
                 offset += out[i] * _rate;
@@ -71,7 +98,11 @@ namespace dsp::correction {
         }
 
     protected:
+        static constexpr int CHANNELS = sizeof(T) / sizeof(float);
+
         float _rate;
         T offset;
+        bool _parallel = true;
+        filter::iir1::Lookahead<CHANNELS> lookahead;
     };
 }
\ No newline at end of file
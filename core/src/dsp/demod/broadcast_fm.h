@@ -143,12 +143,14 @@ namespace dsp::demod {
 
         inline int process(int count, complex_t* in, stereo_t* out, int& rdsOutCount, complex_t* rdsout = NULL) {
             // Demodulate
+            demod.out.reserve(count);
             demod.process(count, in, demod.out.writeBuf);
             if (_stereo) {
                 // Convert to complex
                 rtoc.process(count, demod.out.writeBuf, rtoc.out.writeBuf);
 
                 // Filter out pilot and run through PLL
+                pilotFir.out.reserve(count);
                 pilotFir.process(count, rtoc.out.writeBuf, pilotFir.out.writeBuf);
                 pilotPLL.process(count, pilotFir.out.writeBuf, pilotPLL.out.writeBuf);
 
@@ -55,6 +55,7 @@ namespace dsp::demod {
         }
 
         inline int process(int count, const complex_t* in, T* out) {
+            xlator.out.reserve(count);
             xlator.process(count, in, xlator.out.writeBuf);
             if constexpr (std::is_same_v<T, float>) {
                 dsp::convert::ComplexToReal::process(count, xlator.out.writeBuf, out);
@@ -92,6 +92,7 @@ namespace dsp::demod {
                 }
             }
             if constexpr (std::is_same_v<T, stereo_t>) {
+                demod.out.reserve(count);
                 demod.process(count, in, demod.out.writeBuf);
                 if (filtering) {
                     std::lock_guard<std::mutex> lck(filterMtx);
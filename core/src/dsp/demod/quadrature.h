@@ -1,6 +1,6 @@
 #pragma once
 #include "../processor.h"
-#include "../math/fast_atan2.h"
+#include "quadrature_kernel.h"
 #include "../math/hz_to_rads.h"
 #include "../math/normalize_phase.h"
 
@@ -8,6 +8,11 @@ namespace dsp::demod {
     class Quadrature : public Processor<complex_t, float> {
         using base_type = Processor<complex_t, float>;
     public:
+        enum Accuracy {
+            EXACT,  // Within a few 1e-7 rad of atan2f
+            FAST,   // Same approximation as math::fastAtan2, within 0.07 rad
+        };
+
         Quadrature() {}
 
         Quadrature(stream<complex_t>* in, double deviation) { init(in, deviation); }
@@ -18,6 +23,9 @@ namespace dsp::demod {
         virtual void init(stream<complex_t>* in, double deviation) {
             _invDeviation = 1.0 / deviation;
             base_type::init(in);
+
+            // The output grows to the size of the chunks, see run()
+            base_type::out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
         }
 
         virtual void init(stream<complex_t>* in, double deviation, double samplerate) {
@@ -36,11 +44,19 @@ namespace dsp::demod {
             _invDeviation = 1.0 / math::hzToRads(deviation, samplerate);
         }
 
+        void setAccuracy(Accuracy accuracy) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            _accuracy = accuracy;
+        }
+
         inline int process(int count, complex_t* in, float* out) {
-            for (int i = 0; i < count; i++) {
-                float cphase = in[i].phase();
-                out[i] = math::normalizePhase(cphase - phase) * _invDeviation;
-                phase = cphase;
+            // Only the last sample is carried over, the phase differences are computed from the products of consecutive samples
+            if (_accuracy == FAST) {
+                last = quadrature::process<true>(count, in, out, last, _invDeviation);
+            }
+            else {
+                last = quadrature::process<false>(count, in, out, last, _invDeviation);
             }
             return count;
         }
@@ -48,13 +64,14 @@ namespace dsp::demod {
         void reset() {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            phase = 0.0f;
+            last = { 1.0f, 0.0f };
         }
 
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            base_type::out.reserve(count);
             process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
             base_type::_in->flush();
@@ -64,6 +81,7 @@ namespace dsp::demod {
 
     protected:
         float _invDeviation;
-        float phase = 0.0f;
+        Accuracy _accuracy = EXACT;
+        complex_t last = { 1.0f, 0.0f };
     };
 }
\ No newline at end of file
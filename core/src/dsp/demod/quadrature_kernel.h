@@ -0,0 +1,260 @@
+#pragma once
+#include <math.h>
+#include <algorithm>
+#include "../types.h"
+#include "../math/constants.h"
+#include "../math/fast_atan2.h"
+#include "../kernel/kernels.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2__)
+#include <immintrin.h>
+#define DSP_QUADRATURE_SSE
+#define DSP_QUADRATURE_AVX_TARGET __attribute__((target("avx2,fma")))
+#elif (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && defined(_MSC_VER)
+#include <immintrin.h>
+#define DSP_QUADRATURE_SSE
+#define DSP_QUADRATURE_AVX_TARGET
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define DSP_QUADRATURE_NEON
+#endif
+
+// Number of coefficients of the arctangent polynomial
+#define QUADRATURE_ATAN_TERMS   8
+
+namespace dsp::demod::quadrature {
+    /**
+     * Odd polynomial approximating atan(t) over [0, 1] to within 1e-8 (Abramowitz & Stegun 4.4.49), as
+     * coefficients of t^2 from the highest power down. With the rounding of floats the result is within
+     * a few 1e-7 rad of atan2f.
+     */
+    inline constexpr float ATAN_POLY[QUADRATURE_ATAN_TERMS] = {
+        -0.0040540580f, 0.0218612288f, -0.0559098861f, 0.0964200441f,
+        -0.1390853351f, 0.1994653599f, -0.3332985605f, 0.9999993329f
+    };
+
+    // Argument of x + jy, through the polynomial or math::fastAtan2 if FAST
+    template <bool FAST>
+    inline float atan2(float x, float y) {
+        if constexpr (FAST) {
+            return math::fastAtan2(x, y);
+        }
+        else {
+            float ax = fabsf(x);
+            float ay = fabsf(y);
+            float mx = std::max<float>(ax, ay);
+            if (mx == 0.0f) { return 0.0f; }
+
+            // Reduce to the first octant
+            float t = std::min<float>(ax, ay) / mx;
+            float s = t * t;
+            float p = ATAN_POLY[0];
+            for (int k = 1; k < QUADRATURE_ATAN_TERMS; k++) { p = p * s + ATAN_POLY[k]; }
+            float angle = p * t;
+            if (ay > ax) { angle = (FL_M_PI / 2.0f) - angle; }
+            if (x < 0.0f) { angle = FL_M_PI - angle; }
+            return (y < 0.0f) ? -angle : angle;
+        }
+    }
+
+    // Argument of a * conj(b)
+    template <bool FAST>
+    inline float difference(const complex_t& a, const complex_t& b) {
+        return atan2<FAST>(a.re * b.re + a.im * b.im, a.im * b.re - a.re * b.im);
+    }
+
+    // Phase differences one sample at a time, in[-1] must be readable. Returns the number done.
+    template <bool FAST>
+    inline int differencesScalar(const complex_t* in, float* out, int count, float scale) {
+        for (int i = 0; i < count; i++) {
+            out[i] = difference<FAST>(in[i], in[i - 1]) * scale;
+        }
+        return count;
+    }
+
+#if defined(DSP_QUADRATURE_SSE)
+    template <bool FAST>
+    inline __m128 atan2(__m128 x, __m128 y) {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        __m128 ay = _mm_andnot_ps(sign, y);
+        __m128 angle;
+        if constexpr (FAST) {
+            // Same steps as math::fastAtan2, den is only zero if x and y are
+            const __m128 c1 = _mm_set1_ps(FAST_ATAN2_COEF1);
+            const __m128 c2 = _mm_set1_ps(FAST_ATAN2_COEF2);
+            __m128 pos = _mm_cmpge_ps(x, zero);
+            __m128 sum = _mm_add_ps(x, ay);
+            __m128 num = _mm_or_ps(_mm_and_ps(pos, _mm_sub_ps(x, ay)), _mm_andnot_ps(pos, sum));
+            __m128 den = _mm_or_ps(_mm_and_ps(pos, sum), _mm_andnot_ps(pos, _mm_sub_ps(ay, x)));
+            __m128 base = _mm_or_ps(_mm_and_ps(pos, c1), _mm_andnot_ps(pos, c2));
+            angle = _mm_sub_ps(base, _mm_mul_ps(c1, _mm_div_ps(num, den)));
+            angle = _mm_and_ps(angle, _mm_cmpneq_ps(den, zero));
+        }
+        else {
+            __m128 ax = _mm_andnot_ps(sign, x);
+            __m128 mx = _mm_max_ps(ax, ay);
+            __m128 t = _mm_and_ps(_mm_div_ps(_mm_min_ps(ax, ay), mx), _mm_cmpgt_ps(mx, zero));
+            __m128 s = _mm_mul_ps(t, t);
+            __m128 p = _mm_set1_ps(ATAN_POLY[0]);
+            for (int k = 1; k < QUADRATURE_ATAN_TERMS; k++) { p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(ATAN_POLY[k])); }
+            angle = _mm_mul_ps(p, t);
+            __m128 swap = _mm_cmpgt_ps(ay, ax);
+            angle = _mm_or_ps(_mm_and_ps(swap, _mm_sub_ps(_mm_set1_ps(FL_M_PI / 2.0f), angle)), _mm_andnot_ps(swap, angle));
+            __m128 neg = _mm_cmplt_ps(x, zero);
+            angle = _mm_or_ps(_mm_and_ps(neg, _mm_sub_ps(_mm_set1_ps(FL_M_PI), angle)), _mm_andnot_ps(neg, angle));
+        }
+        return _mm_xor_ps(angle, _mm_and_ps(sign, _mm_cmplt_ps(y, zero)));
+    }
+
+    // Phase differences of the first count rounded down to 4 samples, in[-1] must be readable. Returns the number done.
+    template <bool FAST>
+    inline int differences(const complex_t* in, float* out, int count, float scale) {
+        const __m128 vscale = _mm_set1_ps(scale);
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 a0 = _mm_loadu_ps((const float*)&in[i]);
+            __m128 a1 = _mm_loadu_ps((const float*)&in[i + 2]);
+            __m128 b0 = _mm_loadu_ps((const float*)&in[i - 1]);
+            __m128 b1 = _mm_loadu_ps((const float*)&in[i + 1]);
+            __m128 are = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 aim = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1));
+            __m128 bre = _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 bim = _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1));
+
+            // in[i] * conj(in[i - 1])
+            __m128 x = _mm_add_ps(_mm_mul_ps(are, bre), _mm_mul_ps(aim, bim));
+            __m128 y = _mm_sub_ps(_mm_mul_ps(aim, bre), _mm_mul_ps(are, bim));
+            _mm_storeu_ps(&out[i], _mm_mul_ps(atan2<FAST>(x, y), vscale));
+        }
+        return i;
+    }
+
+    template <bool FAST>
+    DSP_QUADRATURE_AVX_TARGET inline __m256 atan2(__m256 x, __m256 y) {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        __m256 ay = _mm256_andnot_ps(sign, y);
+        __m256 angle;
+        if constexpr (FAST) {
+            // No FMA here, so that the result is the same as math::fastAtan2
+            const __m256 c1 = _mm256_set1_ps(FAST_ATAN2_COEF1);
+            const __m256 c2 = _mm256_set1_ps(FAST_ATAN2_COEF2);
+            __m256 pos = _mm256_cmp_ps(x, zero, _CMP_GE_OQ);
+            __m256 sum = _mm256_add_ps(x, ay);
+            __m256 num = _mm256_blendv_ps(sum, _mm256_sub_ps(x, ay), pos);
+            __m256 den = _mm256_blendv_ps(_mm256_sub_ps(ay, x), sum, pos);
+            __m256 base = _mm256_blendv_ps(c2, c1, pos);
+            angle = _mm256_sub_ps(base, _mm256_mul_ps(c1, _mm256_div_ps(num, den)));
+            angle = _mm256_and_ps(angle, _mm256_cmp_ps(den, zero, _CMP_NEQ_UQ));
+        }
+        else {
+            __m256 ax = _mm256_andnot_ps(sign, x);
+            __m256 mx = _mm256_max_ps(ax, ay);
+            __m256 t = _mm256_and_ps(_mm256_div_ps(_mm256_min_ps(ax, ay), mx), _mm256_cmp_ps(mx, zero, _CMP_GT_OQ));
+            __m256 s = _mm256_mul_ps(t, t);
+            __m256 p = _mm256_set1_ps(ATAN_POLY[0]);
+            for (int k = 1; k < QUADRATURE_ATAN_TERMS; k++) { p = _mm256_fmadd_ps(p, s, _mm256_set1_ps(ATAN_POLY[k])); }
+            angle = _mm256_mul_ps(p, t);
+            angle = _mm256_blendv_ps(angle, _mm256_sub_ps(_mm256_set1_ps(FL_M_PI / 2.0f), angle), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+            angle = _mm256_blendv_ps(angle, _mm256_sub_ps(_mm256_set1_ps(FL_M_PI), angle), _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+        }
+        return _mm256_xor_ps(angle, _mm256_and_ps(sign, _mm256_cmp_ps(y, zero, _CMP_LT_OQ)));
+    }
+
+    // Same as differences() with 8 samples at a time
+    template <bool FAST>
+    DSP_QUADRATURE_AVX_TARGET inline int differencesAVX(const complex_t* in, float* out, int count, float scale) {
+        const __m256 vscale = _mm256_set1_ps(scale);
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            // The shuffles work within 128 bit lanes, giving samples 0, 1, 4, 5, 2, 3, 6, 7 in this order
+            __m256 a0 = _mm256_loadu_ps((const float*)&in[i]);
+            __m256 a1 = _mm256_loadu_ps((const float*)&in[i + 4]);
+            __m256 b0 = _mm256_loadu_ps((const float*)&in[i - 1]);
+            __m256 b1 = _mm256_loadu_ps((const float*)&in[i + 3]);
+            __m256 are = _mm256_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0));
+            __m256 aim = _mm256_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1));
+            __m256 bre = _mm256_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0));
+            __m256 bim = _mm256_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1));
+
+            // in[i] * conj(in[i - 1])
+            __m256 x = _mm256_fmadd_ps(are, bre, _mm256_mul_ps(aim, bim));
+            __m256 y = _mm256_fmsub_ps(aim, bre, _mm256_mul_ps(are, bim));
+            __m256 res = _mm256_mul_ps(atan2<FAST>(x, y), vscale);
+
+            // Back in order
+            res = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(res), _MM_SHUFFLE(3, 1, 2, 0)));
+            _mm256_storeu_ps(&out[i], res);
+        }
+        return i;
+    }
+#elif defined(DSP_QUADRATURE_NEON)
+    template <bool FAST>
+    inline float32x4_t atan2(float32x4_t x, float32x4_t y) {
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        float32x4_t ay = vabsq_f32(y);
+        float32x4_t angle;
+        if constexpr (FAST) {
+            // Same steps as math::fastAtan2, den is only zero if x and y are
+            const float32x4_t c1 = vdupq_n_f32(FAST_ATAN2_COEF1);
+            uint32x4_t pos = vcgeq_f32(x, zero);
+            float32x4_t sum = vaddq_f32(x, ay);
+            float32x4_t num = vbslq_f32(pos, vsubq_f32(x, ay), sum);
+            float32x4_t den = vbslq_f32(pos, sum, vsubq_f32(ay, x));
+            float32x4_t base = vbslq_f32(pos, c1, vdupq_n_f32(FAST_ATAN2_COEF2));
+            angle = vsubq_f32(base, vmulq_f32(c1, vdivq_f32(num, den)));
+            angle = vbslq_f32(vceqq_f32(den, zero), zero, angle);
+        }
+        else {
+            float32x4_t ax = vabsq_f32(x);
+            float32x4_t mx = vmaxq_f32(ax, ay);
+            float32x4_t t = vdivq_f32(vminq_f32(ax, ay), mx);
+            t = vbslq_f32(vcgtq_f32(mx, zero), t, zero);
+            float32x4_t s = vmulq_f32(t, t);
+            float32x4_t p = vdupq_n_f32(ATAN_POLY[0]);
+            for (int k = 1; k < QUADRATURE_ATAN_TERMS; k++) { p = vfmaq_f32(vdupq_n_f32(ATAN_POLY[k]), p, s); }
+            angle = vmulq_f32(p, t);
+            angle = vbslq_f32(vcgtq_f32(ay, ax), vsubq_f32(vdupq_n_f32(FL_M_PI / 2.0f), angle), angle);
+            angle = vbslq_f32(vcltq_f32(x, zero), vsubq_f32(vdupq_n_f32(FL_M_PI), angle), angle);
+        }
+        return vbslq_f32(vcltq_f32(y, zero), vnegq_f32(angle), angle);
+    }
+
+    // Phase differences of the first count rounded down to 4 samples, in[-1] must be readable. Returns the number done.
+    template <bool FAST>
+    inline int differences(const complex_t* in, float* out, int count, float scale) {
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            float32x4x2_t a = vld2q_f32((const float*)&in[i]);
+            float32x4x2_t b = vld2q_f32((const float*)&in[i - 1]);
+
+            // in[i] * conj(in[i - 1])
+            float32x4_t x = vfmaq_f32(vmulq_f32(a.val[1], b.val[1]), a.val[0], b.val[0]);
+            float32x4_t y = vfmsq_f32(vmulq_f32(a.val[1], b.val[0]), a.val[0], b.val[1]);
+            vst1q_f32(&out[i], vmulq_n_f32(atan2<FAST>(x, y), scale));
+        }
+        return i;
+    }
+#endif
+
+    /**
+     * Phase differences between consecutive samples times scale, out[i] = arg(in[i] * conj(in[i - 1])) * scale,
+     * last standing for in[-1]. Unlike differences of atan2 of each sample, the samples are independent, so they're
+     * computed a vector at a time. Returns the last sample, to be given back as last for the next chunk.
+     */
+    template <bool FAST>
+    inline complex_t process(int count, const complex_t* in, float* out, complex_t last, float scale) {
+        if (count <= 0) { return last; }
+
+        // The first one depends on the previous chunk
+        out[0] = difference<FAST>(in[0], last) * scale;
+
+        // The kernels take the previous sample from the chunk, see kernel::quadrature()
+        int i = 1 + kernel::quadrature(FAST).get(count)(&in[1], &out[1], count - 1, scale);
+        for (; i < count; i++) {
+            out[i] = difference<FAST>(in[i], in[i - 1]) * scale;
+        }
+        return in[count - 1];
+    }
+}
@@ -76,6 +76,7 @@ namespace dsp::demod {
 
         int process(int count, const complex_t* in, T* out) {
             // Move back sideband
+            xlator.out.reserve(count);
             xlator.process(count, in, xlator.out.writeBuf);
 
             if constexpr (std::is_same_v<T, float>) {
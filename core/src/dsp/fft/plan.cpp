@@ -0,0 +1,472 @@
+#include "plan.h"
+#include <math.h>
+#include <string.h>
+#include <mutex>
+#include <map>
+#include <deque>
+#include <tuple>
+#include <thread>
+#include <condition_variable>
+#include <algorithm>
+#include "../math/constants.h"
+
+// Extra bytes allocated for the scratch arrays so that they can be offset to any alignment FFTW cares about
+#define FFT_ALIGN_MARGIN        64
+
+namespace dsp::fft {
+    using Key = std::tuple<int, int, bool, int, int>;
+
+    // The FFTW planner isn't thread-safe, this covers creating and destroying plans and the wisdom
+    static std::mutex plannerMtx;
+
+    // Set while the upgrade thread holds the planner for a measurement
+    static std::atomic<bool> measuring = false;
+
+    static std::mutex cacheMtx;
+    static std::map<Key, std::weak_ptr<PlanEntry>> cache;
+
+    // Background work, the thread is never freed if it's not stopped before exiting
+    static std::mutex upgradeMtx;
+    static std::condition_variable upgradeCnd;
+    static std::deque<std::weak_ptr<PlanEntry>> planQueue;      // Entries waiting for a first FFTW plan
+    static std::deque<std::weak_ptr<PlanEntry>> upgradeQueue;   // Entries waiting for a measured plan
+    static std::vector<fftwf_plan> garbage;                     // Plans released during a measurement
+    static std::thread* upgradeThread = NULL;
+    static bool upgrading = false;
+    static bool upgradeBusy = false;
+    static Rigor upgradeRigor = RIGOR_ESTIMATE;
+    static std::string upgradeWisdomPath;
+
+    struct Fallback {
+        int size;
+        int fftSize;    // Power of two the transform is computed with
+        bool inverse;
+        std::vector<complex_t> twiddles;        // e^(-2j * pi * k / fftSize) for k < fftSize / 2
+        std::vector<complex_t> chirp;           // Bluestein's algorithm if the size isn't a power of two, see transform()
+        std::vector<complex_t> chirpSpectrum;
+    };
+
+    static unsigned rigorFlags(Rigor rigor) {
+        if (rigor == RIGOR_PATIENT) { return FFTW_PATIENT; }
+        if (rigor == RIGOR_MEASURE) { return FFTW_MEASURE; }
+        return FFTW_ESTIMATE;
+    }
+
+    // Lock the planner unless a measurement holds it, other users only hold it briefly
+    static bool lockPlanner(std::unique_lock<std::mutex>& lck) {
+        while (!lck.try_lock()) {
+            if (measuring.load()) { return false; }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    // Must be called with the planner locked
+    static fftwf_plan makePlan(const PlanEntry& e, unsigned flags, void* in, void* out) {
+        switch (e.type) {
+        case FORWARD:
+            return fftwf_plan_dft_1d(e.size, (fftwf_complex*)in, (fftwf_complex*)out, FFTW_FORWARD, flags);
+        case BACKWARD:
+            return fftwf_plan_dft_1d(e.size, (fftwf_complex*)in, (fftwf_complex*)out, FFTW_BACKWARD, flags);
+        case REAL_FORWARD:
+            return fftwf_plan_dft_r2c_1d(e.size, (float*)in, (fftwf_complex*)out, flags);
+        case REAL_BACKWARD:
+            return fftwf_plan_dft_c2r_1d(e.size, (fftwf_complex*)in, (float*)out, flags);
+        default:
+            return NULL;
+        }
+    }
+
+    // Arrays aligned like the ones of an entry, for planning without touching the blocks' data
+    class Scratch {
+    public:
+        Scratch(const PlanEntry& e) {
+            size_t complexBytes = (size_t)e.size * sizeof(complex_t);
+            size_t halfBytes = (size_t)(e.size / 2 + 1) * sizeof(complex_t);
+            size_t realBytes = (size_t)e.size * sizeof(float);
+            size_t inBytes = complexBytes;
+            size_t outBytes = complexBytes;
+            if (e.type == REAL_FORWARD) {
+                inBytes = realBytes;
+                outBytes = halfBytes;
+            }
+            else if (e.type == REAL_BACKWARD) {
+                inBytes = halfBytes;
+                outBytes = realBytes;
+            }
+            if (e.inPlace) { inBytes = std::max<size_t>(inBytes, outBytes); }
+
+            inBuf = (char*)fftwf_malloc(inBytes + FFT_ALIGN_MARGIN);
+            outBuf = e.inPlace ? NULL : (char*)fftwf_malloc(outBytes + FFT_ALIGN_MARGIN);
+            in = &inBuf[e.inAlign];
+            out = e.inPlace ? in : &outBuf[e.outAlign];
+        }
+
+        ~Scratch() {
+            fftwf_free(inBuf);
+            if (outBuf) { fftwf_free(outBuf); }
+        }
+
+        void* in;
+        void* out;
+
+    private:
+        char* inBuf;
+        char* outBuf;
+    };
+
+    // In place power of two FFT, unnormalised like FFTW
+    static void radix2(complex_t* x, int n, const complex_t* twiddles, int twiddleCount, bool inverse) {
+        for (int i = 1, j = 0; i < n; i++) {
+            int bit = n >> 1;
+            for (; j & bit; bit >>= 1) { j ^= bit; }
+            j ^= bit;
+            if (i < j) { std::swap(x[i], x[j]); }
+        }
+
+        float sign = inverse ? -1.0f : 1.0f;
+        for (int len = 2; len <= n; len <<= 1) {
+            int half = len / 2;
+            int step = 2 * twiddleCount / len;
+            for (int i = 0; i < n; i += len) {
+                for (int j = 0; j < half; j++) {
+                    complex_t w = twiddles[j * step];
+                    complex_t a = x[i + j];
+                    complex_t b = x[i + j + half];
+                    float vre = b.re * w.re - sign * b.im * w.im;
+                    float vim = sign * b.re * w.im + b.im * w.re;
+                    x[i + j] = { a.re + vre, a.im + vim };
+                    x[i + j + half] = { a.re - vre, a.im - vim };
+                }
+            }
+        }
+    }
+
+    static std::unique_ptr<Fallback> makeFallback(Type type, int size) {
+        auto f = std::make_unique<Fallback>();
+        f->size = size;
+        f->inverse = (type == BACKWARD || type == REAL_BACKWARD);
+
+        // Bluestein's algorithm needs a linear convolution of 2 * size - 1 samples
+        bool pow2 = !(size & (size - 1));
+        f->fftSize = 1;
+        while (f->fftSize < (pow2 ? size : 2 * size - 1)) { f->fftSize <<= 1; }
+
+        int m = f->fftSize;
+        f->twiddles.resize(std::max<int>(m / 2, 1));
+        for (int k = 0; k < m / 2; k++) {
+            double phase = -2.0 * DB_M_PI * (double)k / (double)m;
+            f->twiddles[k] = { (float)cos(phase), (float)sin(phase) };
+        }
+        if (pow2) { return f; }
+
+        // chirp[k] = e^(-+j * pi * k^2 / size), with k^2 reduced first to keep the phase accurate
+        double sign = f->inverse ? 1.0 : -1.0;
+        f->chirp.resize(size);
+        for (int k = 0; k < size; k++) {
+            double phase = sign * DB_M_PI * (double)(((int64_t)k * k) % (2 * (int64_t)size)) / (double)size;
+            f->chirp[k] = { (float)cos(phase), (float)sin(phase) };
+        }
+
+        // Spectrum of the conjugated chirp, wrapped around for the negative lags
+        f->chirpSpectrum.assign(m, { 0.0f, 0.0f });
+        for (int k = 0; k < size; k++) {
+            complex_t c = { f->chirp[k].re, -f->chirp[k].im };
+            f->chirpSpectrum[k] = c;
+            if (k) { f->chirpSpectrum[m - k] = c; }
+        }
+        radix2(f->chirpSpectrum.data(), m, f->twiddles.data(), m / 2, false);
+        return f;
+    }
+
+    /**
+     * Complex transform of size samples, in can be out. Sizes that aren't a power of two use Bluestein's algorithm,
+     * X[k] = chirp[k] * sum(x[n] * chirp[n] * conj(chirp[k - n])), the sum being a convolution done with FFTs.
+     */
+    static void transform(const Fallback& f, const complex_t* in, complex_t* out) {
+        thread_local std::vector<complex_t> work;
+        int n = f.size;
+        int m = f.fftSize;
+        work.resize(m);
+
+        if (f.chirp.empty()) {
+            memcpy(work.data(), in, n * sizeof(complex_t));
+            radix2(work.data(), m, f.twiddles.data(), m / 2, f.inverse);
+            memcpy(out, work.data(), n * sizeof(complex_t));
+            return;
+        }
+
+        for (int i = 0; i < n; i++) {
+            complex_t x = in[i];
+            complex_t c = f.chirp[i];
+            work[i] = { x.re * c.re - x.im * c.im, x.re * c.im + x.im * c.re };
+        }
+        std::fill(work.begin() + n, work.end(), complex_t{ 0.0f, 0.0f });
+        radix2(work.data(), m, f.twiddles.data(), m / 2, false);
+        for (int i = 0; i < m; i++) {
+            complex_t x = work[i];
+            complex_t c = f.chirpSpectrum[i];
+            work[i] = { x.re * c.re - x.im * c.im, x.re * c.im + x.im * c.re };
+        }
+        radix2(work.data(), m, f.twiddles.data(), m / 2, true);
+
+        float scale = 1.0f / (float)m;
+        for (int i = 0; i < n; i++) {
+            complex_t x = work[i];
+            complex_t c = f.chirp[i];
+            out[i] = { (x.re * c.re - x.im * c.im) * scale, (x.re * c.im + x.im * c.re) * scale };
+        }
+    }
+
+    void Plan::fallback(const void* in, void* out) {
+        const Fallback& f = *entry->fallback;
+        int n = f.size;
+        if (entry->type == FORWARD || entry->type == BACKWARD) {
+            transform(f, (const complex_t*)in, (complex_t*)out);
+            return;
+        }
+
+        // Real transforms go through a complex one, the input is read entirely first since it can be the output
+        thread_local std::vector<complex_t> data;
+        data.resize(n);
+        if (entry->type == REAL_FORWARD) {
+            const float* x = (const float*)in;
+            for (int i = 0; i < n; i++) { data[i] = { x[i], 0.0f }; }
+            transform(f, data.data(), data.data());
+            memcpy(out, data.data(), (n / 2 + 1) * sizeof(complex_t));
+        }
+        else {
+            // Rebuild the upper half of the spectrum from its symmetry
+            const complex_t* x = (const complex_t*)in;
+            for (int i = 0; i <= n / 2; i++) { data[i] = x[i]; }
+            for (int i = n / 2 + 1; i < n; i++) { data[i] = { x[n - i].re, -x[n - i].im }; }
+            transform(f, data.data(), data.data());
+            float* y = (float*)out;
+            for (int i = 0; i < n; i++) { y[i] = data[i].re; }
+        }
+    }
+
+    PlanEntry::~PlanEntry() {
+        std::vector<fftwf_plan> plans = retired;
+        fftwf_plan p = plan.load();
+        if (p) { plans.push_back(p); }
+        if (plans.empty()) { return; }
+
+        std::unique_lock<std::mutex> lck(plannerMtx, std::defer_lock);
+        if (lockPlanner(lck)) {
+            for (auto r : plans) { fftwf_destroy_plan(r); }
+            return;
+        }
+
+        // The upgrade thread destroys them once the measurement is done
+        std::lock_guard<std::mutex> lck2(upgradeMtx);
+        garbage.insert(garbage.end(), plans.begin(), plans.end());
+        upgradeCnd.notify_one();
+    }
+
+    // Entry of the transform, from the cache if a block already uses it
+    static std::shared_ptr<PlanEntry> getEntry(Type type, int size, void* in, void* out) {
+        bool inPlace = (in == out);
+        int inAlign = fftwf_alignment_of((float*)in);
+        int outAlign = fftwf_alignment_of((float*)out);
+        Key key = { type, size, inPlace, inAlign, outAlign };
+
+        std::lock_guard<std::mutex> lck(cacheMtx);
+        auto it = cache.find(key);
+        if (it != cache.end()) {
+            auto e = it->second.lock();
+            if (e) { return e; }
+            cache.erase(it);
+        }
+
+        auto e = std::make_shared<PlanEntry>();
+        e->type = type;
+        e->size = size;
+        e->inPlace = inPlace;
+        e->inAlign = inAlign;
+        e->outAlign = outAlign;
+
+        Rigor target;
+        {
+            std::lock_guard<std::mutex> lck2(upgradeMtx);
+            target = upgrading ? upgradeRigor : RIGOR_ESTIMATE;
+        }
+
+        // Measured plans are only used if they're already in the wisdom, since measuring overwrites the arrays.
+        // If a measurement holds the planner, the built-in transform is used until the upgrade thread plans it.
+        fftwf_plan p = NULL;
+        Rigor rigor = RIGOR_ESTIMATE;
+        std::unique_lock<std::mutex> plnr(plannerMtx, std::defer_lock);
+        if (lockPlanner(plnr)) {
+            if (target > RIGOR_ESTIMATE) { p = makePlan(*e, rigorFlags(target) | FFTW_WISDOM_ONLY, in, out); }
+            if (p) { rigor = target; }
+            else { p = makePlan(*e, FFTW_ESTIMATE, in, out); }
+            plnr.unlock();
+        }
+        else {
+            e->fallback = makeFallback(type, size);
+        }
+        e->rigor.store(rigor);
+        e->plan.store(p, std::memory_order_release);
+
+        cache[key] = e;
+        if (!p) {
+            std::lock_guard<std::mutex> lck2(upgradeMtx);
+            planQueue.push_back(e);
+            upgradeCnd.notify_one();
+        }
+        else if (rigor < target) {
+            std::lock_guard<std::mutex> lck2(upgradeMtx);
+            upgradeQueue.push_back(e);
+            upgradeCnd.notify_one();
+        }
+        return e;
+    }
+
+    void Plan::create(Type type, int size, void* in, void* out) {
+        entry = getEntry(type, size, in, out);
+    }
+
+    void Plan::destroy() {
+        entry.reset();
+    }
+
+    // First FFTW plan of an entry created during a measurement, from the wisdom if possible
+    static void plan(PlanEntry& e, Rigor target) {
+        Scratch s(e);
+        fftwf_plan p = NULL;
+        Rigor rigor = RIGOR_ESTIMATE;
+        {
+            std::lock_guard<std::mutex> lck(plannerMtx);
+            if (target > RIGOR_ESTIMATE) { p = makePlan(e, rigorFlags(target) | FFTW_WISDOM_ONLY, s.in, s.out); }
+            if (p) { rigor = target; }
+            else { p = makePlan(e, FFTW_ESTIMATE, s.in, s.out); }
+        }
+        e.rigor.store(rigor);
+        e.plan.store(p, std::memory_order_release);
+    }
+
+    // Measure a better plan on scratch arrays and swap it in
+    static void upgrade(PlanEntry& e, Rigor rigor) {
+        Scratch s(e);
+        fftwf_plan p;
+        {
+            std::lock_guard<std::mutex> lck(plannerMtx);
+            measuring.store(true);
+            fftwf_set_timelimit(FFT_UPGRADE_TIME_LIMIT);
+            p = makePlan(e, rigorFlags(rigor), s.in, s.out);
+            fftwf_set_timelimit(FFTW_NO_TIMELIMIT);
+            measuring.store(false);
+        }
+        if (!p) { return; }
+
+        // Only this thread and the destructor touch the retired plans
+        fftwf_plan old = e.plan.exchange(p, std::memory_order_acq_rel);
+        if (old) { e.retired.push_back(old); }
+        e.rigor.store(rigor);
+    }
+
+    static void upgradeWorker() {
+        while (true) {
+            std::shared_ptr<PlanEntry> e;
+            bool first = false;
+            Rigor rigor;
+            std::string wisdomPath;
+            std::vector<fftwf_plan> dead;
+            {
+                std::unique_lock<std::mutex> lck(upgradeMtx);
+                upgradeBusy = false;
+                upgradeCnd.wait(lck, []() { return !upgrading || !planQueue.empty() || !upgradeQueue.empty() || !garbage.empty(); });
+                dead.swap(garbage);
+
+                // Plans needed right away come first, and are still made once stopped so that nothing is left on the fallback
+                if (!planQueue.empty()) {
+                    e = planQueue.front().lock();
+                    planQueue.pop_front();
+                    first = true;
+                }
+                else if (upgrading && !upgradeQueue.empty()) {
+                    e = upgradeQueue.front().lock();
+                    upgradeQueue.pop_front();
+                }
+                else if (!upgrading && dead.empty()) {
+                    return;
+                }
+                rigor = upgrading ? upgradeRigor : RIGOR_ESTIMATE;
+                wisdomPath = upgradeWisdomPath;
+                upgradeBusy = e && !first;
+            }
+
+            if (!dead.empty()) {
+                std::lock_guard<std::mutex> lck(plannerMtx);
+                for (auto p : dead) { fftwf_destroy_plan(p); }
+            }
+
+            // Skip the plans no block uses anymore
+            if (!e) { continue; }
+
+            if (first) {
+                plan(*e, rigor);
+                if (e->rigor.load() < rigor) {
+                    std::lock_guard<std::mutex> lck(upgradeMtx);
+                    if (upgrading) { upgradeQueue.push_back(e); }
+                }
+                continue;
+            }
+
+            if (e->rigor.load() >= rigor) { continue; }
+            upgrade(*e, rigor);
+            if (!wisdomPath.empty()) { saveWisdom(wisdomPath); }
+        }
+    }
+
+    void startUpgrades(Rigor rigor, const std::string& wisdomPath) {
+        stopUpgrades();
+        if (rigor == RIGOR_ESTIMATE) { return; }
+
+        // Plans created before, released only once no lock is held since that may destroy them
+        std::vector<std::shared_ptr<PlanEntry>> entries;
+        {
+            std::lock_guard<std::mutex> lck(cacheMtx);
+            for (auto& [key, weak] : cache) {
+                auto e = weak.lock();
+                if (e && e->rigor.load() < rigor) { entries.push_back(e); }
+            }
+        }
+
+        std::lock_guard<std::mutex> lck(upgradeMtx);
+        upgradeRigor = rigor;
+        upgradeWisdomPath = wisdomPath;
+        upgrading = true;
+        upgradeQueue.insert(upgradeQueue.end(), entries.begin(), entries.end());
+        upgradeThread = new std::thread(upgradeWorker);
+    }
+
+    void stopUpgrades() {
+        {
+            std::lock_guard<std::mutex> lck(upgradeMtx);
+            if (!upgradeThread) { return; }
+            upgrading = false;
+            upgradeQueue.clear();
+            upgradeCnd.notify_all();
+        }
+        upgradeThread->join();
+        delete upgradeThread;
+        upgradeThread = NULL;
+    }
+
+    int getPendingUpgrades() {
+        std::lock_guard<std::mutex> lck(upgradeMtx);
+        return planQueue.size() + upgradeQueue.size() + (upgradeBusy ? 1 : 0);
+    }
+
+    bool loadWisdom(const std::string& path) {
+        std::lock_guard<std::mutex> lck(plannerMtx);
+        return fftwf_import_wisdom_from_filename(path.c_str());
+    }
+
+    bool saveWisdom(const std::string& path) {
+        std::lock_guard<std::mutex> lck(plannerMtx);
+        return fftwf_export_wisdom_to_filename(path.c_str());
+    }
+}
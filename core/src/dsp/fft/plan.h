@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fftw3.h>
+#include "../types.h"
+
+// Seconds after which a background measurement settles for the best plan found so far
+#define FFT_UPGRADE_TIME_LIMIT  5.0
+
+namespace dsp::fft {
+    enum Type {
+        FORWARD,        // Complex to complex, e^-j
+        BACKWARD,       // Complex to complex, e^+j
+        REAL_FORWARD,   // Real to the size / 2 + 1 first bins, the input is kept
+        REAL_BACKWARD   // size / 2 + 1 bins to real, the input is overwritten
+    };
+
+    // How hard FFTW looks for a fast plan, the FFTW_ESTIMATE, FFTW_MEASURE and FFTW_PATIENT flags
+    enum Rigor {
+        RIGOR_ESTIMATE,
+        RIGOR_MEASURE,
+        RIGOR_PATIENT
+    };
+
+    // Shared by every Plan of the same transform, the plan is swapped when a better one has been measured
+    struct PlanEntry;
+
+    /**
+     * FFTW plan taken from a cache shared by the whole program, keyed by type, size, whether it's in place and
+     * the alignment of the arrays. Plans are executed with FFTW's new-array interface, so any arrays with the
+     * same alignment as the ones the plan was created with can be used, and several blocks can share a plan.
+     * A new plan comes from the wisdom if there's some for it, otherwise it's estimated and measured again in
+     * the background, see startUpgrades(). Neither creating nor executing a plan waits for a measurement: a plan
+     * created during one runs a slower built-in transform until FFTW is free to plan it.
+     */
+    class Plan {
+    public:
+        Plan() {}
+
+        Plan(Type type, int size, void* in, void* out) { create(type, size, in, out); }
+
+        // Replaces the current plan if there's one
+        void create(Type type, int size, void* in, void* out);
+
+        void destroy();
+
+        inline bool isValid() { return (bool)entry; }
+
+        // FORWARD and BACKWARD
+        inline void execute(complex_t* in, complex_t* out) {
+            fftwf_plan p = get();
+            if (!p) { return fallback(in, out); }
+            fftwf_execute_dft(p, (fftwf_complex*)in, (fftwf_complex*)out);
+        }
+
+        // REAL_FORWARD
+        inline void execute(float* in, complex_t* out) {
+            fftwf_plan p = get();
+            if (!p) { return fallback(in, out); }
+            fftwf_execute_dft_r2c(p, in, (fftwf_complex*)out);
+        }
+
+        // REAL_BACKWARD
+        inline void execute(complex_t* in, float* out) {
+            fftwf_plan p = get();
+            if (!p) { return fallback(in, out); }
+            fftwf_execute_dft_c2r(p, (fftwf_complex*)in, out);
+        }
+
+    private:
+        fftwf_plan get();
+
+        // Built-in transform used while there's no FFTW plan
+        void fallback(const void* in, void* out);
+
+        std::shared_ptr<PlanEntry> entry;
+    };
+
+    // Tables of the built-in transform
+    struct Fallback;
+
+    struct PlanEntry {
+        ~PlanEntry();
+
+        int type;
+        int size;
+        bool inPlace;
+        int inAlign;
+        int outAlign;
+
+        // NULL until FFTW could plan the transform, the fallback is used in the meantime
+        std::atomic<fftwf_plan> plan;
+        std::atomic<Rigor> rigor;
+        std::unique_ptr<Fallback> fallback;
+
+        // Plans replaced by a better one, a block may still be executing them until the entry goes away
+        std::vector<fftwf_plan> retired;
+    };
+
+    inline fftwf_plan Plan::get() { return entry->plan.load(std::memory_order_acquire); }
+
+    /**
+     * Measure the plans of every transform used, now and from then on, at the given rigor in a background thread,
+     * until stopUpgrades(). The blocks keep running with their current plan in the meantime. A measurement holds
+     * the planner, so plans created or destroyed during it are handled by the thread once it's done. The wisdom
+     * is saved to wisdomPath after each one unless it's empty.
+     */
+    void startUpgrades(Rigor rigor, const std::string& wisdomPath);
+
+    // Waits for the measurement in progress, if any, which is cut short after FFT_UPGRADE_TIME_LIMIT seconds
+    void stopUpgrades();
+
+    // Transforms left to measure
+    int getPendingUpgrades();
+
+    // Returns false if the file can't be read or doesn't hold FFTW wisdom
+    bool loadWisdom(const std::string& path);
+
+    bool saveWisdom(const std::string& path);
+}
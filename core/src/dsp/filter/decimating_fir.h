@@ -6,6 +6,9 @@ namespace dsp::filter {
     class DecimatingFIR : public FIR<D, T> {
         using base_type = FIR<D, T>;
     public:
+        // Kernel decimating a whole chunk with the folded taps, advancing offset past the last input it used
+        using Kernel = int (*)(D* out, buffer::History<D>& history, int& offset, int count, const symmetric::Taps<D>& taps);
+
         DecimatingFIR() {}
 
         DecimatingFIR(stream<D>* in, tap<T>& taps, int decimation) { init(in, taps, decimation); }
@@ -18,59 +21,110 @@ namespace dsp::filter {
         void setTaps(tap<T>& taps) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            offset = 0;
+            base_type::postUpdate([this]() {
+                offset = 0;
+                kernel = NULL;
+            });
             base_type::setTaps(taps);
-            base_type::tempStart();
         }
 
         void setDecimation(int decimation) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            _decimation = decimation;
-            offset = 0;
-            base_type::tempStart();
+            base_type::postUpdate([this, decimation]() {
+                _decimation = decimation;
+                offset = 0;
+                kernel = NULL;
+            });
+        }
+
+        /**
+         * Use a kernel compiled for the current taps and decimation, it's dropped when either changes.
+         * It's ignored unless the taps could be folded without skipping any pair.
+         */
+        void setKernel(Kernel kernel) {
+            assert(base_type::_block_init);
+            base_type::postUpdate([this, kernel]() {
+                auto& folded = base_type::folded;
+                bool dense = folded.dot && !folded.first && folded.pairs == folded.size / 2;
+                this->kernel = dense ? kernel : NULL;
+            });
         }
 
         void reset() {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            offset = 0;
+            base_type::postUpdate([this]() { offset = 0; });
             base_type::reset();
-            base_type::tempStart();
         }
 
         inline int process(int count, const D* in, D* out) {
-            // Copy data to work buffer
-            memcpy(base_type::bufStart, in, count * sizeof(D));
+            // Outputs can't overwrite the input before it's used, so the chunk is only read directly when not in place
+            if (in == out) {
+                base_type::history.load(in, count);
+            }
+            else {
+                base_type::history.begin(in, count);
+            }
 
-            // Do convolution
-            int outCount = 0;
-            for (; offset < count; offset += _decimation) {
+            int outCount = outputCount(count);
+            filter(count, 0, outCount, out);
+            end(count, outCount);
+
+            return outCount;
+        }
+
+        /**
+         * Start processing a chunk in parts, e.g. on several threads. Between begin() and end(), filter()
+         * computes any range of the chunk's outputs and can be called concurrently. The outputs are the same
+         * as with process(), but the chunk must stay untouched until end() so it can't be overwritten in place.
+         */
+        inline int begin(int count, const D* in) {
+            base_type::history.begin(in, count);
+            return outputCount(count);
+        }
+
+        // Compute the outputs of the chunk from first to last (excluded), the first being written to out[0]
+        inline void filter(int count, int first, int last, D* out) {
+            int off = offset + first * _decimation;
+            int stop = std::min<int>(count, offset + last * _decimation);
+            int n = 0;
+            if (kernel) {
+                // The specialised kernel processes the whole range, leaving nothing to the generic loop
+                n = kernel(out, base_type::history, off, stop, base_type::folded);
+            }
+            for (; off < stop; off += _decimation) {
+                if (base_type::folded.dot) {
+                    base_type::folded.dot(&out[n++], base_type::history.window(off), base_type::folded);
+                    continue;
+                }
                 if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&out[outCount++], &base_type::buffer[offset], base_type::_taps.taps, base_type::_taps.size);
+                    volk_32f_x2_dot_prod_32f(&out[n++], base_type::history.window(off), base_type::_taps.taps, base_type::_taps.size);
                 }
                 if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&base_type::buffer[offset], base_type::_taps.taps, base_type::_taps.size);
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[n++], (lv_32fc_t*)base_type::history.window(off), base_type::_taps.taps, base_type::_taps.size);
                 }
                 if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
-                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&base_type::buffer[offset], (lv_32fc_t*)base_type::_taps.taps, base_type::_taps.size);
+                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[n++], (lv_32fc_t*)base_type::history.window(off), (lv_32fc_t*)base_type::_taps.taps, base_type::_taps.size);
                 }
             }
-            offset -= count;
+        }
 
-            // Move unused data
-            memmove(base_type::buffer, &base_type::buffer[count], (base_type::_taps.size - 1) * sizeof(D));
+        // Done with the chunk, outCount being the value returned by begin()
+        inline void end(int count, int outCount) {
+            offset += outCount * _decimation - count;
+            base_type::history.end();
+        }
 
-            return outCount;
+        // Number of outputs of the next chunk
+        inline int outputCount(int count) {
+            return (offset < count) ? (count - offset + _decimation - 1) / _decimation : 0;
         }
 
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            base_type::out.reserve(count / _decimation + 1);
             int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
             // Swap if some data was generated
@@ -84,5 +138,6 @@ namespace dsp::filter {
     protected:
         int _decimation;
         int offset = 0;
+        Kernel kernel = NULL;
     };
 }
\ No newline at end of file
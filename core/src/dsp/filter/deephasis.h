@@ -1,5 +1,6 @@
 #pragma once
 #include "../processor.h"
+#include "iir1.h"
 
 
 namespace dsp::filter {
@@ -24,6 +25,7 @@ namespace dsp::filter {
             if constexpr (std::is_same_v<T, stereo_t>) {
                 lastOut = { 0, 0 };
             }
+            lookahead.reset();
 
             base_type::init(in);
         }
@@ -52,10 +54,33 @@ namespace dsp::filter {
             if constexpr (std::is_same_v<T, stereo_t>) {
                 lastOut = { 0, 0 };
             }
+            lookahead.reset();
             base_type::tempStart();
         }
 
+        // Filter in look-ahead form (default), see iir1::Lookahead, or one sample at a time
+        void setParallel(bool parallel) {
+            assert(base_type::_block_init);
+            base_type::postUpdate([this, parallel]() {
+                if (parallel == _parallel) { return; }
+
+                // Carry the last output over to the other form
+                float* last = (float*)&lastOut;
+                if (parallel) {
+                    lookahead.reset(last);
+                }
+                else {
+                    for (int c = 0; c < CHANNELS; c++) { last[c] = lookahead.last(c); }
+                }
+                _parallel = parallel;
+            });
+        }
+
         inline int process(int count, const T* in, T* out) {
+            if (_parallel) {
+                lookahead.lowPass((const float*)in, (float*)out, count);
+                return count;
+            }
             if constexpr (std::is_same_v<T, float>) {
                 out[0] = (alpha * in[0]) + ((1 - alpha) * lastOut);
                 for (int i = 1; i < count; i++) {
@@ -91,12 +116,17 @@ namespace dsp::filter {
         void updateAlpha() {
             float dt = 1.0f / _samplerate;
             alpha = dt / (_tau + dt);
+            lookahead.setCoeffs(alpha, 1.0 - alpha);
         }
 
         double _tau;
         double _samplerate;
 
+        static constexpr int CHANNELS = sizeof(T) / sizeof(float);
+
         float alpha;
         T lastOut;
+        bool _parallel = true;
+        iir1::Lookahead<CHANNELS> lookahead;
     };
 }
\ No newline at end of file
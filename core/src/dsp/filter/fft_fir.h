@@ -0,0 +1,215 @@
+#pragma once
+#include <math.h>
+#include <type_traits>
+#include "../processor.h"
+#include "../fft/plan.h"
+#include "../taps/tap.h"
+
+// The FFT is at least this many times longer than the filter, rounded up to a power of two
+#define FFTFIR_SIZE_FACTOR  4
+#define FFTFIR_MIN_SIZE     256
+
+// Filters shorter than this are always faster to compute directly
+#define FFTFIR_MIN_TAPS     64
+
+// Relative cost of one FFT butterfly compared to one multiply-accumulate of a dot product
+#define FFTFIR_FFT_COST     1.25
+
+namespace dsp::filter {
+    /**
+     * FIR filter using overlap-save fast convolution. Each FFT block holds the filter's history followed by
+     * up to fftSize - tapCount + 1 new samples, so any chunk size can be processed without added latency
+     * and the output is the same as the direct FIR. Real data with real taps uses real FFTs, complex and
+     * stereo data use complex FFTs, a stereo sample being filtered as the complex number (l + j*r).
+     */
+    template <class D, class T>
+    class FFTFIR : public Processor<D, D> {
+        using base_type = Processor<D, D>;
+
+        // Real filters use real transforms, everything else is done in complex
+        static constexpr bool REAL = std::is_same_v<D, float>;
+        using S = std::conditional_t<REAL, float, complex_t>;
+        static_assert(!REAL || std::is_same_v<T, float>, "Real data can only be filtered with real taps");
+
+    public:
+        FFTFIR() {}
+
+        FFTFIR(stream<D>* in, tap<T>& taps) { init(in, taps); }
+
+        ~FFTFIR() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            destroyBuffers();
+        }
+
+        void init(stream<D>* in, tap<T>& taps) {
+            tapCount = 0;
+            configure(taps);
+            base_type::init(in);
+
+            // The output grows to the size of the chunks, see run()
+            base_type::out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
+        }
+
+        void setTaps(tap<T>& taps) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            if (!base_type::updatesDeferred()) {
+                configure(taps);
+                return;
+            }
+
+            // The caller is free to release its taps once this returns, so the worker gets its own copy
+            tap<T> copy = taps::alloc<T>(taps.size);
+            memcpy(copy.taps, taps.taps, taps.size * sizeof(T));
+            base_type::postUpdate([this, copy]() mutable {
+                configure(copy);
+                taps::free(copy);
+            });
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            base_type::postUpdate([this]() { buffer::clear<S>(fftIn, tapCount - 1); });
+        }
+
+        inline int process(int count, const D* in, D* out) {
+            int blockSize = fftSize - tapCount + 1;
+            for (int offset = 0; offset < count;) {
+                int n = std::min<int>(count - offset, blockSize);
+
+                // Append the new samples to the history, whatever follows them has no effect on the valid outputs
+                memcpy(&fftIn[tapCount - 1], &in[offset], n * sizeof(D));
+
+                // Convolve in the frequency domain
+                forwardPlan.execute(fftIn, fftOut);
+                volk_32fc_x2_multiply_32fc((lv_32fc_t*)fftOut, (lv_32fc_t*)fftOut, (lv_32fc_t*)spectrum, binCount);
+                backwardPlan.execute(fftOut, ifftOut);
+
+                // Only outputs computed from the history and new samples alone are valid
+                memcpy(&out[offset], &ifftOut[tapCount - 1], n * sizeof(D));
+
+                // Keep the last samples as history for the next block
+                memmove(fftIn, &fftIn[n], (tapCount - 1) * sizeof(S));
+
+                offset += n;
+            }
+            return count;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            base_type::out.reserve(count);
+            process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            base_type::_in->flush();
+            if (!base_type::out.swap(count)) { return -1; }
+            return count;
+        }
+
+        // History of the filter, the last getTapCount() - 1 input samples. Used to switch from and to a direct FIR.
+        D* history() { return (D*)fftIn; }
+
+        int getTapCount() { return tapCount; }
+
+        // FFT size used for a filter of the given length
+        static int fftSizeFor(int taps) {
+            int size = FFTFIR_MIN_SIZE;
+            while (size < FFTFIR_SIZE_FACTOR * taps) { size <<= 1; }
+            return size;
+        }
+
+        /**
+         * Estimated cost per output sample in multiply-accumulates, for a filter of the given length
+         * processing chunks of the given size. A direct FIR costs one per tap.
+         */
+        static double costPerSample(int taps, int chunk) {
+            int size = fftSizeFor(taps);
+            int samples = std::max<int>(std::min<int>(chunk, size - taps + 1), 1);
+            double transforms = 2.0 * FFTFIR_FFT_COST * (double)size * log2((double)size);
+            return (transforms + 4.0 * (double)size) / (double)samples;
+        }
+
+        // True if fast convolution is expected to be faster than a direct FIR, by the given factor
+        static bool faster(int taps, int chunk, double factor = 1.0) {
+            if (taps < FFTFIR_MIN_TAPS) { return false; }
+            return costPerSample(taps, chunk) * factor < (double)taps;
+        }
+
+    protected:
+        // Switch to new taps, keeping as much of the history as the new length allows
+        void configure(tap<T>& taps) {
+            int histCount = std::max<int>(std::min<int>(tapCount, taps.size) - 1, 0);
+            S* saved = NULL;
+            if (histCount) {
+                saved = buffer::alloc<S>(histCount);
+                memcpy(saved, &fftIn[tapCount - 1 - histCount], histCount * sizeof(S));
+            }
+
+            // Plans are tied to their buffers, so new ones are needed if the size changes
+            int size = fftSizeFor(taps.size);
+            if (size != fftSize) {
+                if (fftSize) { destroyBuffers(); }
+                fftSize = size;
+                createBuffers();
+            }
+
+            // Compute the spectrum of the taps, scaled so that the inverse FFT needs no normalisation.
+            // The taps are reversed since FIR applies them to the samples in chronological order.
+            buffer::clear<S>(fftIn, fftSize);
+            float scale = 1.0f / (float)fftSize;
+            for (int i = 0; i < (int)taps.size; i++) {
+                if constexpr (std::is_same_v<T, float> && !REAL) {
+                    fftIn[i] = { taps.taps[taps.size - 1 - i] * scale, 0.0f };
+                }
+                else {
+                    fftIn[i] = taps.taps[taps.size - 1 - i] * scale;
+                }
+            }
+            forwardPlan.execute(fftIn, fftOut);
+            memcpy(spectrum, fftOut, binCount * sizeof(complex_t));
+            tapCount = taps.size;
+
+            // Restore the most recent history, anything older is zero like after a reset
+            buffer::clear<S>(fftIn, fftSize);
+            if (histCount) {
+                memcpy(&fftIn[tapCount - 1 - histCount], saved, histCount * sizeof(S));
+                buffer::free(saved);
+            }
+        }
+
+        void createBuffers() {
+            binCount = REAL ? (fftSize / 2 + 1) : fftSize;
+            fftIn = (S*)fftwf_malloc(fftSize * sizeof(S));
+            fftOut = (complex_t*)fftwf_malloc(binCount * sizeof(complex_t));
+            ifftOut = (S*)fftwf_malloc(fftSize * sizeof(S));
+            spectrum = (complex_t*)fftwf_malloc(binCount * sizeof(complex_t));
+            buffer::clear<S>(fftIn, fftSize);
+            forwardPlan.create(REAL ? fft::REAL_FORWARD : fft::FORWARD, fftSize, fftIn, fftOut);
+            backwardPlan.create(REAL ? fft::REAL_BACKWARD : fft::BACKWARD, fftSize, fftOut, ifftOut);
+        }
+
+        void destroyBuffers() {
+            forwardPlan.destroy();
+            backwardPlan.destroy();
+            fftwf_free(fftIn);
+            fftwf_free(fftOut);
+            fftwf_free(ifftOut);
+            fftwf_free(spectrum);
+        }
+
+        int tapCount = 0;
+        int fftSize = 0;
+        int binCount = 0;
+
+        S* fftIn = NULL;
+        complex_t* fftOut = NULL;
+        S* ifftOut = NULL;
+        complex_t* spectrum = NULL;
+
+        fft::Plan forwardPlan;
+        fft::Plan backwardPlan;
+    };
+}
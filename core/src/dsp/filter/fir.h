@@ -1,8 +1,16 @@
 #pragma once
 #include "../processor.h"
 #include "../taps/tap.h"
+#include "../buffer/history.h"
+#include "fft_fir.h"
+#include "symmetric.h"
 
 namespace dsp::filter {
+    /**
+     * FIR filter. Long filters are automatically computed by fast convolution when it's expected
+     * to be faster for the size of the chunks being processed, see FFTFIR. Symmetric taps are folded
+     * to halve the number of multiplies when the CPU has a kernel for it, see symmetric.h.
+     */
     template <class D, class T>
     class FIR : public Processor<D, D> {
         using base_type = Processor<D, D>;
@@ -14,71 +22,70 @@ namespace dsp::filter {
         ~FIR() {
             if (!base_type::_block_init) { return; }
             base_type::stop();
-            buffer::free(buffer);
+            if (fft) { delete fft; }
+            symmetric::free(folded);
+            if (ownedTaps) { taps::free(_taps); }
         }
 
         virtual void init(stream<D>* in, tap<T>& taps) {
             _taps = taps;
+            ownedTaps = false;
 
-            // Allocate and clear buffer
-            buffer = buffer::alloc<D>(STREAM_BUFFER_SIZE + 64000);
-            bufStart = &buffer[_taps.size - 1];
-            buffer::clear<D>(buffer, _taps.size - 1);
+            history.init(_taps.size - 1);
+            symmetric::fold(_taps, folded);
 
             base_type::init(in);
+
+            // The output grows to the size of the chunks, see run()
+            base_type::out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
         }
 
         virtual void setTaps(tap<T>& taps) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-
-            int oldTC = _taps.size;
-            _taps = taps;
-
-            // Update start of buffer
-            bufStart = &buffer[_taps.size - 1];
-
-            // Move existing data to make transition seemless
-            if (_taps.size < oldTC) {
-                memmove(buffer, &buffer[oldTC - _taps.size], (_taps.size - 1) * sizeof(D));
-            }
-            else if (_taps.size > oldTC) {
-                memmove(&buffer[_taps.size - oldTC], buffer, (oldTC - 1) * sizeof(D));
-                buffer::clear<D>(buffer, _taps.size - oldTC);
+            if (!base_type::updatesDeferred()) {
+                swapTaps(taps, false);
+                return;
             }
-            
-            base_type::tempStart();
+
+            // The caller is free to release its taps once this returns, so the worker gets its own copy
+            tap<T> copy = taps::alloc<T>(taps.size);
+            memcpy(copy.taps, taps.taps, taps.size * sizeof(T));
+            base_type::postUpdate([this, copy]() mutable { swapTaps(copy, true); });
         }
 
         virtual void reset() {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            buffer::clear<D>(buffer, _taps.size - 1);
-            base_type::tempStart();
+            base_type::postUpdate([this]() {
+                history.clear();
+                fftActive = false;
+            });
         }
 
         inline int process(int count, const D* in, D* out) {
-            // Copy data to work buffer
-            memcpy(bufStart, in, count * sizeof(D));
-            
-            // Do convolution
-            for (int i = 0; i < count; i++) {
+            if (useFFT(count)) { return fft->process(count, in, out); }
+
+            history.begin(in, count, in == out);
+
+            // Do convolution, from the last sample to the first since outputs only depend on
+            // the inputs before them and may overwrite the input when filtering in place
+            for (int i = count - 1; i >= 0; i--) {
+                if (folded.dot) {
+                    folded.dot(&out[i], history.window(i), folded);
+                    continue;
+                }
                 if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&out[i], &buffer[i], _taps.taps, _taps.size);
+                    volk_32f_x2_dot_prod_32f(&out[i], history.window(i), _taps.taps, _taps.size);
                 }
                 if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], _taps.taps, _taps.size);
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)history.window(i), _taps.taps, _taps.size);
                 }
                 if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
-                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], (lv_32fc_t*)_taps.taps, _taps.size);
+                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)history.window(i), (lv_32fc_t*)_taps.taps, _taps.size);
                 }
             }
 
-            // Move unused data
-            memmove(buffer, &buffer[count], (_taps.size - 1) * sizeof(D));
-
+            history.end();
             return count;
         }
 
@@ -86,6 +93,7 @@ namespace dsp::filter {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            base_type::out.reserve(count);
             process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
             base_type::_in->flush();
@@ -94,8 +102,53 @@ namespace dsp::filter {
         }
 
     protected:
+        // Switch to new taps keeping the history, owned taps are freed once replaced
+        void swapTaps(tap<T>& taps, bool owned) {
+            // The history is kept by the direct buffer, fast convolution is picked again on the next chunk
+            if (fftActive) { setFFTActive(false); }
+
+            if (ownedTaps) { taps::free(_taps); }
+            _taps = taps;
+            ownedTaps = owned;
+
+            // Keep the most recent samples to make transition seemless
+            history.resize(_taps.size - 1);
+            symmetric::fold(_taps, folded);
+
+            if (fft) { fft->setTaps(_taps); }
+        }
+
+        // Decide between direct and fast convolution for a chunk
+        inline bool useFFT(int count) {
+            // Switch with a margin so that chunks of varying size don't make the filter go back and forth
+            bool faster = FFTFIR<D, T>::faster(_taps.size, count, fftActive ? 0.5 : 2.0);
+            if (faster != fftActive) { setFFTActive(faster); }
+            return fftActive;
+        }
+
+        // Hand the history over to the other implementation
+        void setFFTActive(bool active) {
+            if (active) {
+                if (!fft) {
+                    fft = new FFTFIR<D, T>();
+                    fft->init(NULL, _taps);
+                    fft->out.free();
+                }
+                memcpy(fft->history(), history.data(), (_taps.size - 1) * sizeof(D));
+            }
+            else {
+                memcpy(history.data(), fft->history(), (_taps.size - 1) * sizeof(D));
+            }
+            fftActive = active;
+        }
+
         tap<T> _taps;
-        D* buffer;
-        D* bufStart;
+        bool ownedTaps = false;
+        buffer::History<D> history;
+        symmetric::Taps<D> folded;
+
+        // Fast convolution, only created once a chunk benefits from it
+        FFTFIR<D, T>* fft = NULL;
+        bool fftActive = false;
     };
 }
\ No newline at end of file
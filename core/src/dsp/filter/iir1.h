@@ -0,0 +1,100 @@
+#pragma once
+#include <string.h>
+#include <algorithm>
+
+// Samples the recursion is unrolled over, each output then only depends on the one this far back
+#define IIR1_LOOKAHEAD  8
+
+// Samples filtered at a time, the intermediate results live on the stack
+#define IIR1_BLOCK      256
+
+namespace dsp::filter::iir1 {
+    /**
+     * First order IIR y[n] = a * x[n] + b * y[n - 1] on C interleaved channels, computed in look-ahead form:
+     * y[n] = a * (1 + b z^-1)(1 + b^2 z^-2)(1 + b^4 z^-4) x[n] + b^8 * y[n - 8]. The FIR part has no feedback
+     * and the recursion links samples eight apart, so both vectorize, unlike the original recursion where
+     * each output waits for the previous one. The results match it to within rounding errors.
+     */
+    template <int C>
+    class Lookahead {
+    public:
+        /**
+         * b is taken in double precision, since with b close to 1 rounding it to a float is a large error on
+         * 1 - b. Its powers are rounded from double precision, and a is adjusted so that the gain at DC stays
+         * a / (1 - b) with the rounded values.
+         */
+        void setCoeffs(double a, double b) {
+            _b = b;
+            _b2 = b * b;
+            _b4 = (double)_b2 * (double)_b2;
+            _b8 = (double)_b4 * (double)_b4;
+            double fir = (1.0 + (double)_b) * (1.0 + (double)_b2) * (1.0 + (double)_b4);
+            _a = (a / (1.0 - b)) * (1.0 - (double)_b8) / fir;
+        }
+
+        // History of a steady output at the value of each channel, zero if NULL. The input is the same if a = 1 - b.
+        void reset(const float* value = NULL) {
+            for (int i = 0; i < (IIR1_LOOKAHEAD - 1) * C; i++) { xHist[i] = value ? value[i % C] : 0.0f; }
+            for (int i = 0; i < IIR1_LOOKAHEAD * C; i++) { yHist[i] = value ? value[i % C] : 0.0f; }
+        }
+
+        // Last output of channel c
+        inline float last(int c) { return yHist[(IIR1_LOOKAHEAD - 1) * C + c]; }
+
+        // out = y, out can be in
+        inline void lowPass(const float* in, float* out, int count) { filter<false>(in, out, count); }
+
+        // out[n] = x[n] - y[n - 1], the output of a DC blocker whose offset is y. out can be in.
+        inline void highPass(const float* in, float* out, int count) { filter<true>(in, out, count); }
+
+    private:
+        template <bool HIGHPASS>
+        void filter(const float* in, float* out, int count) {
+            constexpr int XH = (IIR1_LOOKAHEAD - 1) * C;
+            constexpr int YH = IIR1_LOOKAHEAD * C;
+
+            for (int start = 0; start < count; start += IIR1_BLOCK) {
+                int n = std::min<int>(IIR1_BLOCK, count - start) * C;
+
+                // Input after its history, copied first so that the output can overwrite it
+                float x[XH + IIR1_BLOCK * C];
+                memcpy(x, xHist, sizeof(xHist));
+                memcpy(&x[XH], &in[start * C], n * sizeof(float));
+
+                // FIR part, each stage needs less history than the one before
+                float g[XH + IIR1_BLOCK * C];
+                float h[XH + IIR1_BLOCK * C];
+                for (int i = C; i < XH + n; i++) { g[i] = x[i] + _b * x[i - C]; }
+                for (int i = 3 * C; i < XH + n; i++) { h[i] = g[i] + _b2 * g[i - 2 * C]; }
+
+                // Recursion after the output history
+                float y[YH + IIR1_BLOCK * C];
+                memcpy(y, yHist, sizeof(yHist));
+                const float* hx = &h[XH];
+                float* yx = &y[YH];
+                for (int i = 0; i < n; i++) { yx[i] = _a * (hx[i] + _b4 * hx[i - 4 * C]) + _b8 * yx[i - YH]; }
+
+                float* o = &out[start * C];
+                if constexpr (HIGHPASS) {
+                    const float* xx = &x[XH];
+                    for (int i = 0; i < n; i++) { o[i] = xx[i] - yx[i - C]; }
+                }
+                else {
+                    memcpy(o, yx, n * sizeof(float));
+                }
+
+                // Keep the history for the next block
+                memcpy(xHist, &x[n], sizeof(xHist));
+                memcpy(yHist, &y[n], sizeof(yHist));
+            }
+        }
+
+        float _a = 1.0f;
+        float _b = 0.0f;
+        float _b2 = 0.0f;
+        float _b4 = 0.0f;
+        float _b8 = 0.0f;
+        float xHist[(IIR1_LOOKAHEAD - 1) * C] = {};
+        float yHist[IIR1_LOOKAHEAD * C] = {};
+    };
+}
@@ -0,0 +1,577 @@
+#pragma once
+#include <math.h>
+#include <algorithm>
+#include <type_traits>
+#include "../types.h"
+#include "../taps/tap.h"
+#include "../buffer/history.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define DSP_SYMMETRIC_AVX
+#define DSP_SYMMETRIC_AVX_TARGET __attribute__((target("avx,fma")))
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define DSP_SYMMETRIC_NEON
+#endif
+
+// Largest difference between taps considered equal, relative to the largest tap
+#define SYMMETRIC_TOLERANCE 1e-6f
+
+// Fixed length kernels keep the taps in registers if they fit in this many vectors, leaving room for the data
+#define SYMMETRIC_MAX_TAP_REGS  10
+
+namespace dsp::filter::symmetric {
+    /**
+     * Folded form of linear-phase taps. Symmetric taps h[k] == h[size - 1 - k] only need one multiply per pair
+     * of samples, and half-band taps have every other pair equal to zero, in which case the pairs are strided by two.
+     * The folded taps are only built when a SIMD kernel is available, the volk dot products are faster otherwise.
+     */
+    template <class D>
+    struct Taps {
+        int size = 0;           // Length of the original taps
+        int pairs = 0;          // Number of non-zero pairs, zero if the taps couldn't be folded
+        int first = 0;          // Index of the first sample of the first pair
+        float center = 0.0f;    // Middle tap of odd length taps
+        float* taps = NULL;     // Coefficient of each pair, twice in a row for complex data
+        void (*dot)(D* out, const D* window, const Taps<D>& taps) = NULL;
+    };
+
+    /**
+     * Folded form of symmetric real taps h shifted up in frequency by omega, h[k] * e^(j * omega * (size - 1 - k))
+     * in the order they're applied to the window. The samples a and b of a pair sit at the same distance d on
+     * each side of the middle, so the pair only needs h * (cos(omega * d) * (a + b) + j * sin(omega * d) * (a - b)),
+     * the phase of the middle tap being applied once to the sum. Complex data only.
+     */
+    struct Shifted {
+        int size = 0;                   // Length of the original taps
+        int pairs = 0;                  // Number of pairs, zero if the taps couldn't be folded
+        float center = 0.0f;            // Middle tap of odd length taps
+        complex_t phase = { 1.0f, 0.0f };  // Phase of the middle tap
+        float* cos = NULL;              // h * cos(omega * d) of each pair, twice in a row
+        float* sin = NULL;              // h * sin(omega * d) of each pair, twice in a row
+    };
+
+    // True if the CPU can run the folded kernels
+    inline bool supported() {
+#if defined(DSP_SYMMETRIC_AVX)
+        static const bool avx = __builtin_cpu_supports("avx") && __builtin_cpu_supports("fma");
+        return avx;
+#elif defined(DSP_SYMMETRIC_NEON)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    template <class D>
+    inline void free(Taps<D>& folded) {
+        if (folded.taps) { buffer::free(folded.taps); }
+        folded = Taps<D>();
+    }
+
+    inline void free(Shifted& shifted) {
+        if (shifted.cos) { buffer::free(shifted.cos); }
+        if (shifted.sin) { buffer::free(shifted.sin); }
+        shifted = Shifted();
+    }
+
+#if defined(DSP_SYMMETRIC_AVX)
+    DSP_SYMMETRIC_AVX_TARGET inline float hsum(__m256 v) {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+    }
+
+    // Sum of the even and odd lanes, the real and imaginary parts of complex accumulators
+    DSP_SYMMETRIC_AVX_TARGET inline complex_t csum(__m256 v) {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        return { _mm_cvtss_f32(s), _mm_cvtss_f32(_mm_shuffle_ps(s, s, 1)) };
+    }
+
+    // Four complex samples spaced by the given number of floats
+    DSP_SYMMETRIC_AVX_TARGET inline __m256 gather(const float* p, int step) {
+        __m128 lo = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)p), (const __m64*)&p[step]);
+        __m128 hi = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)&p[2 * step]), (const __m64*)&p[3 * step]);
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+    }
+
+    // Reverse the order of the floats of a vector
+    DSP_SYMMETRIC_AVX_TARGET inline __m256 reverseReal(__m256 v) {
+        return _mm256_permute_ps(_mm256_permute2f128_ps(v, v, 1), _MM_SHUFFLE(0, 1, 2, 3));
+    }
+
+    // Reverse the order of the complex samples of a vector
+    DSP_SYMMETRIC_AVX_TARGET inline __m256 reverseComplex(__m256 v) {
+        return _mm256_permute_ps(_mm256_permute2f128_ps(v, v, 1), _MM_SHUFFLE(1, 0, 3, 2));
+    }
+
+    template <int STRIDE>
+    DSP_SYMMETRIC_AVX_TARGET void dotReal(float* out, const float* w, const Taps<float>& ft) {
+        const float* fw = &w[ft.first];
+        const float* rw = &w[ft.size - 1 - ft.first];
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        int i = 0;
+        for (; i + 16 <= ft.pairs; i += 16) {
+            __m256 a0, a1, r0, r1;
+            if constexpr (STRIDE == 1) {
+                a0 = _mm256_loadu_ps(&fw[i]);
+                a1 = _mm256_loadu_ps(&fw[i + 8]);
+                r0 = reverseReal(_mm256_loadu_ps(&rw[-i - 7]));
+                r1 = reverseReal(_mm256_loadu_ps(&rw[-i - 15]));
+            }
+            else {
+                const float* f = &fw[2 * i];
+                const float* r = &rw[-2 * i];
+                a0 = _mm256_setr_ps(f[0], f[2], f[4], f[6], f[8], f[10], f[12], f[14]);
+                a1 = _mm256_setr_ps(f[16], f[18], f[20], f[22], f[24], f[26], f[28], f[30]);
+                r0 = _mm256_setr_ps(r[0], r[-2], r[-4], r[-6], r[-8], r[-10], r[-12], r[-14]);
+                r1 = _mm256_setr_ps(r[-16], r[-18], r[-20], r[-22], r[-24], r[-26], r[-28], r[-30]);
+            }
+            acc0 = _mm256_fmadd_ps(_mm256_add_ps(a0, r0), _mm256_loadu_ps(&ft.taps[i]), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_add_ps(a1, r1), _mm256_loadu_ps(&ft.taps[i + 8]), acc1);
+        }
+        float sum = hsum(_mm256_add_ps(acc0, acc1));
+        for (; i < ft.pairs; i++) {
+            sum += ft.taps[i] * (fw[STRIDE * i] + rw[-STRIDE * i]);
+        }
+        if (ft.size & 1) { sum += ft.center * w[ft.size / 2]; }
+        *out = sum;
+    }
+
+    template <class D, int STRIDE>
+    DSP_SYMMETRIC_AVX_TARGET void dotComplex(D* out, const D* w, const Taps<D>& ft) {
+        const float* fw = (const float*)&w[ft.first];
+        const float* rw = (const float*)&w[ft.size - 1 - ft.first];
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        int i = 0;
+        for (; i + 8 <= ft.pairs; i += 8) {
+            __m256 a0, a1, r0, r1;
+            if constexpr (STRIDE == 1) {
+                a0 = _mm256_loadu_ps(&fw[2 * i]);
+                a1 = _mm256_loadu_ps(&fw[2 * i + 8]);
+                r0 = reverseComplex(_mm256_loadu_ps(&rw[-2 * i - 6]));
+                r1 = reverseComplex(_mm256_loadu_ps(&rw[-2 * i - 14]));
+            }
+            else {
+                a0 = gather(&fw[4 * i], 4);
+                a1 = gather(&fw[4 * i + 16], 4);
+                r0 = gather(&rw[-4 * i], -4);
+                r1 = gather(&rw[-4 * i - 16], -4);
+            }
+            acc0 = _mm256_fmadd_ps(_mm256_add_ps(a0, r0), _mm256_loadu_ps(&ft.taps[2 * i]), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_add_ps(a1, r1), _mm256_loadu_ps(&ft.taps[2 * i + 8]), acc1);
+        }
+        complex_t sum = csum(_mm256_add_ps(acc0, acc1));
+        for (; i < ft.pairs; i++) {
+            int f = 2 * STRIDE * i;
+            sum.re += ft.taps[2 * i] * (fw[f] + rw[-f]);
+            sum.im += ft.taps[2 * i] * (fw[f + 1] + rw[-f + 1]);
+        }
+        if (ft.size & 1) {
+            const float* c = (const float*)&w[ft.size / 2];
+            sum.re += ft.center * c[0];
+            sum.im += ft.center * c[1];
+        }
+        *(complex_t*)out = sum;
+    }
+
+    /**
+     * Decimate a chunk with taps of a length known at compile time. The loops have constant trip counts and
+     * are fully unrolled, and the taps of short filters are loaded once per chunk to stay in registers.
+     */
+    template <int SIZE, int DECIM>
+    DSP_SYMMETRIC_AVX_TARGET int decimateReal(float* out, buffer::History<float>& history, int& offset, int count, const Taps<float>& ft) {
+        constexpr int PAIRS = SIZE / 2;
+        constexpr int VECS = PAIRS / 8;
+        constexpr bool IN_REGS = VECS <= SYMMETRIC_MAX_TAP_REGS;
+        __m256 taps[IN_REGS && VECS ? VECS : 1];
+        if constexpr (IN_REGS) {
+            for (int v = 0; v < VECS; v++) { taps[v] = _mm256_loadu_ps(&ft.taps[8 * v]); }
+        }
+
+        int n = 0;
+        for (; offset < count; offset += DECIM) {
+            const float* fw = history.window(offset);
+            const float* rw = &fw[SIZE - 1];
+            __m256 acc0 = _mm256_setzero_ps();
+            __m256 acc1 = _mm256_setzero_ps();
+            for (int v = 0; v < VECS; v++) {
+                __m256 x = _mm256_add_ps(_mm256_loadu_ps(&fw[8 * v]), reverseReal(_mm256_loadu_ps(&rw[-8 * v - 7])));
+                __m256 t = IN_REGS ? taps[v] : _mm256_loadu_ps(&ft.taps[8 * v]);
+                if (v & 1) { acc1 = _mm256_fmadd_ps(x, t, acc1); }
+                else { acc0 = _mm256_fmadd_ps(x, t, acc0); }
+            }
+            float sum = hsum(_mm256_add_ps(acc0, acc1));
+            for (int i = 8 * VECS; i < PAIRS; i++) {
+                sum += ft.taps[i] * (fw[i] + rw[-i]);
+            }
+            if constexpr (SIZE & 1) { sum += ft.center * fw[PAIRS]; }
+            out[n++] = sum;
+        }
+        return n;
+    }
+
+    template <class D, int SIZE, int DECIM>
+    DSP_SYMMETRIC_AVX_TARGET int decimateComplex(D* out, buffer::History<D>& history, int& offset, int count, const Taps<D>& ft) {
+        constexpr int PAIRS = SIZE / 2;
+        constexpr int VECS = PAIRS / 4;
+        constexpr bool IN_REGS = VECS <= SYMMETRIC_MAX_TAP_REGS;
+        __m256 taps[IN_REGS && VECS ? VECS : 1];
+        if constexpr (IN_REGS) {
+            for (int v = 0; v < VECS; v++) { taps[v] = _mm256_loadu_ps(&ft.taps[8 * v]); }
+        }
+
+        int n = 0;
+        for (; offset < count; offset += DECIM) {
+            const float* fw = (const float*)history.window(offset);
+            const float* rw = &fw[2 * (SIZE - 1)];
+            __m256 acc0 = _mm256_setzero_ps();
+            __m256 acc1 = _mm256_setzero_ps();
+            for (int v = 0; v < VECS; v++) {
+                __m256 x = _mm256_add_ps(_mm256_loadu_ps(&fw[8 * v]), reverseComplex(_mm256_loadu_ps(&rw[-8 * v - 6])));
+                __m256 t = IN_REGS ? taps[v] : _mm256_loadu_ps(&ft.taps[8 * v]);
+                if (v & 1) { acc1 = _mm256_fmadd_ps(x, t, acc1); }
+                else { acc0 = _mm256_fmadd_ps(x, t, acc0); }
+            }
+            complex_t sum = csum(_mm256_add_ps(acc0, acc1));
+            for (int i = 4 * VECS; i < PAIRS; i++) {
+                sum.re += ft.taps[2 * i] * (fw[2 * i] + rw[-2 * i]);
+                sum.im += ft.taps[2 * i] * (fw[2 * i + 1] + rw[-2 * i + 1]);
+            }
+            if constexpr (SIZE & 1) {
+                sum.re += ft.center * fw[2 * PAIRS];
+                sum.im += ft.center * fw[2 * PAIRS + 1];
+            }
+            *(complex_t*)&out[n++] = sum;
+        }
+        return n;
+    }
+    DSP_SYMMETRIC_AVX_TARGET inline void dotShifted(complex_t* out, const complex_t* w, const Shifted& st) {
+        const float* fw = (const float*)w;
+        const float* rw = (const float*)&w[st.size - 1];
+        __m256 accCos = _mm256_setzero_ps();
+        __m256 accSin = _mm256_setzero_ps();
+        int i = 0;
+        for (; i + 4 <= st.pairs; i += 4) {
+            __m256 a = _mm256_loadu_ps(&fw[2 * i]);
+            __m256 b = reverseComplex(_mm256_loadu_ps(&rw[-2 * i - 6]));
+            accCos = _mm256_fmadd_ps(_mm256_add_ps(a, b), _mm256_loadu_ps(&st.cos[2 * i]), accCos);
+            accSin = _mm256_fmadd_ps(_mm256_sub_ps(a, b), _mm256_loadu_ps(&st.sin[2 * i]), accSin);
+        }
+        complex_t c = csum(accCos);
+        complex_t d = csum(accSin);
+        for (; i < st.pairs; i++) {
+            c.re += st.cos[2 * i] * (fw[2 * i] + rw[-2 * i]);
+            c.im += st.cos[2 * i] * (fw[2 * i + 1] + rw[-2 * i + 1]);
+            d.re += st.sin[2 * i] * (fw[2 * i] - rw[-2 * i]);
+            d.im += st.sin[2 * i] * (fw[2 * i + 1] - rw[-2 * i + 1]);
+        }
+        complex_t sum = { c.re - d.im, c.im + d.re };
+        if (st.size & 1) {
+            sum.re += st.center * w[st.size / 2].re;
+            sum.im += st.center * w[st.size / 2].im;
+        }
+        *out = sum * st.phase;
+    }
+#elif defined(DSP_SYMMETRIC_NEON)
+    template <int STRIDE>
+    void dotReal(float* out, const float* w, const Taps<float>& ft) {
+        const float* fw = &w[ft.first];
+        const float* rw = &w[ft.size - 1 - ft.first];
+        float32x4_t acc0 = vdupq_n_f32(0.0f);
+        float32x4_t acc1 = vdupq_n_f32(0.0f);
+        int i = 0;
+        for (; i + 8 <= ft.pairs; i += 8) {
+            float32x4_t a0, a1, r0, r1;
+            if constexpr (STRIDE == 1) {
+                a0 = vld1q_f32(&fw[i]);
+                a1 = vld1q_f32(&fw[i + 4]);
+                r0 = vrev64q_f32(vld1q_f32(&rw[-i - 3]));
+                r1 = vrev64q_f32(vld1q_f32(&rw[-i - 7]));
+                r0 = vcombine_f32(vget_high_f32(r0), vget_low_f32(r0));
+                r1 = vcombine_f32(vget_high_f32(r1), vget_low_f32(r1));
+            }
+            else {
+                // Every other sample, the reversed side is loaded backwards without reading past the window
+                a0 = vld2q_f32(&fw[2 * i]).val[0];
+                a1 = vld2q_f32(&fw[2 * i + 8]).val[0];
+                r0 = vrev64q_f32(vld2q_f32(&rw[-2 * i - 7]).val[1]);
+                r1 = vrev64q_f32(vld2q_f32(&rw[-2 * i - 15]).val[1]);
+                r0 = vcombine_f32(vget_high_f32(r0), vget_low_f32(r0));
+                r1 = vcombine_f32(vget_high_f32(r1), vget_low_f32(r1));
+            }
+            acc0 = vfmaq_f32(acc0, vaddq_f32(a0, r0), vld1q_f32(&ft.taps[i]));
+            acc1 = vfmaq_f32(acc1, vaddq_f32(a1, r1), vld1q_f32(&ft.taps[i + 4]));
+        }
+        float sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+        for (; i < ft.pairs; i++) {
+            sum += ft.taps[i] * (fw[STRIDE * i] + rw[-STRIDE * i]);
+        }
+        if (ft.size & 1) { sum += ft.center * w[ft.size / 2]; }
+        *out = sum;
+    }
+
+    template <class D, int STRIDE>
+    void dotComplex(D* out, const D* w, const Taps<D>& ft) {
+        const float* fw = (const float*)&w[ft.first];
+        const float* rw = (const float*)&w[ft.size - 1 - ft.first];
+        float32x4_t acc0 = vdupq_n_f32(0.0f);
+        float32x4_t acc1 = vdupq_n_f32(0.0f);
+        int i = 0;
+        for (; i + 4 <= ft.pairs; i += 4) {
+            float32x4_t a0, a1, r0, r1;
+            if constexpr (STRIDE == 1) {
+                a0 = vld1q_f32(&fw[2 * i]);
+                a1 = vld1q_f32(&fw[2 * i + 4]);
+                r0 = vld1q_f32(&rw[-2 * i - 2]);
+                r1 = vld1q_f32(&rw[-2 * i - 6]);
+            }
+            else {
+                // Every other sample, each complex sample seen as one 64bit lane
+                a0 = vreinterpretq_f32_f64(vld2q_f64((const double*)&fw[4 * i]).val[0]);
+                a1 = vreinterpretq_f32_f64(vld2q_f64((const double*)&fw[4 * i + 8]).val[0]);
+                r0 = vreinterpretq_f32_f64(vld2q_f64((const double*)&rw[-4 * i - 6]).val[1]);
+                r1 = vreinterpretq_f32_f64(vld2q_f64((const double*)&rw[-4 * i - 14]).val[1]);
+            }
+            r0 = vcombine_f32(vget_high_f32(r0), vget_low_f32(r0));
+            r1 = vcombine_f32(vget_high_f32(r1), vget_low_f32(r1));
+            acc0 = vfmaq_f32(acc0, vaddq_f32(a0, r0), vld1q_f32(&ft.taps[2 * i]));
+            acc1 = vfmaq_f32(acc1, vaddq_f32(a1, r1), vld1q_f32(&ft.taps[2 * i + 4]));
+        }
+        float32x4_t acc = vaddq_f32(acc0, acc1);
+        float32x2_t s = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+        complex_t sum = { vget_lane_f32(s, 0), vget_lane_f32(s, 1) };
+        for (; i < ft.pairs; i++) {
+            int f = 2 * STRIDE * i;
+            sum.re += ft.taps[2 * i] * (fw[f] + rw[-f]);
+            sum.im += ft.taps[2 * i] * (fw[f + 1] + rw[-f + 1]);
+        }
+        if (ft.size & 1) {
+            const float* c = (const float*)&w[ft.size / 2];
+            sum.re += ft.center * c[0];
+            sum.im += ft.center * c[1];
+        }
+        *(complex_t*)out = sum;
+    }
+
+    /**
+     * Decimate a chunk with taps of a length known at compile time. The loops have constant trip counts and
+     * are fully unrolled, and the taps of short filters are loaded once per chunk to stay in registers.
+     */
+    template <int SIZE, int DECIM>
+    int decimateReal(float* out, buffer::History<float>& history, int& offset, int count, const Taps<float>& ft) {
+        constexpr int PAIRS = SIZE / 2;
+        constexpr int VECS = PAIRS / 4;
+        constexpr bool IN_REGS = VECS <= SYMMETRIC_MAX_TAP_REGS;
+        float32x4_t taps[IN_REGS && VECS ? VECS : 1];
+        if constexpr (IN_REGS) {
+            for (int v = 0; v < VECS; v++) { taps[v] = vld1q_f32(&ft.taps[4 * v]); }
+        }
+
+        int n = 0;
+        for (; offset < count; offset += DECIM) {
+            const float* fw = history.window(offset);
+            const float* rw = &fw[SIZE - 1];
+            float32x4_t acc0 = vdupq_n_f32(0.0f);
+            float32x4_t acc1 = vdupq_n_f32(0.0f);
+            for (int v = 0; v < VECS; v++) {
+                float32x4_t r = vrev64q_f32(vld1q_f32(&rw[-4 * v - 3]));
+                float32x4_t x = vaddq_f32(vld1q_f32(&fw[4 * v]), vcombine_f32(vget_high_f32(r), vget_low_f32(r)));
+                float32x4_t t = IN_REGS ? taps[v] : vld1q_f32(&ft.taps[4 * v]);
+                if (v & 1) { acc1 = vfmaq_f32(acc1, x, t); }
+                else { acc0 = vfmaq_f32(acc0, x, t); }
+            }
+            float sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+            for (int i = 4 * VECS; i < PAIRS; i++) {
+                sum += ft.taps[i] * (fw[i] + rw[-i]);
+            }
+            if constexpr (SIZE & 1) { sum += ft.center * fw[PAIRS]; }
+            out[n++] = sum;
+        }
+        return n;
+    }
+
+    template <class D, int SIZE, int DECIM>
+    int decimateComplex(D* out, buffer::History<D>& history, int& offset, int count, const Taps<D>& ft) {
+        constexpr int PAIRS = SIZE / 2;
+        constexpr int VECS = PAIRS / 2;
+        constexpr bool IN_REGS = VECS <= SYMMETRIC_MAX_TAP_REGS;
+        float32x4_t taps[IN_REGS && VECS ? VECS : 1];
+        if constexpr (IN_REGS) {
+            for (int v = 0; v < VECS; v++) { taps[v] = vld1q_f32(&ft.taps[4 * v]); }
+        }
+
+        int n = 0;
+        for (; offset < count; offset += DECIM) {
+            const float* fw = (const float*)history.window(offset);
+            const float* rw = &fw[2 * (SIZE - 1)];
+            float32x4_t acc0 = vdupq_n_f32(0.0f);
+            float32x4_t acc1 = vdupq_n_f32(0.0f);
+            for (int v = 0; v < VECS; v++) {
+                float32x4_t r = vld1q_f32(&rw[-4 * v - 2]);
+                float32x4_t x = vaddq_f32(vld1q_f32(&fw[4 * v]), vcombine_f32(vget_high_f32(r), vget_low_f32(r)));
+                float32x4_t t = IN_REGS ? taps[v] : vld1q_f32(&ft.taps[4 * v]);
+                if (v & 1) { acc1 = vfmaq_f32(acc1, x, t); }
+                else { acc0 = vfmaq_f32(acc0, x, t); }
+            }
+            float32x4_t acc = vaddq_f32(acc0, acc1);
+            float32x2_t s = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+            complex_t sum = { vget_lane_f32(s, 0), vget_lane_f32(s, 1) };
+            for (int i = 2 * VECS; i < PAIRS; i++) {
+                sum.re += ft.taps[2 * i] * (fw[2 * i] + rw[-2 * i]);
+                sum.im += ft.taps[2 * i] * (fw[2 * i + 1] + rw[-2 * i + 1]);
+            }
+            if constexpr (SIZE & 1) {
+                sum.re += ft.center * fw[2 * PAIRS];
+                sum.im += ft.center * fw[2 * PAIRS + 1];
+            }
+            *(complex_t*)&out[n++] = sum;
+        }
+        return n;
+    }
+
+    inline void dotShifted(complex_t* out, const complex_t* w, const Shifted& st) {
+        const float* fw = (const float*)w;
+        const float* rw = (const float*)&w[st.size - 1];
+        float32x4_t accCos = vdupq_n_f32(0.0f);
+        float32x4_t accSin = vdupq_n_f32(0.0f);
+        int i = 0;
+        for (; i + 2 <= st.pairs; i += 2) {
+            float32x4_t a = vld1q_f32(&fw[2 * i]);
+            float32x4_t b = vld1q_f32(&rw[-2 * i - 2]);
+            b = vcombine_f32(vget_high_f32(b), vget_low_f32(b));
+            accCos = vfmaq_f32(accCos, vaddq_f32(a, b), vld1q_f32(&st.cos[2 * i]));
+            accSin = vfmaq_f32(accSin, vsubq_f32(a, b), vld1q_f32(&st.sin[2 * i]));
+        }
+        float32x2_t cs = vadd_f32(vget_low_f32(accCos), vget_high_f32(accCos));
+        float32x2_t ds = vadd_f32(vget_low_f32(accSin), vget_high_f32(accSin));
+        complex_t c = { vget_lane_f32(cs, 0), vget_lane_f32(cs, 1) };
+        complex_t d = { vget_lane_f32(ds, 0), vget_lane_f32(ds, 1) };
+        for (; i < st.pairs; i++) {
+            c.re += st.cos[2 * i] * (fw[2 * i] + rw[-2 * i]);
+            c.im += st.cos[2 * i] * (fw[2 * i + 1] + rw[-2 * i + 1]);
+            d.re += st.sin[2 * i] * (fw[2 * i] - rw[-2 * i]);
+            d.im += st.sin[2 * i] * (fw[2 * i + 1] - rw[-2 * i + 1]);
+        }
+        complex_t sum = { c.re - d.im, c.im + d.re };
+        if (st.size & 1) {
+            sum.re += st.center * w[st.size / 2].re;
+            sum.im += st.center * w[st.size / 2].im;
+        }
+        *out = sum * st.phase;
+    }
+#endif
+
+#if defined(DSP_SYMMETRIC_AVX) || defined(DSP_SYMMETRIC_NEON)
+    /**
+     * Kernel decimating a chunk with folded taps of a fixed length, see the ISA specific versions.
+     * Returns the number of outputs, offset is advanced past the last input used like in DecimatingFIR.
+     */
+    template <class D, int SIZE, int DECIM>
+    int decimate(D* out, buffer::History<D>& history, int& offset, int count, const Taps<D>& ft) {
+        if constexpr (std::is_same_v<D, float>) {
+            return decimateReal<SIZE, DECIM>(out, history, offset, count, ft);
+        }
+        else {
+            return decimateComplex<D, SIZE, DECIM>(out, history, offset, count, ft);
+        }
+    }
+#endif
+
+    /**
+     * Fold taps if they're symmetric and a kernel is available for the data type. Returns false and
+     * leaves the folded taps empty otherwise, in which case the filter must use a regular dot product.
+     */
+    template <class D, class T>
+    inline bool fold(const tap<T>& taps, Taps<D>& folded) {
+        free(folded);
+        constexpr bool REAL = std::is_same_v<D, float>;
+        constexpr bool COMPLEX = std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>;
+        if constexpr (!std::is_same_v<T, float> || !(REAL || COMPLEX)) {
+            return false;
+        }
+        else {
+#if defined(DSP_SYMMETRIC_AVX) || defined(DSP_SYMMETRIC_NEON)
+            if (!supported() || taps.size < 4) { return false; }
+
+            // Designed taps are only symmetric up to rounding errors, anything far below the largest tap is ignored
+            float peak = 0.0f;
+            for (int i = 0; i < (int)taps.size; i++) { peak = std::max<float>(peak, fabsf(taps.taps[i])); }
+            float tolerance = peak * SYMMETRIC_TOLERANCE;
+            for (int i = 0; i < (int)taps.size / 2; i++) {
+                if (fabsf(taps.taps[i] - taps.taps[taps.size - 1 - i]) > tolerance) { return false; }
+            }
+
+            // Half-band taps are zero at every even distance from the middle, only the pairs in between are kept
+            int half = taps.size / 2;
+            bool halfBand = (taps.size & 1) && half >= 4;
+            for (int d = 2; halfBand && d <= half; d += 2) {
+                if (fabsf(taps.taps[half - d]) > tolerance) { halfBand = false; }
+            }
+            int stride = halfBand ? 2 : 1;
+
+            folded.size = taps.size;
+            folded.first = halfBand ? (half - 1) % 2 : 0;
+            folded.pairs = (half - folded.first + stride - 1) / stride;
+            folded.center = (taps.size & 1) ? taps.taps[half] : 0.0f;
+            int dup = COMPLEX ? 2 : 1;
+            folded.taps = buffer::alloc<float>(folded.pairs * dup);
+            for (int i = 0; i < folded.pairs; i++) {
+                for (int j = 0; j < dup; j++) {
+                    int k = folded.first + stride * i;
+                    folded.taps[dup * i + j] = (taps.taps[k] + taps.taps[taps.size - 1 - k]) * 0.5f;
+                }
+            }
+            if constexpr (REAL) {
+                folded.dot = halfBand ? dotReal<2> : dotReal<1>;
+            }
+            else {
+                folded.dot = halfBand ? dotComplex<D, 2> : dotComplex<D, 1>;
+            }
+            return true;
+#else
+            return false;
+#endif
+        }
+    }
+
+    /**
+     * Fold symmetric taps shifted up in frequency by omega radians per sample. Returns false and leaves the
+     * folded taps empty if the taps aren't symmetric or no kernel is available, the shifted taps must then
+     * be computed in full and applied with a regular dot product.
+     */
+    inline bool shift(const tap<float>& taps, double omega, Shifted& shifted) {
+        free(shifted);
+#if defined(DSP_SYMMETRIC_AVX) || defined(DSP_SYMMETRIC_NEON)
+        if (!supported() || taps.size < 4) { return false; }
+
+        float peak = 0.0f;
+        for (int i = 0; i < (int)taps.size; i++) { peak = std::max<float>(peak, fabsf(taps.taps[i])); }
+        float tolerance = peak * SYMMETRIC_TOLERANCE;
+        for (int i = 0; i < (int)taps.size / 2; i++) {
+            if (fabsf(taps.taps[i] - taps.taps[taps.size - 1 - i]) > tolerance) { return false; }
+        }
+
+        shifted.size = taps.size;
+        shifted.pairs = taps.size / 2;
+        shifted.center = (taps.size & 1) ? taps.taps[taps.size / 2] : 0.0f;
+        double middle = (double)(taps.size - 1) / 2.0;
+        shifted.phase = { (float)cos(omega * middle), (float)sin(omega * middle) };
+        shifted.cos = buffer::alloc<float>(2 * shifted.pairs);
+        shifted.sin = buffer::alloc<float>(2 * shifted.pairs);
+        for (int i = 0; i < shifted.pairs; i++) {
+            double h = ((double)taps.taps[i] + (double)taps.taps[taps.size - 1 - i]) * 0.5;
+            double d = middle - (double)i;
+            shifted.cos[2 * i] = shifted.cos[2 * i + 1] = h * cos(omega * d);
+            shifted.sin[2 * i] = shifted.sin[2 * i + 1] = h * sin(omega * d);
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <functional>
+#include <type_traits>
+#include "processor.h"
+
+namespace dsp {
+    // True if the block exposes a process(count, in, out) function that can be called synchronously
+    template <class B, class T, class = void>
+    struct is_fusable : std::false_type {};
+
+    template <class B, class T>
+    struct is_fusable<B, T, std::void_t<decltype((int)std::declval<B&>().process(0, std::declval<T*>(), std::declval<T*>()))>> : std::true_type {};
+
+    /**
+     * Runs a list of processors back-to-back in a single worker thread. The first stage reads the input
+     * stream and writes to the output buffer, the following stages then work in place on that buffer.
+     * The processors themselves are never started, their control mutex is held while they process
+     * so that their setters can still be safely called from other threads.
+     */
+    template <class T>
+    class FusedExecutor : public Processor<T, T> {
+        using base_type = Processor<T, T>;
+    public:
+        FusedExecutor() {}
+
+        FusedExecutor(stream<T>* in) { base_type::init(in); }
+
+        template <class B>
+        void addStage(B* block) {
+            static_assert(is_fusable<B, T>::value, "Block doesn't have a compatible process function");
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            block->registerProfiling();
+            stages.push_back({ block, [block](int count, T* in, T* out) { return (int)block->process(count, in, out); } });
+            base_type::tempStart();
+        }
+
+        void addStage(block* blk, std::function<int(int, T*, T*)> process) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            blk->registerProfiling();
+            stages.push_back({ blk, process });
+            base_type::tempStart();
+        }
+
+        void clearStages() {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            stages.clear();
+            base_type::tempStart();
+        }
+
+        int stageCount() {
+            return stages.size();
+        }
+
+        inline int process(int count, const T* in, T* out) {
+            if (stages.empty()) {
+                memcpy(out, in, count * sizeof(T));
+                return count;
+            }
+
+            T* data = (T*)in;
+            bool profile = perf::isEnabled();
+            for (auto& stage : stages) {
+                uint64_t start = profile ? perf::now() : 0;
+                int inCount = count;
+
+                stage.blk->acquire();
+                count = stage.process(count, data, out);
+                stage.blk->release();
+                data = out;
+
+                // Account for the stage as if it ran on its own
+                if (profile) {
+                    perf::Counters& c = stage.blk->getCounters();
+                    c.runs.fetch_add(1, std::memory_order_relaxed);
+                    c.samplesIn.fetch_add(inCount, std::memory_order_relaxed);
+                    c.samplesOut.fetch_add(count, std::memory_order_relaxed);
+                    c.processTime.fetch_add(perf::now() - start, std::memory_order_relaxed);
+                    c.addChunk(inCount);
+                }
+
+                // A multirate stage may not have produced anything yet
+                if (!count) { break; }
+            }
+            return count;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            // Swap if some data was generated
+            base_type::_in->flush();
+            if (outCount) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return outCount;
+        }
+
+    protected:
+        struct Stage {
+            block* blk;
+            std::function<int(int, T*, T*)> process;
+        };
+
+        std::vector<Stage> stages;
+    };
+}
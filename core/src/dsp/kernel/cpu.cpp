@@ -0,0 +1,120 @@
+#include "cpu.h"
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#define DSP_KERNEL_X86
+#elif (defined(_M_X64) || defined(_M_IX86)) && defined(_MSC_VER)
+#include <intrin.h>
+#define DSP_KERNEL_X86
+#define DSP_KERNEL_MSVC
+#endif
+
+namespace dsp::kernel {
+#if defined(DSP_KERNEL_X86)
+    static void cpuid(unsigned int leaf, unsigned int regs[4]) {
+#if defined(DSP_KERNEL_MSVC)
+        __cpuidex((int*)regs, leaf, 0);
+#else
+        __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+#endif
+
+#if defined(DSP_KERNEL_MSVC)
+    // Same checks as __builtin_cpu_supports(), the OS must also save the registers of the AVX extensions
+    static bool msvcSupports(ISA isa) {
+        unsigned int regs[4];
+        cpuid(0, regs);
+        unsigned int maxLeaf = regs[0];
+        cpuid(1, regs);
+        unsigned int features = regs[2];
+        if (isa == ISA_SSE2) { return regs[3] & (1 << 26); }
+
+        // OSXSAVE, then the state enabled in XCR0: SSE and AVX, plus the opmask and upper ZMM registers for AVX-512
+        if (maxLeaf < 7 || !(features & (1 << 27))) { return false; }
+        unsigned long long xcr0 = _xgetbv(0);
+        cpuid(7, regs);
+        if (isa == ISA_AVX2) {
+            return (xcr0 & 0x06) == 0x06 && (features & (1 << 28)) && (features & (1 << 12)) && (regs[1] & (1 << 5));
+        }
+        if (isa == ISA_AVX512) {
+            return (xcr0 & 0xE6) == 0xE6 && (regs[1] & (1 << 16));
+        }
+        return false;
+    }
+#endif
+
+    static bool detect(ISA isa) {
+        switch (isa) {
+        case ISA_SCALAR:
+            return true;
+#if defined(DSP_KERNEL_MSVC)
+        case ISA_SSE2:
+        case ISA_AVX2:
+        case ISA_AVX512:
+            return msvcSupports(isa);
+#elif defined(DSP_KERNEL_X86)
+        case ISA_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case ISA_AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case ISA_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#elif defined(__aarch64__)
+        case ISA_NEON:
+            return true;
+#endif
+        default:
+            return false;
+        }
+    }
+
+    bool isSupported(ISA isa) {
+        static const bool supported[_ISA_COUNT] = {
+            detect(ISA_SCALAR),
+            detect(ISA_SSE2),
+            detect(ISA_AVX2),
+            detect(ISA_AVX512),
+            detect(ISA_NEON)
+        };
+        return (isa >= 0 && isa < _ISA_COUNT) ? supported[isa] : false;
+    }
+
+    const char* isaName(ISA isa) {
+        switch (isa) {
+        case ISA_SCALAR:    return "scalar";
+        case ISA_SSE2:      return "sse2";
+        case ISA_AVX2:      return "avx2";
+        case ISA_AVX512:    return "avx512";
+        case ISA_NEON:      return "neon";
+        default:            return "unknown";
+        }
+    }
+
+    std::string cpuName() {
+#if defined(DSP_KERNEL_X86)
+        // Brand string, 48 characters over three leaves
+        unsigned int regs[4];
+        cpuid(0x80000000, regs);
+        if (regs[0] >= 0x80000004) {
+            char brand[49] = {};
+            for (unsigned int i = 0; i < 3; i++) {
+                cpuid(0x80000002 + i, regs);
+                memcpy(&brand[i * 16], regs, sizeof(regs));
+            }
+
+            // Some CPUs pad it with spaces
+            std::string name = brand;
+            size_t first = name.find_first_not_of(' ');
+            size_t last = name.find_last_not_of(' ');
+            if (first != std::string::npos) { return name.substr(first, last - first + 1); }
+        }
+        return "x86";
+#elif defined(__aarch64__)
+        return "aarch64";
+#else
+        return "generic";
+#endif
+    }
+}
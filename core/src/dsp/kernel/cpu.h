@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+
+namespace dsp::kernel {
+    // Instruction sets a kernel variant can require. ISA_AVX2 includes FMA.
+    enum ISA {
+        ISA_SCALAR,
+        ISA_SSE2,
+        ISA_AVX2,
+        ISA_AVX512,
+        ISA_NEON,
+        _ISA_COUNT
+    };
+
+    // True if the CPU running the program supports the instruction set, checked once with CPUID
+    bool isSupported(ISA isa);
+
+    // Short lowercase name, as written in the kernel profile
+    const char* isaName(ISA isa);
+
+    // Model of the CPU, a profile measured on a different one isn't used
+    std::string cpuName();
+}
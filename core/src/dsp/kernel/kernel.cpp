@@ -0,0 +1,133 @@
+#include "kernel.h"
+#include <mutex>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "../perf.h"
+
+// Samples processed per measurement of a variant, spread over as many calls as needed
+#define KERNEL_TUNE_SAMPLES     (1 << 18)
+
+// Measurements of each variant, the fastest one counts
+#define KERNEL_TUNE_RUNS        5
+
+namespace dsp::kernel {
+    static std::mutex registryMtx;
+
+    static std::vector<KernelBase*>& registry() {
+        static std::vector<KernelBase*> kernels;
+        return kernels;
+    }
+
+    KernelBase::KernelBase(const std::string& name) {
+        this->name = name;
+        std::lock_guard<std::mutex> lck(registryMtx);
+        registry().push_back(this);
+    }
+
+    KernelBase::~KernelBase() {
+        std::lock_guard<std::mutex> lck(registryMtx);
+        auto& kernels = registry();
+        kernels.erase(std::remove(kernels.begin(), kernels.end(), this), kernels.end());
+    }
+
+    std::vector<KernelBase*> getKernels() {
+        std::lock_guard<std::mutex> lck(registryMtx);
+        return registry();
+    }
+
+    void tune() {
+        for (auto k : getKernels()) {
+            for (int c = 0; c < KERNEL_SIZE_CLASSES; c++) {
+                int size = CLASS_SIZES[c];
+                int count = std::max<int>(KERNEL_TUNE_SAMPLES / size, 1);
+
+                int best = -1;
+                uint64_t bestTime = 0;
+                for (int v = 0; v < k->getVariantCount(); v++) {
+                    if (!isSupported(k->getVariantISA(v))) { continue; }
+
+                    // Once to warm up the caches, then keep the fastest run
+                    k->run(v, size, 1);
+                    uint64_t time = UINT64_MAX;
+                    for (int i = 0; i < KERNEL_TUNE_RUNS; i++) {
+                        uint64_t start = perf::now();
+                        k->run(v, size, count);
+                        time = std::min<uint64_t>(time, perf::now() - start);
+                    }
+
+                    if (best < 0 || time < bestTime) {
+                        best = v;
+                        bestTime = time;
+                    }
+                }
+                k->select(c, best);
+            }
+        }
+    }
+
+    static KernelBase* findKernel(const std::vector<KernelBase*>& kernels, const std::string& name) {
+        for (auto k : kernels) {
+            if (k->getName() == name) { return k; }
+        }
+        return NULL;
+    }
+
+    bool loadProfile(const std::string& path) {
+        std::ifstream file(path);
+        if (!file.is_open()) { return false; }
+
+        // The CPU comes first
+        std::string line;
+        bool cpuFound = false;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') { continue; }
+            if (line.rfind("cpu ", 0) || line.substr(4) != cpuName()) { return false; }
+            cpuFound = true;
+            break;
+        }
+        if (!cpuFound) { return false; }
+
+        // Then one line per kernel and size class, unknown kernels or variants are skipped
+        auto kernels = getKernels();
+        std::map<KernelBase*, int> classes;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') { continue; }
+            std::istringstream ss(line);
+            std::string name, isa;
+            int size;
+            if (!(ss >> name >> size >> isa)) { continue; }
+
+            KernelBase* k = findKernel(kernels, name);
+            if (!k) { continue; }
+            for (int v = 0; v < k->getVariantCount(); v++) {
+                if (isaName(k->getVariantISA(v)) == isa) {
+                    classes[k] |= 1 << sizeClass(size);
+                    k->select(sizeClass(size), v);
+                    break;
+                }
+            }
+        }
+
+        // A profile missing a kernel, from an older version for instance, has to be measured again
+        for (auto k : kernels) {
+            if (classes[k] != (1 << KERNEL_SIZE_CLASSES) - 1) { return false; }
+        }
+        return true;
+    }
+
+    bool saveProfile(const std::string& path) {
+        std::ofstream file(path);
+        if (!file.is_open()) { return false; }
+
+        file << "# SDR++ DSP kernel profile, delete this file to measure the kernels again" << std::endl;
+        file << "cpu " << cpuName() << std::endl;
+        for (auto k : getKernels()) {
+            for (int c = 0; c < KERNEL_SIZE_CLASSES; c++) {
+                file << k->getName() << " " << CLASS_SIZES[c] << " " << isaName(k->getVariantISA(k->getSelected(c))) << std::endl;
+            }
+        }
+        return file.good();
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "cpu.h"
+
+// Number of size classes a kernel can pick a different variant for
+#define KERNEL_SIZE_CLASSES     3
+
+namespace dsp::kernel {
+    // Call size each class is tuned at. A call uses the class of the first size at or above its own, or the last one.
+    inline constexpr int CLASS_SIZES[KERNEL_SIZE_CLASSES] = { 256, 4096, 65536 };
+
+    inline int sizeClass(int size) {
+        int c = 0;
+        while (c < KERNEL_SIZE_CLASSES - 1 && size > CLASS_SIZES[c]) { c++; }
+        return c;
+    }
+
+    /**
+     * A primitive with one variant per instruction set, registered by name so that the variants can be measured
+     * and the choice saved, see tune() and saveProfile().
+     */
+    class KernelBase {
+    public:
+        KernelBase(const std::string& name);
+        virtual ~KernelBase();
+
+        const std::string& getName() { return name; }
+
+        virtual int getVariantCount() = 0;
+        virtual ISA getVariantISA(int variant) = 0;
+
+        // Variant used for calls of the size class, only supported variants can be selected
+        virtual int getSelected(int sizeClass) = 0;
+        virtual void select(int sizeClass, int variant) = 0;
+
+        // Runs the variant on size samples of made up data count times
+        virtual void run(int variant, int size, int count) = 0;
+
+    private:
+        std::string name;
+    };
+
+    /**
+     * Kernel whose variants are functions of type F. Until a profile is loaded or the kernels are tuned, every
+     * call goes to the last supported variant in the list, so they're listed from the least to the most advanced.
+     * The bench function runs a variant on size samples count times, allocating its own data.
+     */
+    template <class F>
+    class Kernel : public KernelBase {
+    public:
+        struct Variant {
+            ISA isa;
+            F func;
+        };
+
+        using Bench = void (*)(F func, int size, int count);
+
+        Kernel(const std::string& name, std::vector<Variant> variants, Bench bench) : KernelBase(name) {
+            this->variants = variants;
+            this->bench = bench;
+
+            int best = 0;
+            for (int i = 0; i < (int)variants.size(); i++) {
+                if (isSupported(variants[i].isa)) { best = i; }
+            }
+            for (int c = 0; c < KERNEL_SIZE_CLASSES; c++) { select(c, best); }
+        }
+
+        // Function to call for size samples
+        inline F get(int size) { return funcs[sizeClass(size)]; }
+
+        int getVariantCount() { return variants.size(); }
+
+        ISA getVariantISA(int variant) { return variants[variant].isa; }
+
+        int getSelected(int sizeClass) { return selected[sizeClass]; }
+
+        void select(int sizeClass, int variant) {
+            if (variant < 0 || variant >= (int)variants.size() || !isSupported(variants[variant].isa)) { return; }
+            selected[sizeClass] = variant;
+            funcs[sizeClass] = variants[variant].func;
+        }
+
+        void run(int variant, int size, int count) { bench(variants[variant].func, size, count); }
+
+    private:
+        std::vector<Variant> variants;
+        Bench bench;
+        int selected[KERNEL_SIZE_CLASSES];
+        F funcs[KERNEL_SIZE_CLASSES];
+    };
+
+    // Registered kernels, in the order they were created
+    std::vector<KernelBase*> getKernels();
+
+    /**
+     * Measure every supported variant of every kernel at each size class and select the fastest one. Takes a
+     * fraction of a second, the result is meant to be saved with saveProfile() and loaded on the next start.
+     * Like loadProfile(), it should be done before any DSP runs.
+     */
+    void tune();
+
+    /**
+     * Select the variants listed in a profile saved by saveProfile(). Returns false, leaving the selection as is,
+     * if the file can't be read or was written on a different CPU.
+     */
+    bool loadProfile(const std::string& path);
+
+    // Write the current selection, one line per kernel and size class like volk_profile does. Returns false on failure.
+    bool saveProfile(const std::string& path);
+}
@@ -0,0 +1,351 @@
+#include "kernels.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "../demod/quadrature_kernel.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define DSP_KERNEL_X86
+#define DSP_KERNEL_AVX2_TARGET      __attribute__((target("avx2,fma")))
+#define DSP_KERNEL_AVX512_TARGET    __attribute__((target("avx512f")))
+#elif (defined(_M_X64) || defined(_M_IX86)) && defined(_MSC_VER)
+// MSVC compiles the intrinsics of any instruction set without being told to target it
+#include <immintrin.h>
+#define DSP_KERNEL_X86
+#define DSP_KERNEL_AVX2_TARGET
+#define DSP_KERNEL_AVX512_TARGET
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define DSP_KERNEL_NEON
+#endif
+
+// GCC turns a multiply followed by an add into an FMA when the target has it, even written with intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#define DSP_KERNEL_NO_FMA           __attribute__((optimize("fp-contract=off")))
+#else
+#define DSP_KERNEL_NO_FMA
+#endif
+
+namespace dsp::kernel {
+    // Made up input, values between -1 and 1 that don't repeat with a short period
+    static void fill(float* data, int count) {
+        uint32_t state = 1;
+        for (int i = 0; i < count; i++) {
+            state = state * 1664525 + 1013904223;
+            data[i] = (float)(state >> 8) / (float)(1 << 23) - 1.0f;
+        }
+    }
+
+    // ===================== maximum =====================
+
+    static float maximumScalar(const float* in, int count) {
+        float max = -INFINITY;
+        for (int i = 0; i < count; i++) {
+            if (in[i] > max) { max = in[i]; }
+        }
+        return max;
+    }
+
+#if defined(DSP_KERNEL_X86)
+    // max(x, m) keeps m when x is NaN, the same as the scalar comparison
+    static float maximumSSE2(const float* in, int count) {
+        __m128 m0 = _mm_set1_ps(-INFINITY);
+        __m128 m1 = m0;
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            m0 = _mm_max_ps(_mm_loadu_ps(&in[i]), m0);
+            m1 = _mm_max_ps(_mm_loadu_ps(&in[i + 4]), m1);
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, _mm_max_ps(m0, m1));
+        float max = std::max<float>(std::max<float>(lanes[0], lanes[1]), std::max<float>(lanes[2], lanes[3]));
+        for (; i < count; i++) {
+            if (in[i] > max) { max = in[i]; }
+        }
+        return max;
+    }
+
+    DSP_KERNEL_AVX2_TARGET static float maximumAVX2(const float* in, int count) {
+        __m256 m0 = _mm256_set1_ps(-INFINITY);
+        __m256 m1 = m0;
+        int i = 0;
+        for (; i + 16 <= count; i += 16) {
+            m0 = _mm256_max_ps(_mm256_loadu_ps(&in[i]), m0);
+            m1 = _mm256_max_ps(_mm256_loadu_ps(&in[i + 8]), m1);
+        }
+        __m256 m = _mm256_max_ps(m0, m1);
+        __m128 h = _mm_max_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+        float lanes[4];
+        _mm_storeu_ps(lanes, h);
+        float max = std::max<float>(std::max<float>(lanes[0], lanes[1]), std::max<float>(lanes[2], lanes[3]));
+        for (; i < count; i++) {
+            if (in[i] > max) { max = in[i]; }
+        }
+        return max;
+    }
+
+    DSP_KERNEL_AVX512_TARGET static float maximumAVX512(const float* in, int count) {
+        __m512 m0 = _mm512_set1_ps(-INFINITY);
+        __m512 m1 = m0;
+        int i = 0;
+        for (; i + 32 <= count; i += 32) {
+            m0 = _mm512_max_ps(_mm512_loadu_ps(&in[i]), m0);
+            m1 = _mm512_max_ps(_mm512_loadu_ps(&in[i + 16]), m1);
+        }
+        float max = _mm512_reduce_max_ps(_mm512_max_ps(m0, m1));
+        for (; i < count; i++) {
+            if (in[i] > max) { max = in[i]; }
+        }
+        return max;
+    }
+#elif defined(DSP_KERNEL_NEON)
+    // vmaxq_f32 would keep NaNs, so the lanes are selected with a comparison
+    static float maximumNEON(const float* in, int count) {
+        float32x4_t m = vdupq_n_f32(-INFINITY);
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            float32x4_t x = vld1q_f32(&in[i]);
+            m = vbslq_f32(vcgtq_f32(x, m), x, m);
+        }
+        float max = vmaxvq_f32(m);
+        for (; i < count; i++) {
+            if (in[i] > max) { max = in[i]; }
+        }
+        return max;
+    }
+#endif
+
+    static void benchMaximum(MaximumFunc func, int size, int count) {
+        std::vector<float> in(size);
+        fill(in.data(), size);
+        volatile float sink = 0.0f;
+        for (int i = 0; i < count; i++) { sink = func(in.data(), size); }
+        (void)sink;
+    }
+
+    Kernel<MaximumFunc>& maximum() {
+        static Kernel<MaximumFunc> kernel("maximum", {
+            { ISA_SCALAR, maximumScalar },
+#if defined(DSP_KERNEL_X86)
+            { ISA_SSE2, maximumSSE2 },
+            { ISA_AVX2, maximumAVX2 },
+            { ISA_AVX512, maximumAVX512 },
+#elif defined(DSP_KERNEL_NEON)
+            { ISA_NEON, maximumNEON },
+#endif
+        }, benchMaximum);
+        return kernel;
+    }
+
+    // ===================== magnitude =====================
+    // No FMA in any variant, so that they all round like complex_t::amplitude()
+
+    static void magnitudeScalar(const complex_t* in, float* out, int count) {
+        for (int i = 0; i < count; i++) {
+            out[i] = sqrtf((in[i].re * in[i].re) + (in[i].im * in[i].im));
+        }
+    }
+
+#if defined(DSP_KERNEL_X86)
+    static void magnitudeSSE2(const complex_t* in, float* out, int count) {
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 a = _mm_loadu_ps((const float*)&in[i]);
+            __m128 b = _mm_loadu_ps((const float*)&in[i + 2]);
+            __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(&out[i], _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im))));
+        }
+        magnitudeScalar(&in[i], &out[i], count - i);
+    }
+
+    DSP_KERNEL_AVX2_TARGET DSP_KERNEL_NO_FMA static void magnitudeAVX2(const complex_t* in, float* out, int count) {
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            // The shuffles work within 128 bit lanes, giving samples 0, 1, 4, 5, 2, 3, 6, 7 in this order
+            __m256 a = _mm256_loadu_ps((const float*)&in[i]);
+            __m256 b = _mm256_loadu_ps((const float*)&in[i + 4]);
+            __m256 re = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            __m256 im = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            __m256 mag = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im)));
+            mag = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(mag), _MM_SHUFFLE(3, 1, 2, 0)));
+            _mm256_storeu_ps(&out[i], mag);
+        }
+        magnitudeScalar(&in[i], &out[i], count - i);
+    }
+
+    DSP_KERNEL_AVX512_TARGET DSP_KERNEL_NO_FMA static void magnitudeAVX512(const complex_t* in, float* out, int count) {
+        const __m512i reIdx = _mm512_set_epi32(30, 28, 26, 24, 22, 20, 18, 16, 14, 12, 10, 8, 6, 4, 2, 0);
+        const __m512i imIdx = _mm512_set_epi32(31, 29, 27, 25, 23, 21, 19, 17, 15, 13, 11, 9, 7, 5, 3, 1);
+        int i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m512 a = _mm512_loadu_ps((const float*)&in[i]);
+            __m512 b = _mm512_loadu_ps((const float*)&in[i + 8]);
+            __m512 re = _mm512_permutex2var_ps(a, reIdx, b);
+            __m512 im = _mm512_permutex2var_ps(a, imIdx, b);
+            _mm512_storeu_ps(&out[i], _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(re, re), _mm512_mul_ps(im, im))));
+        }
+        magnitudeScalar(&in[i], &out[i], count - i);
+    }
+#elif defined(DSP_KERNEL_NEON)
+    static void magnitudeNEON(const complex_t* in, float* out, int count) {
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            float32x4x2_t v = vld2q_f32((const float*)&in[i]);
+            vst1q_f32(&out[i], vsqrtq_f32(vaddq_f32(vmulq_f32(v.val[0], v.val[0]), vmulq_f32(v.val[1], v.val[1]))));
+        }
+        magnitudeScalar(&in[i], &out[i], count - i);
+    }
+#endif
+
+    static void benchMagnitude(MagnitudeFunc func, int size, int count) {
+        std::vector<complex_t> in(size);
+        std::vector<float> out(size);
+        fill((float*)in.data(), size * 2);
+        for (int i = 0; i < count; i++) { func(in.data(), out.data(), size); }
+    }
+
+    Kernel<MagnitudeFunc>& magnitude() {
+        static Kernel<MagnitudeFunc> kernel("magnitude", {
+            { ISA_SCALAR, magnitudeScalar },
+#if defined(DSP_KERNEL_X86)
+            { ISA_SSE2, magnitudeSSE2 },
+            { ISA_AVX2, magnitudeAVX2 },
+            { ISA_AVX512, magnitudeAVX512 },
+#elif defined(DSP_KERNEL_NEON)
+            { ISA_NEON, magnitudeNEON },
+#endif
+        }, benchMagnitude);
+        return kernel;
+    }
+
+    // ===================== palette =====================
+    // The index is clamped as well, it's out of the palette if min == max
+
+    static inline int paletteIndex(float value, float min, float max, float range, int last) {
+        float pixel = (std::clamp<float>(value, min, max) - min) / range;
+        return std::clamp<int>((int)(pixel * last), 0, last);
+    }
+
+    static void paletteScalar(const float* in, uint32_t* out, int count, float min, float max, const uint32_t* palette, int paletteSize) {
+        float range = max - min;
+        for (int i = 0; i < count; i++) {
+            out[i] = palette[paletteIndex(in[i], min, max, range, paletteSize - 1)];
+        }
+    }
+
+#if defined(DSP_KERNEL_X86)
+    // The indices are computed a vector at a time, SSE2 can't look them up
+    static void paletteSSE2(const float* in, uint32_t* out, int count, float min, float max, const uint32_t* palette, int paletteSize) {
+        const __m128 vmin = _mm_set1_ps(min);
+        const __m128 vmax = _mm_set1_ps(max);
+        const __m128 range = _mm_set1_ps(max - min);
+        const __m128 last = _mm_set1_ps(paletteSize - 1);
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&in[i]), vmin), vmax);
+            __m128 pixel = _mm_div_ps(_mm_sub_ps(v, vmin), range);
+            int32_t ids[4];
+            _mm_storeu_si128((__m128i*)ids, _mm_cvttps_epi32(_mm_mul_ps(pixel, last)));
+            for (int j = 0; j < 4; j++) {
+                out[i + j] = palette[std::clamp<int>(ids[j], 0, paletteSize - 1)];
+            }
+        }
+        paletteScalar(&in[i], &out[i], count - i, min, max, palette, paletteSize);
+    }
+
+    DSP_KERNEL_AVX2_TARGET static void paletteAVX2(const float* in, uint32_t* out, int count, float min, float max, const uint32_t* palette, int paletteSize) {
+        const __m256 vmin = _mm256_set1_ps(min);
+        const __m256 vmax = _mm256_set1_ps(max);
+        const __m256 range = _mm256_set1_ps(max - min);
+        const __m256 last = _mm256_set1_ps(paletteSize - 1);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i lastId = _mm256_set1_epi32(paletteSize - 1);
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(&in[i]), vmin), vmax);
+            __m256 pixel = _mm256_div_ps(_mm256_sub_ps(v, vmin), range);
+            __m256i ids = _mm256_cvttps_epi32(_mm256_mul_ps(pixel, last));
+            ids = _mm256_min_epi32(_mm256_max_epi32(ids, zero), lastId);
+            _mm256_storeu_si256((__m256i*)&out[i], _mm256_i32gather_epi32((const int*)palette, ids, 4));
+        }
+        paletteScalar(&in[i], &out[i], count - i, min, max, palette, paletteSize);
+    }
+
+    DSP_KERNEL_AVX512_TARGET static void paletteAVX512(const float* in, uint32_t* out, int count, float min, float max, const uint32_t* palette, int paletteSize) {
+        const __m512 vmin = _mm512_set1_ps(min);
+        const __m512 vmax = _mm512_set1_ps(max);
+        const __m512 range = _mm512_set1_ps(max - min);
+        const __m512 last = _mm512_set1_ps(paletteSize - 1);
+        const __m512i zero = _mm512_setzero_si512();
+        const __m512i lastId = _mm512_set1_epi32(paletteSize - 1);
+        int i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m512 v = _mm512_min_ps(_mm512_max_ps(_mm512_loadu_ps(&in[i]), vmin), vmax);
+            __m512 pixel = _mm512_div_ps(_mm512_sub_ps(v, vmin), range);
+            __m512i ids = _mm512_cvttps_epi32(_mm512_mul_ps(pixel, last));
+            ids = _mm512_min_epi32(_mm512_max_epi32(ids, zero), lastId);
+            _mm512_storeu_si512(&out[i], _mm512_i32gather_epi32(ids, (const int*)palette, 4));
+        }
+        paletteScalar(&in[i], &out[i], count - i, min, max, palette, paletteSize);
+    }
+#endif
+
+    static void benchPalette(PaletteFunc func, int size, int count) {
+        std::vector<float> in(size);
+        std::vector<uint32_t> out(size);
+        std::vector<uint32_t> palette(10000);
+        fill(in.data(), size);
+        for (int i = 0; i < (int)palette.size(); i++) { palette[i] = i; }
+        for (int i = 0; i < count; i++) { func(in.data(), out.data(), size, -0.8f, 0.8f, palette.data(), palette.size()); }
+    }
+
+    Kernel<PaletteFunc>& palette() {
+        static Kernel<PaletteFunc> kernel("palette", {
+            { ISA_SCALAR, paletteScalar },
+#if defined(DSP_KERNEL_X86)
+            { ISA_SSE2, paletteSSE2 },
+            { ISA_AVX2, paletteAVX2 },
+            { ISA_AVX512, paletteAVX512 },
+#endif
+        }, benchPalette);
+        return kernel;
+    }
+
+    // ===================== quadrature =====================
+
+    static void benchQuadrature(QuadratureFunc func, int size, int count) {
+        std::vector<complex_t> in(size + 1);
+        std::vector<float> out(size);
+        fill((float*)in.data(), (size + 1) * 2);
+        for (int i = 0; i < count; i++) { func(&in[1], out.data(), size, 1.0f); }
+    }
+
+    template <bool FAST>
+    static Kernel<QuadratureFunc>& quadratureKernel() {
+        static Kernel<QuadratureFunc> kernel(FAST ? "quadrature/fast" : "quadrature", {
+            { ISA_SCALAR, demod::quadrature::differencesScalar<FAST> },
+#if defined(DSP_QUADRATURE_SSE)
+            { ISA_SSE2, demod::quadrature::differences<FAST> },
+            { ISA_AVX2, demod::quadrature::differencesAVX<FAST> },
+#elif defined(DSP_QUADRATURE_NEON)
+            { ISA_NEON, demod::quadrature::differences<FAST> },
+#endif
+        }, benchQuadrature);
+        return kernel;
+    }
+
+    Kernel<QuadratureFunc>& quadrature(bool fast) {
+        return fast ? quadratureKernel<true>() : quadratureKernel<false>();
+    }
+
+    void init() {
+        maximum();
+        magnitude();
+        palette();
+        quadrature(false);
+        quadrature(true);
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+#include "kernel.h"
+#include "../types.h"
+
+namespace dsp::kernel {
+    // Creates every kernel below, they register on creation and must all exist before loadProfile() or tune()
+    void init();
+
+    // Largest of count values, NaNs are skipped. -INFINITY if there's none.
+    using MaximumFunc = float (*)(const float* in, int count);
+    Kernel<MaximumFunc>& maximum();
+
+    // out[i] = in[i].amplitude(), rounded the same way by every variant
+    using MagnitudeFunc = void (*)(const complex_t* in, float* out, int count);
+    Kernel<MagnitudeFunc>& magnitude();
+
+    // out[i] = palette[(int)((clamp(in[i], min, max) - min) / (max - min) * (paletteSize - 1))]
+    using PaletteFunc = void (*)(const float* in, uint32_t* out, int count, float min, float max, const uint32_t* palette, int paletteSize);
+    Kernel<PaletteFunc>& palette();
+
+    // Phase differences of demod::quadrature, fast for math::fastAtan2. in[-1] must be readable. Returns the number done.
+    using QuadratureFunc = int (*)(const complex_t* in, float* out, int count, float scale);
+    Kernel<QuadratureFunc>& quadrature(bool fast);
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "../processor.h"
+#include "agc_kernel.h"
 
 namespace dsp::loop {
     template <class T>
@@ -25,49 +26,57 @@ namespace dsp::loop {
 
         void setSetPoint(double setPoint) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            _setPoint = setPoint;
+            base_type::postUpdate([this, setPoint]() { _setPoint = setPoint; });
         }
 
         void setAttack(double attack) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            _attack = attack;
-            _invAttack = 1.0f - _attack;
+            base_type::postUpdate([this, attack]() {
+                _attack = attack;
+                _invAttack = 1.0f - _attack;
+            });
         }
 
         void setDecay(double decay) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            _decay = decay;
-            _invDecay = 1.0f - _decay;
+            base_type::postUpdate([this, decay]() {
+                _decay = decay;
+                _invDecay = 1.0f - _decay;
+            });
         }
 
         void setMaxGain(double maxGain) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            _maxGain = maxGain;
+            base_type::postUpdate([this, maxGain]() { _maxGain = maxGain; });
         }
 
         void setMaxOutputAmp(double maxOutputAmp) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            _maxOutputAmp = maxOutputAmp;
+            base_type::postUpdate([this, maxOutputAmp]() { _maxOutputAmp = maxOutputAmp; });
         }
 
         void setInitialGain(double initGain) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            _initGain = initGain;
+            base_type::postUpdate([this, initGain]() { _initGain = initGain; });
+        }
+
+        /**
+         * Process in passes over blocks of samples, see processParallel(), or one sample at a time. Both give the
+         * same results. Real samples default to the scalar loop, which is already as fast as the average amplitude
+         * update that both have to do one sample at a time.
+         */
+        void setParallel(bool parallel) {
+            assert(base_type::_block_init);
+            base_type::postUpdate([this, parallel]() { _parallel = parallel; });
         }
 
         void reset() {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            amp = _setPoint / _initGain;
+            base_type::postUpdate([this]() { amp = _setPoint / _initGain; });
         }
 
         inline int process(int count, T* in, T* out) {
+            if (_parallel) { return processParallel(count, in, out); }
             for (int i = 0; i < count; i++) {
                 // Get signal amplitude
                 float inAmp, gain;
@@ -109,6 +118,75 @@ namespace dsp::loop {
             return count;
         }
 
+        /**
+         * Same results as the scalar loop, split into passes so that only the average amplitude is computed one
+         * sample at a time. The amplitudes, gains, clipping check and scaling are done a vector at a time. After
+         * a clip the average amplitude jumps to the peak of the rest of the chunk and the passes restart from
+         * the next sample.
+         */
+        int processParallel(int count, const T* in, T* out) {
+            // Parameters in locals, otherwise the compiler reloads them after each store
+            const float setPoint = _setPoint;
+            const float attackRate = _attack;
+            const float invAttack = _invAttack;
+            const float decayRate = _decay;
+            const float invDecay = _invDecay;
+            const float maxGain = _maxGain;
+            const float maxOutputAmp = _maxOutputAmp;
+            float avgAmp = amp;
+
+            for (int start = 0; start < count; start += AGC_BLOCK) {
+                int n = std::min<int>(AGC_BLOCK, count - start);
+                const T* x = &in[start];
+                T* o = &out[start];
+
+                float inAmp[AGC_BLOCK];
+                float attack[AGC_BLOCK];
+                float decay[AGC_BLOCK];
+                float keep[AGC_BLOCK];
+                float avg[AGC_BLOCK];
+                float gain[AGC_BLOCK];
+                agc::amplitudes(x, inAmp, n);
+
+                // Products of the input, taken out of the dependency. A zero input takes the decay branch with the
+                // average kept as is, since amp * 1 + 0 = amp.
+                for (int j = 0; j < n; j++) {
+                    attack[j] = inAmp[j] * attackRate;
+                    decay[j] = inAmp[j] * decayRate;
+                    keep[j] = (inAmp[j] != 0.0f) ? invDecay : 1.0f;
+                }
+
+                int i = 0;
+                while (i < n) {
+                    // Update average amplitude
+                    for (int j = i; j < n; j++) {
+                        float up = (avgAmp * invAttack) + attack[j];
+                        float down = (avgAmp * keep[j]) + decay[j];
+                        avgAmp = (inAmp[j] > avgAmp) ? up : down;
+                        avg[j] = avgAmp;
+                    }
+
+                    // Gain up to the first sample that would clip
+                    int clip = i + agc::gains(&inAmp[i], &avg[i], &gain[i], n - i, setPoint, maxGain, maxOutputAmp);
+
+                    agc::scale(&x[i], &gain[i], &o[i], clip - i);
+                    if (clip == n) { break; }
+
+                    // Look ahead and correct
+                    float maxAmp = 0;
+                    for (int j = clip; j < n; j++) { maxAmp = std::max<float>(maxAmp, inAmp[j]); }
+                    for (int j = start + n; j < count; j++) { maxAmp = std::max<float>(maxAmp, agc::amplitude(in[j])); }
+                    avgAmp = maxAmp;
+                    gain[clip] = std::min<float>(setPoint / avgAmp, maxGain);
+                    agc::scale(&x[clip], &gain[clip], &o[clip], 1);
+                    i = clip + 1;
+                }
+            }
+
+            amp = avgAmp;
+            return count;
+        }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -131,6 +209,7 @@ namespace dsp::loop {
         float _initGain;
 
         float amp = 1.0;
+        bool _parallel = std::is_same_v<T, complex_t>;
 
     };
 }
\ No newline at end of file
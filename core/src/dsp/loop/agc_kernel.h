@@ -0,0 +1,107 @@
+#pragma once
+#include <math.h>
+#include <algorithm>
+#include <type_traits>
+#include "../types.h"
+#include "../kernel/kernels.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2__)
+#include <immintrin.h>
+#define DSP_AGC_SSE
+#elif (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && defined(_MSC_VER)
+#include <immintrin.h>
+#define DSP_AGC_SSE
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define DSP_AGC_NEON
+#endif
+
+// Samples handled per pass, the intermediate results live on the stack
+#define AGC_BLOCK   256
+
+namespace dsp::loop::agc {
+    // Same expression as complex_t::amplitude(), a sqrt rounded to float gives the same result in double or float
+    template <class T>
+    inline float amplitude(const T& in) {
+        if constexpr (std::is_same_v<T, complex_t>) {
+            return sqrtf((in.re * in.re) + (in.im * in.im));
+        }
+        else {
+            return fabsf(in);
+        }
+    }
+
+    // out[i] = amplitude(in[i]), see kernel::magnitude() for complex samples
+    template <class T>
+    inline void amplitudes(const T* in, float* out, int count) {
+        if constexpr (std::is_same_v<T, complex_t>) {
+            kernel::magnitude().get(count)(in, out, count);
+        }
+        else {
+            for (int i = 0; i < count; i++) { out[i] = fabsf(in[i]); }
+        }
+    }
+
+    inline float gain(float inAmp, float avg, float setPoint, float maxGain) {
+        return (inAmp != 0.0f) ? std::min<float>(setPoint / avg, maxGain) : 1.0f;
+    }
+
+    /**
+     * gain[i] = min(setPoint / avg[i], maxGain), or 1 if the input amplitude is zero, stopping at the first sample
+     * whose output would go over maxOutputAmp. Returns its index, or count if there's none. Counting the clips
+     * instead keeps GCC from vectorizing the loop, so it's written with intrinsics.
+     */
+    inline int gains(const float* inAmp, const float* avg, float* gain, int count, float setPoint, float maxGain, float maxOutputAmp) {
+        int i = 0;
+#if defined(DSP_AGC_SSE)
+        const __m128 vsp = _mm_set1_ps(setPoint);
+        const __m128 vmax = _mm_set1_ps(maxGain);
+        const __m128 vout = _mm_set1_ps(maxOutputAmp);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        for (; i + 4 <= count; i += 4) {
+            __m128 a = _mm_loadu_ps(&inAmp[i]);
+            __m128 g = _mm_min_ps(vmax, _mm_div_ps(vsp, _mm_loadu_ps(&avg[i])));
+            __m128 nz = _mm_cmpneq_ps(a, zero);
+            g = _mm_or_ps(_mm_and_ps(nz, g), _mm_andnot_ps(nz, one));
+            _mm_storeu_ps(&gain[i], g);
+            if (_mm_movemask_ps(_mm_cmpgt_ps(_mm_mul_ps(a, g), vout))) { break; }
+        }
+#elif defined(DSP_AGC_NEON)
+        const float32x4_t vsp = vdupq_n_f32(setPoint);
+        const float32x4_t vmax = vdupq_n_f32(maxGain);
+        const float32x4_t vout = vdupq_n_f32(maxOutputAmp);
+        const float32x4_t one = vdupq_n_f32(1.0f);
+        for (; i + 4 <= count; i += 4) {
+            float32x4_t a = vld1q_f32(&inAmp[i]);
+            float32x4_t q = vdivq_f32(vsp, vld1q_f32(&avg[i]));
+            float32x4_t g = vbslq_f32(vcltq_f32(vmax, q), vmax, q);
+            g = vbslq_f32(vceqq_f32(a, vdupq_n_f32(0.0f)), one, g);
+            vst1q_f32(&gain[i], g);
+            if (vmaxvq_u32(vcgtq_f32(vmulq_f32(a, g), vout))) { break; }
+        }
+#endif
+        // The rest, or the vector that clipped one sample at a time
+        for (; i < count; i++) {
+            gain[i] = agc::gain(inAmp[i], avg[i], setPoint, maxGain);
+            if (inAmp[i] * gain[i] > maxOutputAmp) { break; }
+        }
+        return i;
+    }
+
+    // out[i] = in[i] * gain[i], out can be in
+    template <class T>
+    inline void scale(const T* in, const float* __restrict gain, T* out, int count) {
+        if constexpr (std::is_same_v<T, complex_t>) {
+            const float* x = (const float*)in;
+            float* o = (float*)out;
+            for (int i = 0; i < count; i++) {
+                o[2 * i] = x[2 * i] * gain[i];
+                o[2 * i + 1] = x[2 * i + 1] * gain[i];
+            }
+        }
+        else {
+            for (int i = 0; i < count; i++) { out[i] = in[i] * gain[i]; }
+        }
+    }
+}
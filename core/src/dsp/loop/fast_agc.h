@@ -1,5 +1,6 @@
 #pragma once
 #include "../processor.h"
+#include "agc_kernel.h"
 
 namespace dsp::loop {
     template <class T>
@@ -51,6 +52,12 @@ namespace dsp::loop {
             _gain = gain;
         }
 
+        // Process in passes over blocks of samples (default), see processParallel(), or one sample at a time
+        void setParallel(bool parallel) {
+            assert(base_type::_block_init);
+            base_type::postUpdate([this, parallel]() { _parallel = parallel; });
+        }
+
         void reset() {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
@@ -58,6 +65,7 @@ namespace dsp::loop {
         }
 
         inline int process(int count, T* in, T* out) {
+            if (_parallel) { return processParallel(count, in, out); }
             for (int i = 0; i < count; i++) {
                 // Output scaled input
                 out[i] = in[i] * _gain;
@@ -78,6 +86,32 @@ namespace dsp::loop {
             return count;
         }
 
+        /**
+         * The output amplitude is taken as the input amplitude times the gain, so that the amplitudes and the
+         * scaling are computed a vector at a time and only the gain update is left one sample at a time, with
+         * a much shorter dependency than the scalar loop. The results match it to within rounding errors.
+         */
+        int processParallel(int count, const T* in, T* out) {
+            float step = _setPoint * _rate;
+            for (int start = 0; start < count; start += AGC_BLOCK) {
+                int n = std::min<int>(AGC_BLOCK, count - start);
+
+                float inAmp[AGC_BLOCK];
+                float gain[AGC_BLOCK];
+                agc::amplitudes(&in[start], inAmp, n);
+                for (int i = 0; i < n; i++) { inAmp[i] *= _rate; }
+
+                // Update and clamp gain
+                for (int i = 0; i < n; i++) {
+                    gain[i] = _gain;
+                    _gain = std::min<float>(_gain + step - inAmp[i] * fabsf(_gain), _maxGain);
+                }
+
+                agc::scale(&in[start], gain, &out[start], n);
+            }
+            return count;
+        }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -95,6 +129,7 @@ namespace dsp::loop {
         float _rate;
         float _maxGain;
         float _initGain;
+        bool _parallel = true;
 
     };
 }
\ No newline at end of file
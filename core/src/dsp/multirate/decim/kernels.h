@@ -0,0 +1,36 @@
+#pragma once
+#include "plans.h"
+#include "../../filter/symmetric.h"
+
+namespace dsp::multirate::decim {
+    template <class D>
+    using kernel = int (*)(D* out, buffer::History<D>& history, int& offset, int count, const filter::symmetric::Taps<D>& taps);
+
+    /**
+     * Get the kernel compiled for the tap count and decimation of a stage of the plans. Returns NULL if there's
+     * none for this data type or CPU, the stage then runs through the generic filter.
+     */
+    template <class D>
+    inline kernel<D> getKernel(const stage& s) {
+#if defined(DSP_SYMMETRIC_AVX) || defined(DSP_SYMMETRIC_NEON)
+        if constexpr (std::is_same_v<D, float> || std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) {
+            if (!filter::symmetric::supported()) { return NULL; }
+
+#define DECIM_KERNEL(name, decim)  if (s.taps == name##_taps && s.decimation == decim) { return filter::symmetric::decimate<D, name##_len, decim>; }
+            DECIM_KERNEL(fir_2_2, 2)
+            DECIM_KERNEL(fir_4_2, 2)
+            DECIM_KERNEL(fir_8_4, 4)
+            DECIM_KERNEL(fir_16_8, 8)
+            DECIM_KERNEL(fir_32_8, 8)
+            DECIM_KERNEL(fir_64_8, 8)
+            DECIM_KERNEL(fir_128_16, 16)
+            DECIM_KERNEL(fir_256_32, 32)
+            DECIM_KERNEL(fir_512_32, 32)
+
+            // Longer filters are bound by memory rather than by the loop overhead, the runtime kernel is as fast for them
+#undef DECIM_KERNEL
+        }
+#endif
+        return NULL;
+    }
+}
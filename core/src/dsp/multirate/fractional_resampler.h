@@ -0,0 +1,181 @@
+#pragma once
+#include "../processor.h"
+#include "../taps/tap.h"
+#include "../buffer/history.h"
+#include "polyphase_bank.h"
+
+// Number of filter phases per input sample, outputs falling between two phases are interpolated linearly
+#define FRACTIONAL_RESAMPLER_PHASES     128
+
+namespace dsp::multirate {
+    /**
+     * Resampler for any interp / decim ratio, with a filter bank of a fixed size. Instead of one filter phase
+     * per step of 1 / interp input samples like PolyphaseResampler, the bank has FRACTIONAL_RESAMPLER_PHASES
+     * phases and the outputs in between are interpolated from the two closest ones. The position of the
+     * outputs is still tracked as an exact fraction, so the rate doesn't drift however large interp gets.
+     * The taps must be designed for FRACTIONAL_RESAMPLER_PHASES times the input samplerate.
+     */
+    template<class T>
+    class FractionalResampler : public Processor<T, T> {
+        using base_type = Processor<T, T>;
+    public:
+        FractionalResampler() {}
+
+        FractionalResampler(stream<T>* in, int interp, int decim, tap<float> taps) { init(in, interp, decim, taps); }
+
+        ~FractionalResampler() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            freePolyphaseBank(phases);
+        }
+
+        void init(stream<T>* in, int interp, int decim, tap<float> taps) {
+            _interp = interp;
+            _decim = decim;
+            _taps = taps;
+
+            // Build filter bank
+            phases = buildBank(_taps);
+
+            history.init(phases.tapsPerPhase - 1);
+
+            base_type::init(in);
+
+            // The output grows to the size of the chunks, see run()
+            base_type::out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
+        }
+
+        void setRatio(int interp, int decim, tap<float>& taps) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            // The filter bank is a copy of the taps, so it can be built before being handed over
+            PolyphaseBank<float> bank = buildBank(taps);
+            base_type::postUpdate([this, interp, decim, taps, bank]() {
+                // Update settings
+                _interp = interp;
+                _decim = decim;
+                _taps = taps;
+
+                // Switch to the new filter bank
+                freePolyphaseBank(phases);
+                phases = bank;
+
+                // Reset delay line
+                history.resize(phases.tapsPerPhase - 1);
+                clear();
+            });
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            base_type::postUpdate([this]() { clear(); });
+        }
+
+        inline int process(int count, const T* in, T* out) {
+            int outCount = 0;
+
+            // When interpolating in place the output overtakes the input, so the chunk is only read directly when not in place
+            if (in == out) {
+                history.load(in, count);
+            }
+            else {
+                history.begin(in, count);
+            }
+
+            while (offset < count) {
+                // Locate the output between two phases of the bank
+                int64_t pos = (int64_t)phase * FRACTIONAL_RESAMPLER_PHASES;
+                int id = pos / _interp;
+                float frac = (float)(pos % _interp) / (float)_interp;
+
+                // Filter with both and interpolate
+                T a, b;
+                const T* window = history.window(offset);
+                if constexpr (std::is_same_v<T, float>) {
+                    volk_32f_x2_dot_prod_32f(&a, window, phases.phases[id], phases.tapsPerPhase);
+                    volk_32f_x2_dot_prod_32f(&b, window, phases.phases[id + 1], phases.tapsPerPhase);
+                    out[outCount++] = a + (b - a) * frac;
+                }
+                if constexpr (std::is_same_v<T, complex_t> || std::is_same_v<T, stereo_t>) {
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&a, (lv_32fc_t*)window, phases.phases[id], phases.tapsPerPhase);
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&b, (lv_32fc_t*)window, phases.phases[id + 1], phases.tapsPerPhase);
+                    out[outCount++] = a + (b - a) * frac;
+                }
+
+                // Increment phase
+                phase += _decim;
+
+                // Branchless phase advance if phase wrap arround occurs
+                offset += phase / _interp;
+
+                // Wrap around if needed
+                phase = phase % _interp;
+            }
+            offset -= count;
+
+            history.end();
+
+            return outCount;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            base_type::out.reserve(maxOutputCount(count));
+            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            // Swap if some data was generated
+            base_type::_in->flush();
+            if (outCount) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return outCount;
+        }
+
+        // Upper bound of the number of samples process() generates from a chunk
+        inline int maxOutputCount(int count) {
+            return (int)(((int64_t)count * _interp) / _decim) + 1;
+        }
+
+    protected:
+        /**
+         * Split the taps into FRACTIONAL_RESAMPLER_PHASES phases like buildPolyphaseBank(), plus one more
+         * phase a whole input sample after the first so that the last phase can be interpolated too.
+         */
+        static PolyphaseBank<float> buildBank(tap<float>& taps) {
+            PolyphaseBank<float> pb;
+            pb.phaseCount = FRACTIONAL_RESAMPLER_PHASES + 1;
+            pb.tapsPerPhase = (taps.size + FRACTIONAL_RESAMPLER_PHASES) / FRACTIONAL_RESAMPLER_PHASES;
+            pb.phases = buffer::alloc<float*>(pb.phaseCount);
+
+            // Phase p holds the taps p / FRACTIONAL_RESAMPLER_PHASES input samples ahead, the last one spilling
+            // over to the previous input sample
+            for (int p = 0; p < pb.phaseCount; p++) {
+                pb.phases[p] = buffer::alloc<float>(pb.tapsPerPhase);
+                for (int i = 0; i < pb.tapsPerPhase; i++) {
+                    int id = i * FRACTIONAL_RESAMPLER_PHASES + FRACTIONAL_RESAMPLER_PHASES - 1 - p;
+                    pb.phases[p][i] = (id >= 0 && id < (int)taps.size) ? taps.taps[id] : 0.0f;
+                }
+            }
+
+            return pb;
+        }
+
+        void clear() {
+            history.clear();
+            phase = 0;
+            offset = 0;
+        }
+
+        int _interp;
+        int _decim;
+        tap<float> _taps;
+        PolyphaseBank<float> phases;
+        int phase = 0;
+        int offset = 0;
+        buffer::History<T> history;
+
+    };
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include "../processor.h"
 #include "../taps/tap.h"
+#include "../buffer/history.h"
 #include "polyphase_bank.h"
 
 namespace dsp::multirate {
@@ -15,7 +16,6 @@ namespace dsp::multirate {
         ~PolyphaseResampler() {
             if (!base_type::_block_init) { return; }
             base_type::stop();
-            buffer::free(buffer);
             freePolyphaseBank(phases);
         }
 
@@ -27,58 +27,59 @@ namespace dsp::multirate {
             // Build filter bank
             phases = buildPolyphaseBank(_interp, _taps);
 
-            // Allocate delay buffer
-            buffer = buffer::alloc<T>(STREAM_BUFFER_SIZE + 64000);
-            bufStart = &buffer[phases.tapsPerPhase - 1];
-            buffer::clear<T>(buffer, phases.tapsPerPhase - 1);
+            history.init(phases.tapsPerPhase - 1);
 
             base_type::init(in);
+
+            // The output grows to the size of the chunks, see run()
+            base_type::out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
         }
 
         void setRatio(int interp, int decim, tap<float>& taps) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-
-            // Update settings
-            _interp = interp;
-            _decim = decim;
-            _taps = taps;
 
-            // Re-generate polyphase bank
-            freePolyphaseBank(phases);
-            phases = buildPolyphaseBank(_interp, _taps);
-
-            // Reset buffer
-            bufStart = &buffer[phases.tapsPerPhase - 1];
-            reset();
-
-            base_type::tempStart();
+            // The filter bank is a copy of the taps, so it can be built before being handed over
+            PolyphaseBank<float> bank = buildPolyphaseBank(interp, taps);
+            base_type::postUpdate([this, interp, decim, taps, bank]() {
+                // Update settings
+                _interp = interp;
+                _decim = decim;
+                _taps = taps;
+
+                // Switch to the new polyphase bank
+                freePolyphaseBank(phases);
+                phases = bank;
+
+                // Reset delay line
+                history.resize(phases.tapsPerPhase - 1);
+                clear();
+            });
         }
 
         void reset() {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            buffer::clear<T>(buffer, phases.tapsPerPhase - 1);
-            phase = 0;
-            offset = 0;
-            base_type::tempStart();
+            base_type::postUpdate([this]() { clear(); });
         }
 
         inline int process(int count, const T* in, T* out) {
             int outCount = 0;
 
-            // Copy input to buffer
-            memcpy(bufStart, in, count * sizeof(T));
+            // When interpolating in place the output overtakes the input, so the chunk is only read directly when not in place
+            if (in == out) {
+                history.load(in, count);
+            }
+            else {
+                history.begin(in, count);
+            }
 
             while (offset < count) {
                 // Do convolution
                 if constexpr (std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&out[outCount++], &buffer[offset], phases.phases[phase], phases.tapsPerPhase);
+                    volk_32f_x2_dot_prod_32f(&out[outCount++], history.window(offset), phases.phases[phase], phases.tapsPerPhase);
                 }
                 if constexpr (std::is_same_v<T, complex_t> || std::is_same_v<T, stereo_t>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&buffer[offset], phases.phases[phase], phases.tapsPerPhase);
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)history.window(offset), phases.phases[phase], phases.tapsPerPhase);
                 }
 
                 // Increment phase
@@ -92,8 +93,7 @@ namespace dsp::multirate {
             }
             offset -= count;
 
-            // Move delay
-            memmove(buffer, &buffer[count], (phases.tapsPerPhase - 1) * sizeof(T));
+            history.end();
 
             return outCount;
         }
@@ -102,6 +102,7 @@ namespace dsp::multirate {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            base_type::out.reserve(maxOutputCount(count));
             int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
             // Swap if some data was generated
@@ -112,15 +113,25 @@ namespace dsp::multirate {
             return outCount;
         }
 
+        // Upper bound of the number of samples process() generates from a chunk
+        inline int maxOutputCount(int count) {
+            return (int)(((int64_t)count * _interp) / _decim) + 1;
+        }
+
     protected:
+        void clear() {
+            history.clear();
+            phase = 0;
+            offset = 0;
+        }
+
         int _interp;
         int _decim;
         tap<float> _taps;
         PolyphaseBank<float> phases;
         int phase = 0;
         int offset = 0;
-        T* buffer;
-        T* bufStart;
+        buffer::History<T> history;
 
     };
 }
\ No newline at end of file
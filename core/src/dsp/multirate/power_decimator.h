@@ -2,8 +2,22 @@
 #include "../filter/decimating_fir.h"
 #include "../taps/from_array.h"
 #include "decim/plans.h"
+#include "decim/kernels.h"
+#include "../thread_team.h"
+
+// Smallest number of outputs a thread computes for a stage, stages with fewer outputs are split across fewer threads
+#define POWER_DECIMATOR_MIN_PART_SIZE   4096
+
+// Fixed-point samples converted at once before the first stage, few enough for them to stay in the L1 cache
+#define POWER_DECIMATOR_RAW_BLOCK       2048
 
 namespace dsp::multirate {
+    /**
+     * Decimator for power of two ratios, following the multistage plans of decim/plans.h. With more than one
+     * thread, each stage splits the outputs of a chunk between the threads. Every output only depends on the
+     * input window it reads and the stage's history is shared by all of them, so the result is the same as
+     * with a single thread down to the bit.
+     */
     template<class T>
     class PowerDecimator : public Processor<T, T> {
         using base_type = Processor<T, T>;
@@ -16,6 +30,9 @@ namespace dsp::multirate {
             if (!base_type::_block_init) { return; }
             base_type::stop();
             freeFirs();
+            buffer::free(work[0]);
+            buffer::free(work[1]);
+            buffer::free(rawBuf);
         }
 
         void init(stream<T>* in, unsigned int ratio) {
@@ -23,8 +40,13 @@ namespace dsp::multirate {
             _ratio = ratio;
             reconfigure();
             base_type::init(in);
+
+            // The output grows to the size of the chunks, see run()
+            base_type::out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
         }
 
+        unsigned int getRatio() { return _ratio; }
+
         static inline unsigned int getMaxRatio() {
             return 1 << decim::plans_len;
         }
@@ -32,20 +54,33 @@ namespace dsp::multirate {
         void setRatio(unsigned int ratio) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            _ratio = ratio;
-            reconfigure();
-            base_type::tempStart();
+
+            // Build the new stages here and only swap them in from the worker
+            Stages stages = buildStages(ratio);
+            base_type::postUpdate([this, ratio, stages]() {
+                freeFirs();
+                _ratio = ratio;
+                decimFirs = stages.firs;
+                decimTaps = stages.taps;
+                stageCount = stages.firs.size();
+            });
         }
 
+        // Number of threads decimating each chunk, the worker included
+        void setThreadCount(int count) {
+            assert(base_type::_block_init);
+            base_type::postUpdate([this, count]() { team.setThreadCount(count); });
+        }
+
+        int getThreadCount() { return team.getThreadCount(); }
+
         void reset() {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            for (auto& fir : decimFirs) {
-                fir->reset();
-            }
-            base_type::tempStart();
+            base_type::postUpdate([this]() {
+                for (auto& fir : decimFirs) {
+                    fir->reset();
+                }
+            });
         }
 
         inline int process(int count, const T* in, T* out) {
@@ -54,7 +89,11 @@ namespace dsp::multirate {
                 memcpy(out, in, count * sizeof(T));
                 return count;
             }
-            
+
+            if (team.getThreadCount() > 1) {
+                return processParallel(count, in, out);
+            }
+
             // Process data through each stage
             const T* data = in;
             int last = stageCount - 1;
@@ -66,10 +105,49 @@ namespace dsp::multirate {
             return count;
         }
 
+        /**
+         * Decimate fixed-point samples, scale being the value of a full scale sample. They're converted a block
+         * at a time right before the first stage, so that only the integers go through memory at the full rate.
+         * The result is the same as converting the whole chunk first.
+         */
+        template<class I>
+        inline int process(int count, const I* in, float scale, T* out) {
+            static_assert(std::is_same_v<T, complex_t>, "Fixed-point input is only supported for complex samples");
+
+            // Without decimation the conversion is all there is to do
+            if (_ratio == 1) {
+                toFloat(count, in, scale, out);
+                return count;
+            }
+
+            // With several threads, the whole chunk is converted first
+            if (team.getThreadCount() > 1) {
+                toFloat(count, in, scale, out);
+                return process(count, out, out);
+            }
+
+            if (!rawBuf) { rawBuf = buffer::alloc<T>(POWER_DECIMATOR_RAW_BLOCK); }
+            int outCount = 0;
+            auto first = decimFirs[0];
+            for (int i = 0; i < count; i += POWER_DECIMATOR_RAW_BLOCK) {
+                int n = std::min<int>(POWER_DECIMATOR_RAW_BLOCK, count - i);
+                toFloat(n, &in[i], scale, rawBuf);
+                outCount += first->process(n, rawBuf, &out[outCount]);
+            }
+
+            // The other stages work in place like usual
+            for (int i = 1; i < stageCount; i++) {
+                outCount = decimFirs[i]->process(outCount, out, out);
+            }
+            return outCount;
+        }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            // Stages decimate in place in the output, none of them writes more than a chunk
+            base_type::out.reserve(count);
             int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
             // Swap if some data was generated
@@ -81,6 +159,53 @@ namespace dsp::multirate {
         }
 
     protected:
+        template<class I>
+        static inline void toFloat(int count, const I* in, float scale, T* out) {
+            if constexpr (std::is_same_v<I, complex16_t>) {
+                volk_16i_s32f_convert_32f((float*)out, (const int16_t*)in, scale, count * 2);
+            }
+            if constexpr (std::is_same_v<I, complex8_t>) {
+                volk_8i_s32f_convert_32f((float*)out, (const int8_t*)in, scale, count * 2);
+            }
+        }
+
+        inline int processParallel(int count, const T* in, T* out) {
+            // The stages can't work in place since their input must stay intact until all threads are done
+            // with it, so they alternate between two work buffers and the last one writes to the output
+            int needed = count / 2 + 1;
+            if (needed > workCapacity) {
+                buffer::free(work[0]);
+                buffer::free(work[1]);
+                work[0] = buffer::alloc<T>(needed);
+                work[1] = buffer::alloc<T>(needed);
+                workCapacity = needed;
+            }
+
+            const T* data = in;
+            int last = stageCount - 1;
+            for (int i = 0; i < stageCount; i++) {
+                auto fir = decimFirs[i];
+                T* dst = (i == last && data != out) ? out : ((data == work[0]) ? work[1] : work[0]);
+
+                // Give each thread a contiguous range of outputs
+                int outCount = fir->begin(count, data);
+                int parts = std::clamp<int>(outCount / POWER_DECIMATOR_MIN_PART_SIZE, 1, team.getThreadCount());
+                team.run(parts, [fir, count, outCount, parts, dst](int part) {
+                    int first = (int)(((int64_t)outCount * part) / parts);
+                    int end = (int)(((int64_t)outCount * (part + 1)) / parts);
+                    fir->filter(count, first, end, &dst[first]);
+                });
+                fir->end(count, outCount);
+
+                count = outCount;
+                data = dst;
+            }
+
+            // Only happens with a single stage working in place
+            if (data != out) { memcpy(out, data, count * sizeof(T)); }
+            return count;
+        }
+
         void freeFirs() {
             for (auto& fir : decimFirs) { delete fir; }
             for (auto& taps : decimTaps) { taps::free(taps); }
@@ -88,23 +213,38 @@ namespace dsp::multirate {
             decimTaps.clear();
         }
 
-        void reconfigure() {
-            // Delete DDC FIRs and taps
-            freeFirs();
+        struct Stages {
+            std::vector<filter::DecimatingFIR<T, float>*> firs;
+            std::vector<tap<float>> taps;
+        };
 
+        static Stages buildStages(unsigned int ratio) {
             // Generate filters based on DDC plan
-            if (_ratio > 1) {
-                int planId = log2(_ratio) - 1;
+            Stages stages;
+            if (ratio > 1) {
+                int planId = log2(ratio) - 1;
                 decim::plan plan = decim::plans[planId];
-                stageCount = plan.stageCount;
-                for (int i = 0; i < stageCount; i++) {
+                for (int i = 0; i < (int)plan.stageCount; i++) {
                     tap<float> taps = taps::fromArray<float>(plan.stages[i].tapcount, plan.stages[i].taps);
                     auto fir = new filter::DecimatingFIR<T, float>(NULL, taps, plan.stages[i].decimation);
+                    fir->setKernel(decim::getKernel<T>(plan.stages[i]));
                     fir->out.free();
-                    decimTaps.push_back(taps);
-                    decimFirs.push_back(fir);
+                    stages.taps.push_back(taps);
+                    stages.firs.push_back(fir);
                 }
             }
+            return stages;
+        }
+
+        void reconfigure() {
+            // Delete DDC FIRs and taps
+            freeFirs();
+
+            // Generate filters based on DDC plan
+            Stages stages = buildStages(_ratio);
+            decimFirs = stages.firs;
+            decimTaps = stages.taps;
+            stageCount = stages.firs.size();
         }
 
         bool checkRatio(unsigned int ratio) {
@@ -116,5 +256,10 @@ namespace dsp::multirate {
         std::vector<tap<float>> decimTaps;
         unsigned int _ratio;
         int stageCount;
+
+        ThreadTeam team;
+        T* work[2] = { NULL, NULL };
+        int workCapacity = 0;
+        T* rawBuf = NULL;
     };
 }
\ No newline at end of file
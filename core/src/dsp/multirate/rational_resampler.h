@@ -5,10 +5,14 @@
 #include "../filter/decimating_fir.h"
 #include "../taps/from_array.h"
 #include "polyphase_resampler.h"
+#include "fractional_resampler.h"
 #include "power_decimator.h"
 #include "../taps/low_pass.h"
 #include "../window/nuttall.h"
 
+// Largest polyphase filter used for an exact ratio, above it the fractional resampler takes over
+#define RATIONAL_RESAMPLER_MAX_TAPS     16384
+
 namespace dsp::multirate {
     template<class T>
     class RationalResampler : public Processor<T, T> {
@@ -32,62 +36,61 @@ namespace dsp::multirate {
             rtaps = taps::lowPass(0.25, 0.1, 1.0);
             decim.init(NULL, 2);
             resamp.init(NULL, 1, 1, rtaps);
+            frac.init(NULL, 1, 1, rtaps);
 
             decim.out.free();
             resamp.out.free();
+            frac.out.free();
 
             // Proper configuration
             reconfigure();
 
             base_type::init(in);
+
+            // The output grows to the size of the chunks, see run()
+            base_type::out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
         }
 
         void reset() {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            decim.reset();
-            resamp.reset();
-            base_type::tempStart();
+            base_type::postUpdate([this]() {
+                decim.reset();
+                resamp.reset();
+                frac.reset();
+            });
         }
 
         void setInSamplerate(double inSamplerate) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
             _inSamplerate = inSamplerate;
-            reconfigure();
-            base_type::tempStart();
+            postConfig(plan(_inSamplerate, _outSamplerate));
         }
 
         void setOutSamplerate(double outSamplerate) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
             _outSamplerate = outSamplerate;
-            reconfigure();
-            base_type::tempStart();
+            postConfig(plan(_inSamplerate, _outSamplerate));
         }
 
         void setRates(double inSamplerate, double outSamplerate) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
             _inSamplerate = inSamplerate;
             _outSamplerate = outSamplerate;
-            reconfigure();
-            base_type::tempStart();
+            postConfig(plan(_inSamplerate, _outSamplerate));
         }
 
         inline int process(int count, const T* in, T* out) {
             switch(mode) {
                 case Mode::BOTH:
                     count = decim.process(count, in, out);
-                    return resamp.process(count, out, out);
+                    return resample(count, out, out);
                 case Mode::DECIM_ONLY:
                     return decim.process(count, in, out);
                 case Mode::RESAMP_ONLY:
-                    return resamp.process(count, in, out);
+                    return resample(count, in, out);
                 case Mode::NONE:
                     memcpy(out, in, count * sizeof(T));
                     return count;
@@ -95,10 +98,23 @@ namespace dsp::multirate {
             return count;
         }
 
+        // Upper bound of the number of samples process() writes to out, intermediate results included
+        inline int maxOutputCount(int count) {
+            switch(mode) {
+                case Mode::BOTH:
+                    return std::max<int>(count, resamplerOutputCount(count / decim.getRatio() + 1));
+                case Mode::RESAMP_ONLY:
+                    return resamplerOutputCount(count);
+                default:
+                    return count;
+            }
+        }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            base_type::out.reserve(maxOutputCount(count));
             int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
             // Swap if some data was generated
@@ -109,7 +125,6 @@ namespace dsp::multirate {
             return outCount;
         }
 
-    protected:
         enum Mode {
             BOTH,
             DECIM_ONLY,
@@ -117,55 +132,117 @@ namespace dsp::multirate {
             NONE
         };
 
-        void reconfigure() {
+        // Resampling plan, computed ahead of time so that only cheap changes are left to the worker
+        struct Config {
+            Mode mode;
+            int predecRatio;
+            int interp;
+            int decim;
+            bool fractional;
+            tap<float> taps;
+        };
+
+        // Compute the plan for a pair of samplerates without touching the resampler
+        static Config plan(double inSamplerate, double outSamplerate) {
+            Config cfg;
+            cfg.taps.taps = NULL;
+            cfg.taps.size = 0;
+            cfg.fractional = false;
+
             // Calculate highest power-of-two decimation for the power decimator 
-            int predecPower = std::min<int>(floor(log2(_inSamplerate / _outSamplerate)), PowerDecimator<T>::getMaxRatio());
-            int predecRatio = std::min<int>(1 << predecPower, PowerDecimator<T>::getMaxRatio());
-            double intSamplerate = _inSamplerate;
+            int predecPower = std::min<int>(floor(log2(inSamplerate / outSamplerate)), PowerDecimator<T>::getMaxRatio());
+            cfg.predecRatio = std::min<int>(1 << predecPower, PowerDecimator<T>::getMaxRatio());
+            double intSamplerate = inSamplerate;
 
             // Configure the DDC
-            bool useDecim = (_inSamplerate > _outSamplerate && predecPower > 0);
+            bool useDecim = (inSamplerate > outSamplerate && predecPower > 0);
             if (useDecim) {
-                intSamplerate = _inSamplerate / (double)predecRatio;
-                decim.setRatio(predecRatio);
+                intSamplerate = inSamplerate / (double)cfg.predecRatio;
+            }
+            else {
+                cfg.predecRatio = 1;
             }
 
             // Calculate interpolation and decimation for polyphase resampler
             int IntSR = round(intSamplerate);
-            int OutSR = round(_outSamplerate);
+            int OutSR = round(outSamplerate);
             int gcd = std::gcd(IntSR, OutSR);
-            int interp = OutSR / gcd;
-            int decim = IntSR / gcd;
+            cfg.interp = OutSR / gcd;
+            cfg.decim = IntSR / gcd;
 
             // Check for excessive error
-            double actualOutSR = (double)IntSR * (double)interp / (double)decim;
-            double error = abs((actualOutSR - _outSamplerate) / _outSamplerate) * 100.0;
+            double actualOutSR = (double)IntSR * (double)cfg.interp / (double)cfg.decim;
+            double error = abs((actualOutSR - outSamplerate) / outSamplerate) * 100.0;
             if (error > 0.01) {
                 fprintf(stderr, "Warning: resampling error is over 0.01%%: %lf\n", error);
             }
             
             // If the power decimator already did all the work, don't use the resampler
-            if (interp == decim) {
-                mode = useDecim ? Mode::DECIM_ONLY : Mode::NONE;
-                return;
+            if (cfg.interp == cfg.decim) {
+                cfg.mode = useDecim ? Mode::DECIM_ONLY : Mode::NONE;
+                return cfg;
             }
 
-            // Configure the polyphase resampler
-            double tapSamplerate = intSamplerate * (double)interp;
-            double tapBandwidth = std::min<double>(_inSamplerate, _outSamplerate) / 2.0;
+            // Design the polyphase resampler taps. The filter grows with the interpolation, so awkward ratios
+            // get a fractional resampler instead, with a filter bank of a fixed number of phases.
+            double tapBandwidth = std::min<double>(inSamplerate, outSamplerate) / 2.0;
             double tapTransWidth = tapBandwidth * 0.1;
-            taps::free(rtaps);
-            rtaps = taps::lowPass(tapBandwidth, tapTransWidth, tapSamplerate);
-            for (int i = 0; i < rtaps.size; i++) { rtaps.taps[i] *= (float)interp; }
-            resamp.setRatio(interp, decim, rtaps);
+            cfg.fractional = (taps::estimateTapCount(tapTransWidth, intSamplerate * (double)cfg.interp) > RATIONAL_RESAMPLER_MAX_TAPS);
+            int phases = cfg.fractional ? FRACTIONAL_RESAMPLER_PHASES : cfg.interp;
+            cfg.taps = taps::lowPass(tapBandwidth, tapTransWidth, intSamplerate * (double)phases);
+            for (int i = 0; i < (int)cfg.taps.size; i++) { cfg.taps.taps[i] *= (float)phases; }
 
-            printf("[Resamp] predec: %d, interp: %d, decim: %d, inacc: %lf%%, taps: %d\n", predecRatio, interp, decim, error, rtaps.size);
+            printf("[Resamp] predec: %d, interp: %d, decim: %d, inacc: %lf%%, taps: %d%s\n", cfg.predecRatio, cfg.interp, cfg.decim, error, cfg.taps.size, cfg.fractional ? " (fractional)" : "");
+
+            cfg.mode = useDecim ? Mode::BOTH : Mode::RESAMP_ONLY;
+            return cfg;
+        }
+
+        /**
+         * Switch to a plan, taking over its taps. Must only be called by the worker or while it isn't running,
+         * e.g. from an update posted by a block using the resampler through process(). The samplerates
+         * given to the setters aren't changed, such a block is expected to keep track of them itself.
+         */
+        void apply(Config& cfg) {
+            if (cfg.predecRatio > 1) {
+                decim.setRatio(cfg.predecRatio);
+            }
+            if (cfg.taps.taps) {
+                if (cfg.fractional) {
+                    frac.setRatio(cfg.interp, cfg.decim, cfg.taps);
+                }
+                else {
+                    resamp.setRatio(cfg.interp, cfg.decim, cfg.taps);
+                }
+                taps::free(rtaps);
+                rtaps = cfg.taps;
+                fractional = cfg.fractional;
+            }
+            mode = cfg.mode;
+        }
 
-            mode = useDecim ? Mode::BOTH : Mode::RESAMP_ONLY;
+    protected:
+        inline int resample(int count, const T* in, T* out) {
+            return fractional ? frac.process(count, in, out) : resamp.process(count, in, out);
+        }
+
+        inline int resamplerOutputCount(int count) {
+            return fractional ? frac.maxOutputCount(count) : resamp.maxOutputCount(count);
+        }
+
+        void postConfig(Config cfg) {
+            base_type::postUpdate([this, cfg]() mutable { apply(cfg); });
+        }
+
+        void reconfigure() {
+            Config cfg = plan(_inSamplerate, _outSamplerate);
+            apply(cfg);
         }
         
         PowerDecimator<T> decim;
         PolyphaseResampler<T> resamp;
+        FractionalResampler<T> frac;
+        bool fractional = false;
         tap<float> rtaps;
         double _inSamplerate;
         double _outSamplerate;
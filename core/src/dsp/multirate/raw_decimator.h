@@ -0,0 +1,77 @@
+#pragma once
+#include "power_decimator.h"
+
+namespace dsp::multirate {
+    /**
+     * Power of two decimator taking the fixed-point samples of a source, I being complex16_t or complex8_t.
+     * They're only converted to complex_t in small blocks feeding the first stage, see PowerDecimator, so that
+     * the full rate samples go through memory at a quarter or half of the size. With a ratio of 1 it's a plain
+     * conversion.
+     */
+    template<class I>
+    class RawDecimator : public Processor<I, complex_t> {
+        using base_type = Processor<I, complex_t>;
+    public:
+        RawDecimator() {}
+
+        RawDecimator(stream<I>* in, unsigned int ratio, float scale) { init(in, ratio, scale); }
+
+        void init(stream<I>* in, unsigned int ratio, float scale) {
+            _scale = scale;
+            decim.init(NULL, ratio);
+            decim.out.free();
+
+            base_type::init(in);
+
+            // The output grows to the size of the chunks, see run()
+            base_type::out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
+        }
+
+        unsigned int getRatio() { return decim.getRatio(); }
+
+        // The decimator is only used through process(), so its changes are applied by the worker
+        void setRatio(unsigned int ratio) {
+            assert(base_type::_block_init);
+            base_type::postUpdate([this, ratio]() { decim.setRatio(ratio); });
+        }
+
+        // Value of a full scale sample
+        void setScale(float scale) {
+            assert(base_type::_block_init);
+            base_type::postUpdate([this, scale]() { _scale = scale; });
+        }
+
+        void setThreadCount(int count) {
+            assert(base_type::_block_init);
+            base_type::postUpdate([this, count]() { decim.setThreadCount(count); });
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            base_type::postUpdate([this]() { decim.reset(); });
+        }
+
+        inline int process(int count, const I* in, complex_t* out) {
+            return decim.process(count, in, _scale, out);
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            base_type::out.reserve(count);
+            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            // Swap if some data was generated
+            base_type::_in->flush();
+            if (outCount) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return outCount;
+        }
+
+    protected:
+        PowerDecimator<complex_t> decim;
+        float _scale;
+    };
+}
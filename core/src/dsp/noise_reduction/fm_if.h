@@ -1,9 +1,22 @@
 #pragma once
 #include "../processor.h"
 #include "../window/nuttall.h"
-#include <fftw3.h>
+#include "../math/constants.h"
+#include "../fft/plan.h"
+
+// Taps of the window in the frequency domain, the rest of its spectrum is below 3e-5 of the total
+#define FMIF_WINDOW_TAPS        9
+
+// Samples between two exact computations of the sliding DFT, bounding the rounding errors of the recursion
+#define FMIF_RESYNC_INTERVAL    4096
 
 namespace dsp::noise_reduction {
+    /**
+     * Keeps only the strongest frequency of the signal, as the middle sample of the inverse FFT of the
+     * strongest bin of a Nuttall windowed FFT over the last samples. The spectrum is a sliding DFT updated
+     * once per sample, the window being applied as a short convolution over its bins, so that each sample
+     * costs a few operations per bin instead of two FFTs.
+     */
     class FMIF : public Processor<complex_t, complex_t> {
         using base_type = Processor<complex_t, complex_t>;
     public:
@@ -37,41 +50,69 @@ namespace dsp::noise_reduction {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
-            buffer::clear(buffer, _bins - 1);
-            buffer::clear(backFFTIn, _bins);
+            clearState();
             base_type::tempStart();
         }
 
         int process(int count, const complex_t* in, complex_t* out) {
             // Write new input data to buffer buffer
             memcpy(bufferStart, in, count * sizeof(complex_t));
-            
-            // Iterate the FFT
-            for (int i = 0; i < count; i++) {
-                // Apply windows
-                volk_32fc_32f_multiply_32fc((lv_32fc_t*)forwFFTIn, (lv_32fc_t*)&buffer[i], fftWin, _bins);
 
-                // Do forward FFT
-                fftwf_execute(forwardPlan);
+            float* __restrict dRe = &dftRe[FMIF_WINDOW_TAPS / 2];
+            float* __restrict dIm = &dftIm[FMIF_WINDOW_TAPS / 2];
+            float* __restrict sRe = specRe;
+            float* __restrict sIm = specIm;
+            float* __restrict amp = ampBuf;
+            const float* __restrict rRe = rotRe;
+            const float* __restrict rIm = rotIm;
+            const float* __restrict iRe = inRe;
+            const float* __restrict iIm = inIm;
+            float taps[FMIF_WINDOW_TAPS];
+            memcpy(taps, winTaps, sizeof(taps));
 
-                // Process bins here
-                uint32_t idx;
-                volk_32fc_magnitude_32f(ampBuf, (lv_32fc_t*)forwFFTOut, _bins);
-                volk_32f_index_max_32u(&idx, ampBuf, _bins);
+            for (int i = 0; i < count; i++) {
+                // Slide the DFT by one sample, computing it again from time to time
+                if (++sinceResync >= FMIF_RESYNC_INTERVAL) {
+                    resync(&buffer[i + 1]);
+                }
+                else {
+                    float re = buffer[i + _bins].re - buffer[i].re;
+                    float im = buffer[i + _bins].im - buffer[i].im;
+                    for (int j = 0; j < _bins; j++) {
+                        float a = rRe[j] * dRe[j] - rIm[j] * dIm[j] + iRe[j] * re - iIm[j] * im;
+                        float b = rRe[j] * dIm[j] + rIm[j] * dRe[j] + iRe[j] * im + iIm[j] * re;
+                        dRe[j] = a;
+                        dIm[j] = b;
+                    }
+                }
+                wrap();
 
-                // Keep only the bin of highest amplitude
-                backFFTIn[idx] = forwFFTOut[idx];
+                // Apply the window and get the amplitude of each bin
+                for (int j = 0; j < _bins; j++) {
+                    float a = 0.0f;
+                    float b = 0.0f;
+                    for (int k = 0; k < FMIF_WINDOW_TAPS; k++) {
+                        a += taps[k] * dRe[j + (FMIF_WINDOW_TAPS / 2) - k];
+                        b += taps[k] * dIm[j + (FMIF_WINDOW_TAPS / 2) - k];
+                    }
+                    sRe[j] = a;
+                    sIm[j] = b;
+                    amp[j] = a * a + b * b;
+                }
 
-                // Do reverse FFT and get first element
-                fftwf_execute(backwardPlan);
-                out[i] = backFFTOut[_bins / 2];
+                // Keep only the bin of highest amplitude, the first one if several are equal
+                float peak = amp[0];
+                for (int j = 1; j < _bins; j++) { peak = std::max<float>(peak, amp[j]); }
+                int idx = 0;
+                while (amp[idx] != peak) { idx++; }
 
-                // Reset the input buffer
-                backFFTIn[idx] = { 0, 0 };
+                // Middle sample of the inverse FFT of that bin alone
+                complex_t bin = { sRe[idx], sIm[idx] };
+                out[i] = bin * outRot[idx];
             }
 
             // Move buffer buffer
-            memmove(buffer, &buffer[count], (_bins - 1) * sizeof(complex_t));
+            memmove(buffer, &buffer[count], _bins * sizeof(complex_t));
 
             return count;
         }
@@ -89,61 +130,146 @@ namespace dsp::noise_reduction {
         }
 
     protected:
+        /**
+         * Referenced to the middle of the window instead of its first sample, which multiplies each bin by
+         * e^(j * pi * bin * (bins - 1) / bins), the DFT of the window is real. The sliding DFT is kept in that
+         * reference, where the window is a real convolution over the bins, and the phase is only applied to
+         * the output.
+         */
         void initBuffers() {
-            // Allocate FFT buffers
+            int half = FMIF_WINDOW_TAPS / 2;
+
+            // Allocate FFT buffers, the FFT is only used to compute the sliding DFT again
             forwFFTIn = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
             forwFFTOut = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
-            backFFTIn = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
-            backFFTOut = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
 
-            // Allocate and clear delay buffer
+            // Allocate delay buffer, the sample leaving the window is needed too
             buffer = buffer::alloc<complex_t>(STREAM_BUFFER_SIZE + 64000);
-            bufferStart = &buffer[_bins - 1];
-            buffer::clear(buffer, _bins - 1);
-
-            // Clear backward FFT input since only one value is changed and reset at a time
-            buffer::clear(backFFTIn, _bins);
+            bufferStart = &buffer[_bins];
 
-            // Allocate amplitude buffer
+            // Allocate the sliding DFT, with room for the bins wrapping around on both sides
+            dftRe = buffer::alloc<float>(_bins + 2 * half);
+            dftIm = buffer::alloc<float>(_bins + 2 * half);
+            specRe = buffer::alloc<float>(_bins);
+            specIm = buffer::alloc<float>(_bins);
             ampBuf = buffer::alloc<float>(_bins);
 
-            // Allocate and generate Window
-            fftWin = buffer::alloc<float>(_bins);
-            for (int i = 0; i < _bins; i++) { fftWin[i] = window::nuttall(i, _bins - 1); }
+            // Rotation of each bin per sample, phase of each bin in the middle reference and output phase
+            rotRe = buffer::alloc<float>(_bins);
+            rotIm = buffer::alloc<float>(_bins);
+            inRe = buffer::alloc<float>(_bins);
+            inIm = buffer::alloc<float>(_bins);
+            center = buffer::alloc<complex_t>(_bins);
+            outRot = buffer::alloc<complex_t>(_bins);
+            for (int i = 0; i < _bins; i++) {
+                double rot = 2.0 * DB_M_PI * (double)i / (double)_bins;
+                double cphase = DB_M_PI * (double)i * (double)(_bins - 1) / (double)_bins;
+                double ophase = 2.0 * DB_M_PI * (double)i * (double)(_bins / 2) / (double)_bins;
+                rotRe[i] = cos(rot);
+                rotIm[i] = sin(rot);
+                inRe[i] = cos(rot + cphase);
+                inIm[i] = sin(rot + cphase);
+                center[i] = { (float)cos(cphase), (float)sin(cphase) };
+                outRot[i] = { (float)cos(ophase - cphase), (float)sin(ophase - cphase) };
+            }
+
+            // Window in the middle reference, normalised like an inverse FFT. Taps that would wrap onto each other are left out.
+            int used = std::min<int>(half, (_bins - 1) / 2);
+            for (int k = -half; k <= half; k++) {
+                double sum = 0.0;
+                if (abs(k) <= used) {
+                    for (int i = 0; i < _bins; i++) {
+                        sum += window::nuttall(i, _bins - 1) * cos(2.0 * DB_M_PI * (double)k * ((double)i - (double)(_bins - 1) / 2.0) / (double)_bins);
+                    }
+                }
+                winTaps[k + half] = sum / (double)_bins;
+            }
 
-            // Plan FFTs
-            forwardPlan = fftwf_plan_dft_1d(_bins, (fftwf_complex*)forwFFTIn, (fftwf_complex*)forwFFTOut, FFTW_FORWARD, FFTW_ESTIMATE);
-            backwardPlan = fftwf_plan_dft_1d(_bins, (fftwf_complex*)backFFTIn, (fftwf_complex*)backFFTOut, FFTW_BACKWARD, FFTW_ESTIMATE);
+            // Plan FFT
+            forwardPlan.create(fft::FORWARD, _bins, forwFFTIn, forwFFTOut);
+
+            clearState();
         }
 
         void destroyBuffers() {
-            fftwf_destroy_plan(forwardPlan);
-            fftwf_destroy_plan(backwardPlan);
+            forwardPlan.destroy();
             fftwf_free(forwFFTIn);
             fftwf_free(forwFFTOut);
-            fftwf_free(backFFTIn);
-            fftwf_free(backFFTOut);
             buffer::free(buffer);
+            buffer::free(dftRe);
+            buffer::free(dftIm);
+            buffer::free(specRe);
+            buffer::free(specIm);
             buffer::free(ampBuf);
-            buffer::free(fftWin);
+            buffer::free(rotRe);
+            buffer::free(rotIm);
+            buffer::free(inRe);
+            buffer::free(inIm);
+            buffer::free(center);
+            buffer::free(outRot);
+        }
+
+        // The DFT of an empty history is zero
+        void clearState() {
+            buffer::clear(buffer, _bins);
+            buffer::clear(dftRe, _bins + 2 * (FMIF_WINDOW_TAPS / 2));
+            buffer::clear(dftIm, _bins + 2 * (FMIF_WINDOW_TAPS / 2));
+            sinceResync = 0;
+        }
+
+        // Compute the DFT of the window starting at win exactly
+        void resync(const complex_t* win) {
+            memcpy(forwFFTIn, win, _bins * sizeof(complex_t));
+            forwardPlan.execute(forwFFTIn, forwFFTOut);
+            float* dRe = &dftRe[FMIF_WINDOW_TAPS / 2];
+            float* dIm = &dftIm[FMIF_WINDOW_TAPS / 2];
+            for (int i = 0; i < _bins; i++) {
+                complex_t c = forwFFTOut[i] * center[i];
+                dRe[i] = c.re;
+                dIm[i] = c.im;
+            }
+            sinceResync = 0;
+        }
+
+        // Copy the bins at each end around the other, going around changes the middle reference phase by pi * (bins - 1)
+        void wrap() {
+            int half = FMIF_WINDOW_TAPS / 2;
+            float sign = (_bins & 1) ? 1.0f : -1.0f;
+            float* dRe = &dftRe[half];
+            float* dIm = &dftIm[half];
+            for (int k = 1; k <= half; k++) {
+                dRe[-k] = sign * dRe[_bins - k];
+                dIm[-k] = sign * dIm[_bins - k];
+                dRe[_bins - 1 + k] = sign * dRe[k - 1];
+                dIm[_bins - 1 + k] = sign * dIm[k - 1];
+            }
         }
 
         complex_t* forwFFTIn;
         complex_t* forwFFTOut;
-        complex_t* backFFTIn;
-        complex_t* backFFTOut;
 
-        fftwf_plan forwardPlan;
-        fftwf_plan backwardPlan;
+        fft::Plan forwardPlan;
 
         complex_t* buffer;
         complex_t* bufferStart;
 
-        float* fftWin;
-
+        float* dftRe;
+        float* dftIm;
+        float* specRe;
+        float* specIm;
         float* ampBuf;
 
+        float* rotRe;
+        float* rotIm;
+        float* inRe;
+        float* inIm;
+        complex_t* center;
+        complex_t* outRot;
+
+        float winTaps[FMIF_WINDOW_TAPS];
+        int sinceResync;
+
         int _bins;
 
-    }; 
-}
\ No newline at end of file
+    };
+}
@@ -37,7 +37,7 @@ namespace dsp::noise_reduction {
             sum /= (float)count;
 
             if (10.0f * log10f(sum) >= _level) {
-                memcpy(out, in, count * sizeof(complex_t));
+                if (out != in) { memcpy(out, in, count * sizeof(complex_t)); }
             }
             else {
                 memset(out, 0, count * sizeof(complex_t));
@@ -0,0 +1,60 @@
+#include "perf.h"
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#ifndef _MSC_VER
+#include <cxxabi.h>
+#include <stdlib.h>
+#endif
+
+namespace dsp::perf {
+    static std::atomic<bool> enabled = false;
+    static std::mutex blocksMtx;
+    static std::vector<block*> blocks;
+
+    bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void setEnabled(bool enabled) {
+        perf::enabled = enabled;
+    }
+
+    uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::string typeName(const std::type_info& type) {
+#ifdef _MSC_VER
+        std::string name = type.name();
+        if (!name.rfind("class ", 0)) { name = name.substr(6); }
+        return name;
+#else
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(type.name(), NULL, NULL, &status);
+        if (!demangled) { return type.name(); }
+        std::string name = demangled;
+        free(demangled);
+        return name;
+#endif
+    }
+
+    void registerBlock(block* blk) {
+        std::lock_guard<std::mutex> lck(blocksMtx);
+        if (std::find(blocks.begin(), blocks.end(), blk) != blocks.end()) { return; }
+        blocks.push_back(blk);
+    }
+
+    void unregisterBlock(block* blk) {
+        std::lock_guard<std::mutex> lck(blocksMtx);
+        blocks.erase(std::remove(blocks.begin(), blocks.end(), blk), blocks.end());
+    }
+
+    void forEachBlock(std::function<void(block*)> func) {
+        std::lock_guard<std::mutex> lck(blocksMtx);
+        for (auto& blk : blocks) {
+            func(blk);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <typeinfo>
+
+// Chunk sizes are counted in power of two buckets, the last one holding anything bigger
+#define PERF_CHUNK_HISTOGRAM_SIZE   24
+
+namespace dsp {
+    class block;
+}
+
+namespace dsp::perf {
+    /**
+     * Cumulative counters of a block. They're only updated while profiling is enabled
+     * and can be read at any time from any thread.
+     */
+    struct Counters {
+        std::atomic<uint64_t> runs = 0;
+        std::atomic<uint64_t> samplesIn = 0;
+        std::atomic<uint64_t> samplesOut = 0;
+        std::atomic<uint64_t> processTime = 0;  // ns
+        std::atomic<uint64_t> readWaitTime = 0; // ns
+        std::atomic<uint64_t> swapWaitTime = 0; // ns
+        std::atomic<uint64_t> updates = 0;          // Parameter updates applied from the mailbox
+        std::atomic<uint64_t> updateLatency = 0;    // ns between posting and applying them
+        std::atomic<uint64_t> chunkSizes[PERF_CHUNK_HISTOGRAM_SIZE] = {};
+
+        void addChunk(uint64_t size) {
+            int bucket = 0;
+            while (size > 1 && bucket < PERF_CHUNK_HISTOGRAM_SIZE - 1) {
+                size >>= 1;
+                bucket++;
+            }
+            chunkSizes[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void reset() {
+            runs = 0;
+            samplesIn = 0;
+            samplesOut = 0;
+            processTime = 0;
+            readWaitTime = 0;
+            swapWaitTime = 0;
+            updates = 0;
+            updateLatency = 0;
+            for (auto& c : chunkSizes) { c = 0; }
+        }
+    };
+
+    bool isEnabled();
+    void setEnabled(bool enabled);
+
+    // Monotonic time in ns
+    uint64_t now();
+
+    // Readable name of a type
+    std::string typeName(const std::type_info& type);
+
+    void registerBlock(block* blk);
+    void unregisterBlock(block* blk);
+
+    // Call a function for each registered block. Blocks being destroyed wait for this to return.
+    void forEachBlock(std::function<void(block*)> func);
+}
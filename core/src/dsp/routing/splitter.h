@@ -1,4 +1,7 @@
 #pragma once
+#include <chrono>
+#include <map>
+#include <memory>
 #include "../sink.h"
 
 namespace dsp::routing {
@@ -23,6 +26,7 @@ namespace dsp::routing {
             base_type::tempStop();
             base_type::registerOutput(stream);
             streams.push_back(stream);
+            stallTimes[stream] = 0;
             base_type::tempStart();
         }
 
@@ -39,17 +43,50 @@ namespace dsp::routing {
             // Add to the list
             base_type::tempStop();
             streams.erase(sit);
+            stallTimes.erase(stream);
             base_type::unregisterOutput(stream);
             base_type::tempStart();
         }
 
+        /**
+         * In shared mode, every output stream gets a reference to the same read-only buffer instead of a copy.
+         * Readers of the output streams must then never write to their readBuf.
+         */
+        void setSharedMode(bool enabled) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            shared = enabled;
+            base_type::tempStart();
+        }
+
+        bool getSharedMode() { return shared; }
+
+        // Number of buffers the consumer of a stream is behind
+        int getLag(stream<T>* stream) {
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            if (stallTimes.find(stream) == stallTimes.end()) { return 0; }
+            return stream->pending();
+        }
+
+        // Total time in seconds the splitter spent waiting for the consumer of a stream
+        double getStallTime(stream<T>* stream) {
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            auto it = stallTimes.find(stream);
+            if (it == stallTimes.end()) { return 0.0; }
+            return (double)it->second.load() / 1e9;
+        }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            if (shared) { return runShared(count); }
+
             for (const auto& stream : streams) {
+                stream->reserve(count);
                 memcpy(stream->writeBuf, base_type::_in->readBuf, count * sizeof(T));
-                if (!stream->swap(count)) {
+                if (!timedSwap(stream, [stream, count]() { return stream->swap(count); })) {
                     base_type::_in->flush();
                     return -1;
                 }
@@ -61,7 +98,45 @@ namespace dsp::routing {
         }
 
     protected:
+        int runShared(int count) {
+            // Forward the input buffer if it's already shared, otherwise take it over by exchanging it with a spare one
+            buffer::SharedBuffer<T>* buf = base_type::_in->shareReadBuf();
+            if (!buf) {
+                buf = pool->acquire(base_type::_in->getBufferSize());
+                int size = buf->capacity;
+                buf->data = base_type::_in->exchangeReadBuf(buf->data, size);
+                buf->capacity = size;
+            }
+            base_type::_in->flush();
+
+            // Give one reference to each output, ours is kept until all of them are published
+            int n = streams.size();
+            buf->retain(n);
+            for (int i = 0; i < n; i++) {
+                stream<T>* stream = streams[i];
+                if (!timedSwap(stream, [stream, buf, count]() { return stream->swapShared(buf, count); })) {
+                    for (int j = i; j <= n; j++) { buf->release(); }
+                    return -1;
+                }
+            }
+            buf->release();
+
+            return count;
+        }
+
+        template <class Func>
+        inline bool timedSwap(stream<T>* stream, Func swap) {
+            auto start = std::chrono::steady_clock::now();
+            bool ok = swap();
+            auto stall = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            stallTimes[stream] += stall.count();
+            return ok;
+        }
+
         std::vector<stream<T>*> streams;
+        std::map<stream<T>*, std::atomic<uint64_t>> stallTimes;
+        std::shared_ptr<buffer::SharedPool<T>> pool = std::make_shared<buffer::SharedPool<T>>();
+        bool shared = false;
 
     };
 }
\ No newline at end of file
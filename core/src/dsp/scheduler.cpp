@@ -0,0 +1,220 @@
+#include "scheduler.h"
+#include <algorithm>
+
+// Number of times an idle worker yields before going to sleep
+#define SCHEDULER_SPIN_COUNT    64
+
+namespace dsp {
+    static Scheduler* defaultScheduler = NULL;
+    static thread_local Scheduler* localScheduler = NULL;
+    static thread_local int localWorker = -1;
+
+    void task::notify() {
+        Scheduler* s = owner.load();
+        if (s) { s->notify(this); }
+    }
+
+    Scheduler::~Scheduler() {
+        stop();
+    }
+
+    void Scheduler::start(int threadCount) {
+        if (running) { return; }
+        if (threadCount <= 0) {
+            threadCount = std::max<int>(std::thread::hardware_concurrency(), 1);
+        }
+
+        running = true;
+        for (int i = 0; i < threadCount; i++) {
+            workers.push_back(new Worker);
+        }
+        for (int i = 0; i < threadCount; i++) {
+            workers[i]->thread = std::thread(&Scheduler::workerLoop, this, i);
+        }
+    }
+
+    void Scheduler::stop() {
+        if (!running) { return; }
+        {
+            std::lock_guard<std::mutex> lck(sleepMtx);
+            running = false;
+        }
+        sleepCV.notify_all();
+
+        for (auto& w : workers) {
+            if (w->thread.joinable()) { w->thread.join(); }
+            delete w;
+        }
+        workers.clear();
+        queued = 0;
+    }
+
+    void Scheduler::add(task* t) {
+        t->owner = this;
+        t->taskState = task::TASK_IDLE;
+        t->taskActive = true;
+        notify(t);
+    }
+
+    void Scheduler::remove(task* t) {
+        // Prevent the task from being queued again and take it out of all queues
+        t->taskActive = false;
+        for (auto& w : workers) {
+            std::lock_guard<std::mutex> lck(w->mtx);
+            int count = w->queue.size();
+            w->queue.erase(std::remove(w->queue.begin(), w->queue.end(), t), w->queue.end());
+            queued -= count - (int)w->queue.size();
+        }
+
+        // Wait for any worker still holding the task to be done with it
+        removers++;
+        {
+            std::unique_lock<std::mutex> lck(doneMtx);
+            doneCV.wait(lck, [this, t] {
+                for (auto& w : workers) {
+                    if (w->current.load() == t) { return false; }
+                }
+                return true;
+            });
+        }
+        removers--;
+
+        t->taskState = task::TASK_IDLE;
+        t->owner = NULL;
+    }
+
+    void Scheduler::notify(task* t) {
+        int state = t->taskState.load();
+        while (true) {
+            if (state == task::TASK_IDLE) {
+                if (t->taskState.compare_exchange_weak(state, task::TASK_QUEUED)) {
+                    push(t);
+                    return;
+                }
+            }
+            else if (state == task::TASK_RUNNING) {
+                // The worker running it will queue it again once done
+                if (t->taskState.compare_exchange_weak(state, task::TASK_RUNNING_NOTIFIED)) { return; }
+            }
+            else {
+                return;
+            }
+        }
+    }
+
+    Scheduler* Scheduler::getDefault() {
+        return defaultScheduler;
+    }
+
+    void Scheduler::setDefault(Scheduler* scheduler) {
+        defaultScheduler = scheduler;
+    }
+
+    void Scheduler::push(task* t) {
+        // Tasks notified by a worker stay on that worker, the others are spread over all workers
+        bool local = (localScheduler == this);
+        int id = local ? localWorker : (nextWorker++ % (int)workers.size());
+        Worker* w = workers[id];
+
+        int size;
+        {
+            std::lock_guard<std::mutex> lck(w->mtx);
+            if (!t->taskActive) {
+                t->taskState = task::TASK_IDLE;
+                return;
+            }
+            w->queue.push_back(t);
+            size = w->queue.size();
+            queued++;
+        }
+
+        // Only wake up another worker if the local one has more than just its next task to do
+        if (sleepers.load() && (!local || size > 1)) {
+            { std::lock_guard<std::mutex> lck(sleepMtx); }
+            sleepCV.notify_one();
+        }
+    }
+
+    task* Scheduler::pop(int id) {
+        // Newest local task first, it most likely works on data that is still in cache
+        Worker* self = workers[id];
+        {
+            std::lock_guard<std::mutex> lck(self->mtx);
+            if (!self->queue.empty()) {
+                task* t = self->queue.back();
+                self->queue.pop_back();
+                self->current = t;
+                queued--;
+                return t;
+            }
+        }
+
+        // Otherwise steal the oldest task of another worker
+        int count = workers.size();
+        for (int i = 1; i < count; i++) {
+            Worker* w = workers[(id + i) % count];
+            std::lock_guard<std::mutex> lck(w->mtx);
+            if (!w->queue.empty()) {
+                task* t = w->queue.front();
+                w->queue.pop_front();
+                self->current = t;
+                queued--;
+                return t;
+            }
+        }
+
+        return NULL;
+    }
+
+    void Scheduler::execute(int id, task* t) {
+        t->taskState = task::TASK_RUNNING;
+        if (t->taskActive && t->ready()) {
+            // Just like a block thread exiting, a task whose run failed stays dormant until added again
+            if (t->runTask() < 0) { t->taskActive = false; }
+        }
+
+        // Run again if notified in the meantime or if there is still something to process
+        int state = task::TASK_RUNNING;
+        if (!t->taskState.compare_exchange_strong(state, task::TASK_IDLE)) {
+            t->taskState = task::TASK_QUEUED;
+            push(t);
+        }
+        else if (t->taskActive && t->ready()) {
+            notify(t);
+        }
+
+        // Release the task and let a pending remove() know about it
+        workers[id]->current = NULL;
+        if (removers.load()) {
+            { std::lock_guard<std::mutex> lck(doneMtx); }
+            doneCV.notify_all();
+        }
+    }
+
+    void Scheduler::workerLoop(int id) {
+        localScheduler = this;
+        localWorker = id;
+
+        while (running) {
+            task* t = pop(id);
+            if (t) {
+                execute(id, t);
+                continue;
+            }
+
+            // Yield for a little while before sleeping since new work usually comes very soon
+            for (int i = 0; i < SCHEDULER_SPIN_COUNT && !queued.load(); i++) {
+                std::this_thread::yield();
+            }
+            if (queued.load()) { continue; }
+
+            std::unique_lock<std::mutex> lck(sleepMtx);
+            sleepers++;
+            sleepCV.wait(lck, [this] { return queued.load() > 0 || !running; });
+            sleepers--;
+        }
+
+        localScheduler = NULL;
+        localWorker = -1;
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dsp {
+    class Scheduler;
+
+    /**
+     * Unit of work that can be run by a scheduler instead of its own thread. A task is queued when notified
+     * and is then run by one of the scheduler's workers if it's ready, so that run() never has to wait.
+     */
+    class task {
+    public:
+        virtual ~task() {}
+
+        // Must return true only if run() can be called without blocking
+        virtual bool ready() = 0;
+        virtual int run() = 0;
+
+        // Called by the scheduler instead of run() so that tasks can wrap it
+        virtual int runTask() { return run(); }
+
+        // Queue the task if it is attached to a scheduler
+        void notify();
+
+    private:
+        friend Scheduler;
+
+        enum {
+            TASK_IDLE,
+            TASK_QUEUED,
+            TASK_RUNNING,
+            TASK_RUNNING_NOTIFIED
+        };
+
+        std::atomic<Scheduler*> owner = NULL;
+        std::atomic<int> taskState = TASK_IDLE;
+        std::atomic<bool> taskActive = false;
+    };
+
+    /**
+     * Fixed pool of worker threads running tasks. Each worker has its own queue, tasks notified from
+     * a worker are queued locally so that a chain of blocks runs back-to-back on the same core.
+     * Idle workers steal tasks from the other queues before going to sleep.
+     */
+    class Scheduler {
+    public:
+        Scheduler() {}
+        ~Scheduler();
+
+        // Start the workers, a thread count of 0 means one per core
+        void start(int threadCount = 0);
+
+        // Stop the workers, no task must be attached anymore
+        void stop();
+
+        bool isRunning() { return running; }
+        int getThreadCount() { return workers.size(); }
+
+        // Attach a task to the scheduler and queue it
+        void add(task* t);
+
+        // Detach a task from the scheduler. Once this returns, the task isn't running and won't run again.
+        void remove(task* t);
+
+        void notify(task* t);
+
+        // Scheduler used by blocks when they're started, NULL if blocks should use their own thread
+        static Scheduler* getDefault();
+        static void setDefault(Scheduler* scheduler);
+
+    private:
+        struct Worker {
+            std::mutex mtx;
+            std::deque<task*> queue;
+            std::atomic<task*> current = NULL;
+            std::thread thread;
+        };
+
+        void push(task* t);
+        task* pop(int id);
+        void execute(int id, task* t);
+        void workerLoop(int id);
+
+        std::vector<Worker*> workers;
+        std::atomic<bool> running = false;
+        std::atomic<int> queued = 0;
+        std::atomic<int> nextWorker = 0;
+
+        std::mutex sleepMtx;
+        std::condition_variable sleepCV;
+        std::atomic<int> sleepers = 0;
+
+        std::mutex doneMtx;
+        std::condition_variable doneCV;
+        std::atomic<int> removers = 0;
+    };
+}
@@ -31,6 +31,9 @@ namespace dsp::sink {
         buffer::RingBuffer<T> data;
 
     private:
+        // Writing to the ring buffer waits for its reader
+        bool schedulable() { return false; }
+
         void doStop() {
             base_type::_in->stopReader();
             data.stopWriter();
@@ -1,13 +1,25 @@
 #pragma once
 #include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <mutex>
 #include <condition_variable>
 #include <volk/volk.h>
 #include "buffer/buffer.h"
+#include "buffer/shared_buffer.h"
+#include "scheduler.h"
 
-// 1MSample buffer
+// 1MSample buffer, the largest chunk a block may ever write
 #define STREAM_BUFFER_SIZE 1000000
 
+// Initial size of streams that grow to fit the chunks written to them
+#define STREAM_MIN_BUFFER_SIZE 1024
+
+// Two slots behave exactly like the classic double buffer
+#define STREAM_DEFAULT_SLOT_COUNT   2
+#define STREAM_MAX_SLOT_COUNT       64
+
 namespace dsp {
     class untyped_stream {
     public:
@@ -19,76 +31,273 @@ namespace dsp {
         virtual void clearWriteStop() {}
         virtual void stopReader() {}
         virtual void clearReadStop() {}
+
+        // True if read() wouldn't have to wait
+        virtual bool readable() { return false; }
+
+        // True if swap() wouldn't have to wait
+        virtual bool writable() { return false; }
+
+        // Set the task to notify when data becomes available, NULL to detach it
+        void setReaderTask(task* t) { setTask(readerTask, t); }
+
+        // Set the task to notify when a slot is freed, NULL to detach it
+        void setWriterTask(task* t) { setTask(writerTask, t); }
+
+        // Statistics, each only updated by one side of the stream
+        std::atomic<uint64_t> readSamples = 0;      // Samples flushed by the reader
+        std::atomic<uint64_t> readWaitTime = 0;     // ns the reader waited for data
+        std::atomic<uint64_t> writeSamples = 0;     // Samples published by the writer
+        std::atomic<uint64_t> writeWaitTime = 0;    // ns the writer waited for a free slot
+
+    protected:
+        static inline void addStat(std::atomic<uint64_t>& counter, uint64_t value) {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+        static inline uint64_t now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        inline void notifyTask(std::atomic<task*>& target) {
+            if (!target.load(std::memory_order_relaxed)) { return; }
+            notifying++;
+            task* t = target.load();
+            if (t) { t->notify(); }
+            notifying--;
+        }
+
+        std::atomic<task*> readerTask = NULL;
+        std::atomic<task*> writerTask = NULL;
+
+    private:
+        void setTask(std::atomic<task*>& target, task* t) {
+            target.store(t);
+            if (t) { return; }
+
+            // Make sure no notification is still using the old task
+            while (notifying.load()) { std::this_thread::yield(); }
+        }
+
+        std::atomic<int> notifying = 0;
     };
 
+    /**
+     * Single-producer/single-consumer ring of buffers. The writer fills writeBuf and publishes it with swap(),
+     * the reader gets the oldest published buffer in readBuf with read() and releases it with flush().
+     * Indices are lock-free, the mutexes are only used to put a side to sleep when it has to wait.
+     * With more than two slots, the writer can run several buffers ahead of a slow reader.
+     * Buffers come from the buffer pool and are accounted to the pool scope the stream was created in.
+     */
     template <class T>
     class stream : public untyped_stream {
     public:
-        stream() {
-            writeBuf = buffer::alloc<T>(STREAM_BUFFER_SIZE);
-            readBuf = buffer::alloc<T>(STREAM_BUFFER_SIZE);
+        stream(int slotCount = STREAM_DEFAULT_SLOT_COUNT, int bufferSize = STREAM_BUFFER_SIZE) {
+            tag = buffer::pool::currentTag();
+            alloc(slotCount, bufferSize);
         }
 
         virtual ~stream() {
             free();
         }
 
+        /**
+         * Change the size of the buffers. Data in transit is kept: writeBuf is reallocated right away
+         * and the other slots are reallocated when the writer gets to them. Before the first swap,
+         * readBuf is reallocated too, since no reader can be using it and it may serve as scratch space.
+         * Must only be called by the writer or while it isn't running.
+         */
         virtual void setBufferSize(int samples) {
-            buffer::free(writeBuf);
-            buffer::free(readBuf);
-            writeBuf = buffer::alloc<T>(samples);
-            readBuf = buffer::alloc<T>(samples);
+            bufferSize = samples;
+            writeBuf = prepareSlot(slot(writeIdx.load(std::memory_order_relaxed)));
+            if (!swapped) { readBuf = prepareSlot(1); }
+        }
+
+        /**
+         * Make sure writeBuf can hold at least the given number of samples, growing the buffers if needed.
+         * Blocks whose output starts at STREAM_MIN_BUFFER_SIZE call this before writing each chunk.
+         * Must only be called by the writer.
+         */
+        inline void reserve(int samples) {
+            if (samples <= bufferSize) { return; }
+            setBufferSize(std::max<int>(samples, std::min<int>(bufferSize + bufferSize / 2, STREAM_BUFFER_SIZE)));
+        }
+
+        /**
+         * Change the number of slots in the ring. Any data in transit is discarded.
+         * Must only be called while neither the writer nor the reader is running.
+         */
+        void setSlotCount(int count) {
+            int samples = bufferSize;
+            free();
+            alloc(count, samples);
+        }
+
+        int getSlotCount() { return slotCount; }
+
+        int getBufferSize() { return bufferSize; }
+
+        virtual bool readable() {
+            return writeIdx.load() != readIdx.load(std::memory_order_relaxed);
+        }
+
+        virtual bool writable() {
+            return canPublish(writeIdx.load(std::memory_order_relaxed));
+        }
+
+        // Number of buffers that were published but not yet flushed by the reader
+        int pending() {
+            return used(writeIdx.load(std::memory_order_acquire), readIdx.load(std::memory_order_acquire));
         }
 
         virtual inline bool swap(int size) {
-            {
-                // Wait to either swap or stop
+            int w = writeIdx.load(std::memory_order_relaxed);
+
+            // Wait until the slot following the current one is free or the writer is stopped
+            if (!canPublish(w)) {
+                uint64_t start = now();
                 std::unique_lock<std::mutex> lck(swapMtx);
-                swapCV.wait(lck, [this] { return (canSwap || writerStop); });
+                writerWaiting.store(true);
+                swapCV.wait(lck, [this, w] { return canPublish(w) || writerStop; });
+                writerWaiting.store(false, std::memory_order_relaxed);
+                addStat(writeWaitTime, now() - start);
+            }
 
-                // If writer was stopped, abandon operation
-                if (writerStop) { return false; }
+            // If writer was stopped, abandon operation
+            if (writerStop) { return false; }
 
-                // Swap buffers
-                dataSize = size;
-                T* temp = writeBuf;
-                writeBuf = readBuf;
-                readBuf = temp;
-                canSwap = false;
+            // Publish the current slot and move on to the next one
+            sizes[slot(w)] = size;
+            addStat(writeSamples, size);
+            int next = (w + 1) % (2 * slotCount);
+            writeBuf = prepareSlot(slot(next));
+            writeIdx.store(next);
+            swapped = true;
+
+            // Notify reader that some data is ready
+            if (readerWaiting.load()) {
+                { std::lock_guard<std::mutex> lck(rdyMtx); }
+                rdyCV.notify_all();
             }
+            notifyTask(readerTask);
+
+            return true;
+        }
+
+        /**
+         * Publish a shared buffer instead of the content of writeBuf. The stream takes over one reference
+         * of the buffer and releases it once the reader flushes it. If the writer is stopped,
+         * false is returned and the reference stays with the caller.
+         */
+        inline bool swapShared(buffer::SharedBuffer<T>* buf, int size) {
+            int w = writeIdx.load(std::memory_order_relaxed);
+
+            // Wait until the slot following the current one is free or the writer is stopped
+            if (!canPublish(w)) {
+                uint64_t start = now();
+                std::unique_lock<std::mutex> lck(swapMtx);
+                writerWaiting.store(true);
+                swapCV.wait(lck, [this, w] { return canPublish(w) || writerStop; });
+                writerWaiting.store(false, std::memory_order_relaxed);
+                addStat(writeWaitTime, now() - start);
+            }
+
+            // If writer was stopped, abandon operation
+            if (writerStop) { return false; }
+
+            // Publish the shared buffer in the current slot, its own buffer is left untouched
+            shared[slot(w)] = buf;
+            sizes[slot(w)] = size;
+            addStat(writeSamples, size);
+            int next = (w + 1) % (2 * slotCount);
+            writeBuf = prepareSlot(slot(next));
+            writeIdx.store(next);
+            swapped = true;
 
             // Notify reader that some data is ready
-            {
-                std::lock_guard<std::mutex> lck(rdyMtx);
-                dataReady = true;
+            if (readerWaiting.load()) {
+                { std::lock_guard<std::mutex> lck(rdyMtx); }
+                rdyCV.notify_all();
             }
-            rdyCV.notify_all();
+            notifyTask(readerTask);
 
             return true;
         }
 
         virtual inline int read() {
+            int r = readIdx.load(std::memory_order_relaxed);
+
             // Wait for data to be ready or to be stopped
-            std::unique_lock<std::mutex> lck(rdyMtx);
-            rdyCV.wait(lck, [this] { return (dataReady || readerStop); });
+            if (writeIdx.load(std::memory_order_acquire) == r) {
+                uint64_t start = now();
+                std::unique_lock<std::mutex> lck(rdyMtx);
+                readerWaiting.store(true);
+                rdyCV.wait(lck, [this, r] { return (writeIdx.load() != r) || readerStop; });
+                readerWaiting.store(false, std::memory_order_relaxed);
+                addStat(readWaitTime, now() - start);
+            }
 
-            return (readerStop ? -1 : dataSize);
+            if (readerStop) { return -1; }
+            readBuf = shared[slot(r)] ? shared[slot(r)]->data : slots[slot(r)];
+            return sizes[slot(r)];
         }
 
         virtual inline void flush() {
-            // Clear data ready
-            {
-                std::lock_guard<std::mutex> lck(rdyMtx);
-                dataReady = false;
-            }
+            // Release the slot being read, if any
+            int r = readIdx.load(std::memory_order_relaxed);
+            if (writeIdx.load(std::memory_order_acquire) == r) { return; }
+            buffer::SharedBuffer<T>* buf = shared[slot(r)];
+            shared[slot(r)] = NULL;
+            marks[slot(r)] = 0;
+            addStat(readSamples, sizes[slot(r)]);
+            readIdx.store((r + 1) % (2 * slotCount));
+            if (buf) { buf->release(); }
 
-            // Notify writer that buffers can be swapped
-            {
-                std::lock_guard<std::mutex> lck(swapMtx);
-                canSwap = true;
+            // Notify writer that a slot is free
+            if (writerWaiting.load()) {
+                { std::lock_guard<std::mutex> lck(swapMtx); }
+                swapCV.notify_all();
             }
+            notifyTask(writerTask);
+        }
 
-            swapCV.notify_all();
+        /**
+         * Mark the chunk being written, its reader gets the value back from readMark(). Lets a writer tell
+         * the reader from which chunk on a change it was asked for took effect. Chunks are unmarked by default.
+         * Must only be called by the writer, before swapping the chunk.
+         */
+        inline void mark(int value) {
+            marks[slot(writeIdx.load(std::memory_order_relaxed))] = value;
+        }
+
+        // Mark of the chunk being read, 0 if it has none. Must only be called by the reader, between read() and flush().
+        inline int readMark() {
+            return marks[slot(readIdx.load(std::memory_order_relaxed))];
+        }
+
+        /**
+         * Take ownership of the buffer currently being read, giving a buffer of the given size in exchange.
+         * On return, size holds the size of the buffer that was taken.
+         * Returns NULL without exchanging anything if the slot holds a shared buffer.
+         * Must only be called by the reader, between read() and flush().
+         */
+        inline T* exchangeReadBuf(T* buf, int& size) {
+            int s = slot(readIdx.load(std::memory_order_relaxed));
+            if (shared[s]) { return NULL; }
+            T* data = slots[s];
+            std::swap(size, slotSizes[s]);
+            slots[s] = buf;
+            return data;
+        }
+
+        /**
+         * Get an extra reference to the shared buffer currently being read, NULL if the slot doesn't hold one.
+         * Must only be called by the reader, between read() and flush().
+         */
+        inline buffer::SharedBuffer<T>* shareReadBuf() {
+            buffer::SharedBuffer<T>* buf = shared[slot(readIdx.load(std::memory_order_relaxed))];
+            if (buf) { buf->retain(); }
+            return buf;
         }
 
         virtual void stopWriter() {
@@ -116,27 +325,80 @@ namespace dsp {
         }
 
         void free() {
-            if (writeBuf) { buffer::free(writeBuf); }
-            if (readBuf) { buffer::free(readBuf); }
+            for (int i = 0; i < slotCount; i++) {
+                if (slots[i]) { buffer::free(slots[i]); }
+                if (shared[i]) { shared[i]->release(); }
+                slots[i] = NULL;
+                shared[i] = NULL;
+                slotSizes[i] = -1;
+            }
             writeBuf = NULL;
             readBuf = NULL;
         }
 
         T* writeBuf;
+
+        // Only valid between read() and flush(), except before the first swap where it's a separate buffer of the stream's size
         T* readBuf;
 
     private:
+        void alloc(int count, int samples) {
+            slotCount = std::clamp<int>(count, 2, STREAM_MAX_SLOT_COUNT);
+            bufferSize = samples;
+            for (int i = 0; i < slotCount; i++) {
+                slots[i] = buffer::alloc<T>(bufferSize, tag);
+                slotSizes[i] = bufferSize;
+                sizes[i] = 0;
+                marks[i] = 0;
+            }
+            writeIdx.store(0);
+            readIdx.store(0);
+            // Until the first read, readBuf is a buffer of its own. Some blocks that are only used through
+            // process() use both buffers of their output as scratch space.
+            writeBuf = slots[0];
+            readBuf = slots[1];
+            swapped = false;
+        }
+
+        // Reallocate a slot owned by the writer if its size doesn't match the buffer size anymore
+        inline T* prepareSlot(int s) {
+            if (slotSizes[s] != bufferSize) {
+                buffer::free(slots[s]);
+                slots[s] = buffer::alloc<T>(bufferSize, tag);
+                slotSizes[s] = bufferSize;
+            }
+            return slots[s];
+        }
+
+        // Indices run from 0 to 2*slotCount-1 so that a full ring can be told apart from an empty one
+        inline int slot(int idx) { return idx % slotCount; }
+        inline int used(int w, int r) { return (w - r + 2 * slotCount) % (2 * slotCount); }
+
+        // The writer keeps ownership of one free slot, so it can only publish if another slot is free
+        inline bool canPublish(int w) { return used(w, readIdx.load()) < slotCount - 1; }
+
+        T* slots[STREAM_MAX_SLOT_COUNT] = {};
+        buffer::SharedBuffer<T>* shared[STREAM_MAX_SLOT_COUNT] = {};
+        int sizes[STREAM_MAX_SLOT_COUNT];
+        int marks[STREAM_MAX_SLOT_COUNT];
+        int slotSizes[STREAM_MAX_SLOT_COUNT];
+        int slotCount = 0;
+        std::atomic<int> bufferSize = 0;
+        int tag;
+
+        std::atomic<int> writeIdx = 0;
+        std::atomic<int> readIdx = 0;
+        bool swapped = false;   // Only used by the writer
+
         std::mutex swapMtx;
         std::condition_variable swapCV;
-        bool canSwap = true;
+        std::atomic<bool> writerWaiting = false;
 
         std::mutex rdyMtx;
         std::condition_variable rdyCV;
-        bool dataReady = false;
-
-        bool readerStop = false;
-        bool writerStop = false;
+        std::atomic<bool> readerWaiting = false;
 
-        int dataSize = 0;
+        std::atomic<bool> readerStop = false;
+        std::atomic<bool> writerStop = false;
     };
-}
\ No newline at end of file
+}
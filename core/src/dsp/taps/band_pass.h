@@ -2,6 +2,7 @@
 #include "../types.h"
 #include "windowed_sinc.h"
 #include "estimate_tap_count.h"
+#include "cache.h"
 #include "../window/nuttall.h"
 #include "../math/phasor.h"
 #include "../math/hz_to_rads.h"
@@ -13,14 +14,16 @@ namespace dsp::taps {
         float offsetOmega = math::hzToRads((bandStart + bandStop) / 2.0, sampleRate);
         int count = estimateTapCount(transWidth, sampleRate);
         if (oddTapCount && !(count % 2)) { count++; }
-        return windowedSinc<T>(count, (bandStop - bandStart) / 2.0, sampleRate, [=](double n, double N) {
-            if constexpr (std::is_same_v<T, float>) {
-                return 2.0f * cosf(offsetOmega * (float)n) * window::nuttall(n, N);
-            }
-            if constexpr (std::is_same_v<T, complex_t>) {
-                // The offset is negative to flip the taps. Complex bandpass are asymetric
-                return math::phasor(-offsetOmega * (float)n) * window::nuttall(n, N);
-            }
+        return cache::get<T>(cache::key("bandPass", count, bandStart, bandStop, sampleRate), count, [=]() {
+            return windowedSinc<T>(count, (bandStop - bandStart) / 2.0, sampleRate, [=](double n, double N) {
+                if constexpr (std::is_same_v<T, float>) {
+                    return 2.0f * cosf(offsetOmega * (float)n) * window::nuttall(n, N);
+                }
+                if constexpr (std::is_same_v<T, complex_t>) {
+                    // The offset is negative to flip the taps. Complex bandpass are asymetric
+                    return math::phasor(-offsetOmega * (float)n) * window::nuttall(n, N);
+                }
+            });
         });
     }
 }
\ No newline at end of file
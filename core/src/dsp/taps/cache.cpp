@@ -0,0 +1,83 @@
+#include "cache.h"
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace dsp::taps::cache {
+    using LRU = std::list<std::pair<std::string, std::shared_ptr<const Entry>>>;
+
+    static std::mutex mtx;
+    static LRU lru; // Most recently used first
+    static std::unordered_map<std::string, LRU::iterator> entries;
+    static size_t totalBytes = 0;
+    static size_t limit = TAPS_CACHE_DEFAULT_LIMIT;
+    static uint64_t hits = 0;
+    static uint64_t misses = 0;
+
+    // Drop the least recently used designs until the cache fits in the limit, the lock must be held
+    static void evict() {
+        while (totalBytes > limit && !lru.empty()) {
+            auto& last = lru.back();
+            totalBytes -= last.second->data.size();
+            entries.erase(last.first);
+            lru.pop_back();
+        }
+    }
+
+    std::shared_ptr<const Entry> find(const std::string& key) {
+        std::lock_guard<std::mutex> lck(mtx);
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            misses++;
+            return NULL;
+        }
+        hits++;
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->second;
+    }
+
+    void insert(const std::string& key, std::shared_ptr<const Entry> entry) {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        // Another thread may have made the same design in the meantime
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            totalBytes -= it->second->second->data.size();
+            lru.erase(it->second);
+            entries.erase(it);
+        }
+
+        lru.emplace_front(key, entry);
+        entries[key] = lru.begin();
+        totalBytes += entry->data.size();
+        evict();
+    }
+
+    void setLimit(size_t bytes) {
+        std::lock_guard<std::mutex> lck(mtx);
+        limit = bytes;
+        evict();
+    }
+
+    size_t getLimit() {
+        std::lock_guard<std::mutex> lck(mtx);
+        return limit;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lck(mtx);
+        lru.clear();
+        entries.clear();
+        totalBytes = 0;
+    }
+
+    Stats getStats() {
+        std::lock_guard<std::mutex> lck(mtx);
+        Stats stats;
+        stats.hits = hits;
+        stats.misses = misses;
+        stats.entries = entries.size();
+        stats.bytes = totalBytes;
+        return stats;
+    }
+}
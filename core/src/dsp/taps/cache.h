@@ -0,0 +1,82 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <vector>
+#include "tap.h"
+
+// Default largest total size of the cached designs, the least recently used ones are dropped past it
+#define TAPS_CACHE_DEFAULT_LIMIT    (32 << 20)
+
+// Designs shorter than this are quicker to compute again than to look up
+#define TAPS_CACHE_MIN_SIZE         64
+
+namespace dsp::taps::cache {
+    struct Stats {
+        uint64_t hits;      // Designs copied from the cache
+        uint64_t misses;    // Designs that had to be computed
+        size_t entries;     // Number of cached designs
+        size_t bytes;       // Total size of the cached designs
+    };
+
+    // A cached design. It's never modified once cached, lookups in flight keep it alive if it gets dropped.
+    struct Entry {
+        std::vector<uint8_t> data;
+        int count;
+    };
+
+    // Design cached under a key, or NULL if there's none
+    std::shared_ptr<const Entry> find(const std::string& key);
+
+    // Cache a design, replacing any other cached under the same key
+    void insert(const std::string& key, std::shared_ptr<const Entry> entry);
+
+    void setLimit(size_t bytes);
+    size_t getLimit();
+
+    // Drop all cached designs
+    void clear();
+
+    Stats getStats();
+
+    // Key of a design, from its name and every parameter it depends on. Doubles are written exactly.
+    template<class... Args>
+    inline std::string key(const char* design, Args... params) {
+        std::string key = design;
+        char buf[64];
+        for (double p : { (double)params... }) {
+            snprintf(buf, sizeof(buf), "/%a", p);
+            key += buf;
+        }
+        return key;
+    }
+
+    /**
+     * Taps of a design, copied from the cache if the same design was made before or designed and cached
+     * otherwise. The returned taps belong to the caller like any other, to be freed with taps::free().
+     */
+    template<class T, typename Func>
+    inline tap<T> get(const std::string& key, int count, Func design) {
+        if (count < TAPS_CACHE_MIN_SIZE) { return design(); }
+
+        // The same parameters give different taps for different tap types
+        std::string fullKey = std::string(typeid(T).name()) + ":" + key;
+        std::shared_ptr<const Entry> entry = find(fullKey);
+        if (entry) {
+            tap<T> taps = taps::alloc<T>(entry->count);
+            memcpy(taps.taps, entry->data.data(), entry->count * sizeof(T));
+            return taps;
+        }
+
+        tap<T> taps = design();
+        auto newEntry = std::make_shared<Entry>();
+        newEntry->count = taps.size;
+        newEntry->data.resize(taps.size * sizeof(T));
+        memcpy(newEntry->data.data(), taps.taps, taps.size * sizeof(T));
+        insert(fullKey, newEntry);
+        return taps;
+    }
+}
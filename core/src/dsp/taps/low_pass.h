@@ -1,12 +1,15 @@
 #pragma once
 #include "windowed_sinc.h"
 #include "estimate_tap_count.h"
+#include "cache.h"
 #include "../window/nuttall.h"
 
 namespace dsp::taps {
     inline tap<float> lowPass(double cutoff, double transWidth, double sampleRate, bool oddTapCount = false) {
         int count = estimateTapCount(transWidth, sampleRate);
         if (oddTapCount && !(count % 2)) { count++; }
-        return windowedSinc<float>(count, cutoff, sampleRate, window::nuttall);
+        return cache::get<float>(cache::key("lowPass", count, cutoff, sampleRate), count, [=]() {
+            return windowedSinc<float>(count, cutoff, sampleRate, window::nuttall);
+        });
     }
 }
\ No newline at end of file
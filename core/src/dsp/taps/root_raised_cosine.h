@@ -1,11 +1,12 @@
 #pragma once
 #include <math.h>
 #include "tap.h"
+#include "cache.h"
 #include "../math/constants.h"
 
 namespace dsp::taps {
     template<class T>
-    inline tap<T> rootRaisedCosine(int count, double beta, double Ts) {
+    inline tap<T> designRootRaisedCosine(int count, double beta, double Ts) {
         // Allocate taps
         tap<T> taps = taps::alloc<T>(count);
         
@@ -28,6 +29,14 @@ namespace dsp::taps {
         return taps;
     }
 
+    // Same as designRootRaisedCosine(), through the design cache
+    template<class T>
+    inline tap<T> rootRaisedCosine(int count, double beta, double Ts) {
+        return cache::get<T>(cache::key("rootRaisedCosine", count, beta, Ts), count, [=]() {
+            return designRootRaisedCosine<T>(count, beta, Ts);
+        });
+    }
+
     template<class T>
     inline tap<T> rootRaisedCosine(int count, double beta, double symbolrate, double samplerate) {
         return rootRaisedCosine<T>(count, beta, samplerate / symbolrate);
@@ -0,0 +1,81 @@
+#include "thread_team.h"
+#include <algorithm>
+
+// Number of times the caller yields waiting for the helpers before going to sleep
+#define THREAD_TEAM_SPIN_COUNT  64
+
+namespace dsp {
+    ThreadTeam::~ThreadTeam() {
+        setThreadCount(1);
+    }
+
+    void ThreadTeam::setThreadCount(int count) {
+        count = std::max<int>(count, 1);
+        if (count == getThreadCount()) { return; }
+
+        // Stop the current helpers
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            stopping = true;
+        }
+        startCV.notify_all();
+        for (auto& t : helpers) { t.join(); }
+        helpers.clear();
+        stopping = false;
+
+        // Start the new ones, the first part always runs on the caller. They only wait for jobs handed out after now.
+        for (int i = 1; i < count; i++) {
+            helpers.push_back(std::thread(&ThreadTeam::helperLoop, this, i, generation));
+        }
+    }
+
+    void ThreadTeam::run(int parts, const std::function<void(int)>& func) {
+        parts = std::min<int>(parts, helpers.size() + 1);
+        if (parts <= 1) {
+            if (parts == 1) { func(0); }
+            return;
+        }
+
+        // Hand out the other parts
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            job = &func;
+            jobParts = parts;
+            pending = parts - 1;
+            generation++;
+        }
+        startCV.notify_all();
+
+        func(0);
+
+        // The helpers are usually almost done too, so yield for a little while before sleeping
+        for (int i = 0; i < THREAD_TEAM_SPIN_COUNT && pending.load(); i++) {
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lck(mtx);
+        doneCV.wait(lck, [this] { return !pending.load(); });
+        job = NULL;
+    }
+
+    void ThreadTeam::helperLoop(int id, uint64_t seen) {
+        while (true) {
+            const std::function<void(int)>* func;
+            {
+                std::unique_lock<std::mutex> lck(mtx);
+                startCV.wait(lck, [this, seen] { return stopping || generation != seen; });
+                if (stopping) { return; }
+                seen = generation;
+                if (id >= jobParts) { continue; }
+                func = job;
+            }
+
+            (*func)(id);
+
+            // The last helper done wakes up the caller
+            if (pending.fetch_sub(1) == 1) {
+                { std::lock_guard<std::mutex> lck(mtx); }
+                doneCV.notify_one();
+            }
+        }
+    }
+}
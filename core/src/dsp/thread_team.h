@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dsp {
+    /**
+     * Small team of helper threads splitting a job into parts, for blocks whose own work is too much for a
+     * single core. Unlike the scheduler it's a fork-join: run() hands out the parts, works on the first
+     * one itself and only returns once all of them are done.
+     */
+    class ThreadTeam {
+    public:
+        ThreadTeam() {}
+        ~ThreadTeam();
+
+        // Number of threads working on a job, the caller of run() included. 1 stops all helpers.
+        // Must not be called while a job is running.
+        void setThreadCount(int count);
+        int getThreadCount() { return helpers.size() + 1; }
+
+        // Run func(part) for every part from 0 to parts - 1, at most one part per thread
+        void run(int parts, const std::function<void(int)>& func);
+
+    private:
+        void helperLoop(int id, uint64_t seen);
+
+        std::vector<std::thread> helpers;
+
+        std::mutex mtx;
+        std::condition_variable startCV;
+        std::condition_variable doneCV;
+        const std::function<void(int)>* job = NULL;
+        int jobParts = 0;
+        uint64_t generation = 0;
+        std::atomic<int> pending = 0;
+        bool stopping = false;
+    };
+}
@@ -19,6 +19,7 @@
 #include <gui/menus/sink.h>
 #include <gui/menus/vfo_color.h>
 #include <gui/menus/module_manager.h>
+#include <gui/menus/dsp_profiler.h>
 #include <gui/menus/theme.h>
 #include <gui/dialogs/credits.h>
 #include <filesystem>
@@ -77,6 +78,7 @@ void MainWindow::init() {
     gui::menu.registerEntry("Theme", thememenu::draw, NULL);
     gui::menu.registerEntry("VFO Color", vfo_color_menu::draw, NULL);
     gui::menu.registerEntry("Module Manager", module_manager_menu::draw, NULL);
+    gui::menu.registerEntry("DSP Profiler", dsp_profiler_menu::draw, NULL);
 
     gui::freqSelect.init();
 
@@ -84,11 +86,7 @@ void MainWindow::init() {
     gui::waterfall.setBandwidth(8000000);
     gui::waterfall.setViewBandwidth(8000000);
 
-    fft_in = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * fftSize);
-    fft_out = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * fftSize);
-    fftwPlan = fftwf_plan_dft_1d(fftSize, fft_in, fft_out, FFTW_FORWARD, FFTW_ESTIMATE);
-
-    sigpath::iqFrontEnd.init(&dummyStream, 8000000, true, 1, false, 1024, 20.0, IQFrontEnd::FFTWindow::NUTTALL, acquireFFTBuffer, releaseFFTBuffer, this);
+    sigpath::iqFrontEnd.init(&dummyStream, 8000000, true, FRAME_BUFFER_DEFAULT_DEPTH, 1, false, 1024, 20.0, IQFrontEnd::FFTWindow::NUTTALL, acquireFFTBuffer, releaseFFTBuffer, this);
     sigpath::iqFrontEnd.start();
 
     vfoCreatedHandler.handler = vfoAddedHandler;
@@ -169,6 +167,7 @@ void MainWindow::init() {
     displaymenu::init();
     vfo_color_menu::init();
     module_manager_menu::init();
+    dsp_profiler_menu::init();
 
     // TODO for 0.2.5
     // Fix gain not updated on startup, soapysdr
@@ -509,10 +508,6 @@ void MainWindow::draw() {
             ImGui::Checkbox("Show demo window", &demoWindow);
             ImGui::Text("ImGui version: %s", ImGui::GetVersion());
 
-            // ImGui::Checkbox("Bypass buffering", &sigpath::iqFrontEnd.inputBuffer.bypass);
-
-            // ImGui::Text("Buffering: %d", (sigpath::iqFrontEnd.inputBuffer.writeCur - sigpath::iqFrontEnd.inputBuffer.readCur + 32) % 32);
-
             if (ImGui::Button("Test Bug")) {
                 flog::error("Will this make the software crash?");
             }
@@ -0,0 +1,301 @@
+#include <gui/menus/dsp_profiler.h>
+#include <imgui.h>
+#include <gui/style.h>
+#include <dsp/block.h>
+#include <dsp/buffer/pool.h>
+#include <dsp/taps/cache.h>
+#include <dsp/kernel/kernel.h>
+#include <dsp/fft/plan.h>
+#include <core.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Time between updates of the displayed statistics
+#define DSP_PROFILER_UPDATE_PERIOD  1000000000ULL
+
+namespace dsp_profiler_menu {
+    struct Snapshot {
+        uint64_t samplesIn = 0;
+        uint64_t samplesOut = 0;
+        uint64_t processTime = 0;
+        uint64_t readWaitTime = 0;
+        uint64_t swapWaitTime = 0;
+        uint64_t updates = 0;
+        uint64_t updateLatency = 0;
+    };
+
+    struct Row {
+        std::string name;
+        std::string typeName;
+        int depth;
+        float cpu;
+        float inRate;
+        float outRate;
+        float starved;
+        float backpressure;
+        float updateLatency;
+        uint64_t chunkSizes[PERF_CHUNK_HISTOGRAM_SIZE];
+    };
+
+    std::map<dsp::block*, Snapshot> snapshots;
+    std::vector<Row> rows;
+    uint64_t lastUpdate = 0;
+
+    // Strip the namespace and template arguments to keep the table narrow
+    std::string shortName(const std::string& typeName) {
+        std::string name = typeName.substr(0, typeName.find('<'));
+        size_t pos = name.rfind("::");
+        return (pos == std::string::npos) ? name : name.substr(pos + 2);
+    }
+
+    void update() {
+        uint64_t now = dsp::perf::now();
+        double elapsed = (double)(now - lastUpdate);
+        bool valid = lastUpdate != 0;
+        lastUpdate = now;
+
+        struct Node {
+            Row row;
+            std::vector<dsp::untyped_stream*> inputs;
+            std::vector<dsp::untyped_stream*> outputs;
+        };
+        std::map<dsp::block*, Node> nodes;
+        std::map<dsp::block*, Snapshot> newSnapshots;
+
+        // Read the counters and connections of all blocks
+        dsp::perf::forEachBlock([&](dsp::block* blk) {
+            Node node;
+            if (!blk->getStreams(node.inputs, node.outputs)) { return; }
+
+            dsp::perf::Counters& c = blk->getCounters();
+            Snapshot snap;
+            snap.samplesIn = c.samplesIn;
+            snap.samplesOut = c.samplesOut;
+            snap.processTime = c.processTime;
+            snap.readWaitTime = c.readWaitTime;
+            snap.swapWaitTime = c.swapWaitTime;
+            snap.updates = c.updates;
+            snap.updateLatency = c.updateLatency;
+
+            Snapshot prev = snapshots[blk];
+            Row& row = node.row;
+            row.typeName = blk->getTypeName();
+            row.name = shortName(row.typeName);
+            row.depth = 0;
+            row.cpu = valid ? 100.0f * (float)(snap.processTime - prev.processTime) / elapsed : 0.0f;
+            row.inRate = valid ? 1e3f * (float)(snap.samplesIn - prev.samplesIn) / elapsed : 0.0f;
+            row.outRate = valid ? 1e3f * (float)(snap.samplesOut - prev.samplesOut) / elapsed : 0.0f;
+            row.starved = valid ? 100.0f * (float)(snap.readWaitTime - prev.readWaitTime) / elapsed : 0.0f;
+            row.backpressure = valid ? 100.0f * (float)(snap.swapWaitTime - prev.swapWaitTime) / elapsed : 0.0f;
+            uint64_t updates = snap.updates - prev.updates;
+            row.updateLatency = (valid && updates) ? 1e-6f * (float)(snap.updateLatency - prev.updateLatency) / (float)updates : -1.0f;
+            for (int i = 0; i < PERF_CHUNK_HISTOGRAM_SIZE; i++) { row.chunkSizes[i] = c.chunkSizes[i]; }
+
+            newSnapshots[blk] = snap;
+            nodes[blk] = node;
+        });
+        snapshots = newSnapshots;
+
+        // Find which block writes to each stream
+        std::map<dsp::untyped_stream*, dsp::block*> writers;
+        for (auto& [blk, node] : nodes) {
+            for (auto& out : node.outputs) { writers[out] = blk; }
+        }
+
+        // Find the downstream blocks of each block and the blocks that aren't fed by any other
+        std::map<dsp::block*, std::vector<dsp::block*>> children;
+        std::vector<dsp::block*> roots;
+        for (auto& [blk, node] : nodes) {
+            bool fed = false;
+            for (auto& in : node.inputs) {
+                auto it = writers.find(in);
+                if (it == writers.end() || it->second == blk) { continue; }
+                children[it->second].push_back(blk);
+                fed = true;
+            }
+            if (!fed) { roots.push_back(blk); }
+        }
+
+        // List the graph depth first from its roots
+        rows.clear();
+        std::set<dsp::block*> visited;
+        std::function<void(dsp::block*, int)> visit = [&](dsp::block* blk, int depth) {
+            if (visited.find(blk) != visited.end()) { return; }
+            visited.insert(blk);
+            Row row = nodes[blk].row;
+            row.depth = depth;
+            rows.push_back(row);
+            for (auto& child : children[blk]) { visit(child, depth + 1); }
+        };
+        for (auto& blk : roots) { visit(blk, 0); }
+
+        // Blocks that are only part of a loop
+        for (auto& [blk, node] : nodes) { visit(blk, 0); }
+    }
+
+    void init() {
+        rows.clear();
+        snapshots.clear();
+        lastUpdate = 0;
+    }
+
+    void drawLoad(float value, float warn) {
+        if (value >= warn) {
+            ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "%.1f%%", value);
+        }
+        else {
+            ImGui::Text("%.1f%%", value);
+        }
+    }
+
+    std::string formatBytes(size_t bytes) {
+        char buf[32];
+        if (bytes >= 1024 * 1024) {
+            sprintf(buf, "%.1f MB", (double)bytes / (1024.0 * 1024.0));
+        }
+        else {
+            sprintf(buf, "%.1f KB", (double)bytes / 1024.0);
+        }
+        return buf;
+    }
+
+    void drawMemory() {
+        dsp::buffer::pool::Stats stats = dsp::buffer::pool::getStats();
+        ImGui::Text("Buffers: %s in use, %s cached", formatBytes(stats.inUse).c_str(), formatBytes(stats.cached).c_str());
+        if (stats.allocs) {
+            ImGui::Text("Pool hits: %.1f%%", 100.0 * (double)stats.hits / (double)stats.allocs);
+        }
+
+        dsp::taps::cache::Stats tapStats = dsp::taps::cache::getStats();
+        ImGui::Text("Tap designs: %d cached, %s", (int)tapStats.entries, formatBytes(tapStats.bytes).c_str());
+        if (tapStats.hits + tapStats.misses) {
+            ImGui::Text("Tap cache hits: %.1f%% (%llu / %llu)", 100.0 * (double)tapStats.hits / (double)(tapStats.hits + tapStats.misses),
+                        (unsigned long long)tapStats.hits, (unsigned long long)(tapStats.hits + tapStats.misses));
+        }
+
+        bool hugePages = dsp::buffer::pool::getHugePages();
+        if (ImGui::Checkbox("Use huge pages##dsp_profiler_huge_pages", &hugePages)) {
+            dsp::buffer::pool::setHugePages(hugePages);
+            core::configManager.acquire();
+            core::configManager.conf["dspBufferPool"]["hugePages"] = hugePages;
+            core::configManager.release(true);
+        }
+        if (hugePages) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("(%s)", formatBytes(stats.hugePages).c_str());
+        }
+
+        if (ImGui::BeginTable("DSP Profiler Memory Table", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Owner");
+            ImGui::TableSetupColumn("Memory");
+            ImGui::TableHeadersRow();
+
+            dsp::buffer::pool::forEachTag([](const std::string& name, size_t bytes) {
+                if (!bytes) { return; }
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::TextUnformatted(name.c_str());
+                ImGui::TableSetColumnIndex(1);
+                ImGui::TextUnformatted(formatBytes(bytes).c_str());
+            });
+
+            ImGui::EndTable();
+        }
+    }
+
+    // Variant each kernel uses at each size class, see dsp::kernel::tune()
+    void drawKernels() {
+        if (ImGui::BeginTable("DSP Profiler Kernel Table", KERNEL_SIZE_CLASSES + 1, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Kernel");
+            for (int c = 0; c < KERNEL_SIZE_CLASSES; c++) {
+                ImGui::TableSetupColumn(("<= " + std::to_string(dsp::kernel::CLASS_SIZES[c])).c_str());
+            }
+            ImGui::TableHeadersRow();
+
+            for (auto k : dsp::kernel::getKernels()) {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::TextUnformatted(k->getName().c_str());
+                for (int c = 0; c < KERNEL_SIZE_CLASSES; c++) {
+                    ImGui::TableSetColumnIndex(c + 1);
+                    ImGui::TextUnformatted(dsp::kernel::isaName(k->getVariantISA(k->getSelected(c))));
+                }
+            }
+
+            ImGui::EndTable();
+        }
+
+        int pending = dsp::fft::getPendingUpgrades();
+        if (pending) { ImGui::Text("Measuring FFT plans, %d left", pending); }
+    }
+
+    void draw(void* ctx) {
+        drawMemory();
+        drawKernels();
+
+        bool enabled = dsp::perf::isEnabled();
+        if (ImGui::Checkbox("Enable profiling##dsp_profiler_enable", &enabled)) {
+            dsp::perf::setEnabled(enabled);
+            init();
+        }
+        if (!enabled) { return; }
+
+        if (dsp::perf::now() - lastUpdate >= DSP_PROFILER_UPDATE_PERIOD) { update(); }
+
+        if (ImGui::BeginTable("DSP Profiler Table", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_ScrollX, ImVec2(0, 300.0f * style::uiScale))) {
+            ImGui::TableSetupColumn("Block");
+            ImGui::TableSetupColumn("CPU");
+            ImGui::TableSetupColumn("In (MS/s)");
+            ImGui::TableSetupColumn("Out (MS/s)");
+            ImGui::TableSetupColumn("Starved");
+            ImGui::TableSetupColumn("Backpr.");
+            ImGui::TableSetupColumn("Update (ms)");
+            ImGui::TableSetupScrollFreeze(1, 1);
+            ImGui::TableHeadersRow();
+
+            for (auto& row : rows) {
+                ImGui::TableNextRow();
+
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%*s%s", row.depth * 2, "", row.name.c_str());
+                if (ImGui::IsItemHovered()) {
+                    ImGui::BeginTooltip();
+                    ImGui::TextUnformatted(row.typeName.c_str());
+                    ImGui::Separator();
+                    ImGui::TextUnformatted("Chunk sizes:");
+                    for (int i = 0; i < PERF_CHUNK_HISTOGRAM_SIZE; i++) {
+                        if (!row.chunkSizes[i]) { continue; }
+                        ImGui::Text("%s%llu: %llu", (i == PERF_CHUNK_HISTOGRAM_SIZE - 1) ? ">=" : "", 1ULL << i, (unsigned long long)row.chunkSizes[i]);
+                    }
+                    ImGui::EndTooltip();
+                }
+
+                ImGui::TableSetColumnIndex(1);
+                drawLoad(row.cpu, 80.0f);
+
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%.3f", row.inRate);
+
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%.3f", row.outRate);
+
+                // Starvation is normal for light blocks, only long waits on the output mean something is too slow downstream
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%.1f%%", row.starved);
+
+                ImGui::TableSetColumnIndex(5);
+                drawLoad(row.backpressure, 10.0f);
+
+                // Average time parameter changes waited in the mailbox, only shown if there were some
+                ImGui::TableSetColumnIndex(6);
+                if (row.updateLatency >= 0.0f) {
+                    ImGui::Text("%.3f", row.updateLatency);
+                }
+            }
+
+            ImGui::EndTable();
+        }
+    }
+}
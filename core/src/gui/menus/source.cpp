@@ -18,6 +18,11 @@ namespace sourcemenu {
     int decimId = 0;
     OptionList<int, int> decimations;
 
+    int vfoChannelsId = 0;
+    OptionList<int, int> vfoChannels;
+
+    float bufferDepth = FRAME_BUFFER_DEFAULT_DEPTH;
+
     bool iqCorrection = false;
     bool invertIQ = false;
 
@@ -167,6 +172,14 @@ namespace sourcemenu {
         decimations.define(32, "32x", 32);
         decimations.define(64, "64x", 64);
 
+        // Define VFO channelizer sizes
+        vfoChannels.define(0, "Off", 0);
+        vfoChannels.define(16, "16", 16);
+        vfoChannels.define(32, "32", 32);
+        vfoChannels.define(64, "64", 64);
+        vfoChannels.define(128, "128", 128);
+        vfoChannels.define(256, "256", 256);
+
         // Acquire the config file
         core::configManager.acquire();
 
@@ -176,10 +189,15 @@ namespace sourcemenu {
         std::string selectedOffset = core::configManager.conf["selectedOffset"];
         iqCorrection = core::configManager.conf["iqCorrection"];
         invertIQ = core::configManager.conf["invertIQ"];
+        bufferDepth = core::configManager.conf["inputBufferDepth"];
         int decimation = core::configManager.conf["decimation"];
         if (decimations.keyExists(decimation)) {
             decimId = decimations.keyId(decimation);
         }
+        int channels = core::configManager.conf["vfoChannels"];
+        if (vfoChannels.keyExists(channels)) {
+            vfoChannelsId = vfoChannels.keyId(channels);
+        }
 
         // Release the config file
         core::configManager.release();
@@ -192,6 +210,8 @@ namespace sourcemenu {
         sigpath::iqFrontEnd.setDCBlocking(iqCorrection);
         sigpath::iqFrontEnd.setInvertIQ(invertIQ);
         sigpath::iqFrontEnd.setDecimation(decimations.value(decimId));
+        sigpath::iqFrontEnd.setBufferDepth(bufferDepth);
+        sigpath::iqFrontEnd.setVFOChannels(vfoChannels.value(vfoChannelsId));
         selectOffsetByName(selectedOffset);
 
         // Register handlers
@@ -374,5 +394,34 @@ namespace sourcemenu {
             core::configManager.release(true);
         }
         if (running) { style::endDisabled(); }
+
+        // Splitting the band once for all VFOs pays off with many narrow VFOs
+        ImGui::LeftLabel("VFO channels");
+        ImGui::FillWidth();
+        if (ImGui::Combo("##source_vfo_channels", &vfoChannelsId, vfoChannels.txt)) {
+            sigpath::iqFrontEnd.setVFOChannels(vfoChannels.value(vfoChannelsId));
+            core::configManager.acquire();
+            core::configManager.conf["vfoChannels"] = vfoChannels.key(vfoChannelsId);
+            core::configManager.release(true);
+        }
+
+        ImGui::LeftLabel("Buffer depth");
+        ImGui::FillWidth();
+        if (ImGui::SliderFloat("##source_buffer_depth", &bufferDepth, 10.0f, 2000.0f, "%.0f ms")) {
+            sigpath::iqFrontEnd.setBufferDepth(bufferDepth);
+            core::configManager.acquire();
+            core::configManager.conf["inputBufferDepth"] = bufferDepth;
+            core::configManager.release(true);
+        }
+
+        // Input buffer counters, to help size the buffer for the device
+        auto stats = sigpath::iqFrontEnd.getInputBufferStats();
+        double sr = sigpath::iqFrontEnd.getSampleRate() * decimations.value(decimId);
+        double peakMs = (sr > 0) ? (1000.0 * stats.highWater / sr) : 0.0;
+        ImGui::TextDisabled("Peak %.0f ms, %llu overruns (%llu samples)", peakMs, (unsigned long long)stats.overruns, (unsigned long long)stats.droppedSamples);
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Reset##source_buffer_reset")) {
+            sigpath::iqFrontEnd.resetInputBufferStats();
+        }
     }
 }
@@ -4,6 +4,7 @@
 #include <imutils.h>
 #include <algorithm>
 #include <volk/volk.h>
+#include <dsp/kernel/kernels.h>
 #include <utils/flog.h>
 #include <gui/gui.h>
 #include <gui/style.h>
@@ -75,16 +76,12 @@ inline void doZoom(int offset, int width, int inSize, int outSize, float* in, fl
     float sFactor = ceilf(factor);
     float uFactor;
     float id = offset;
-    float maxVal;
     int sId;
+    auto maximum = dsp::kernel::maximum().get(sFactor);
     for (int i = 0; i < outSize; i++) {
-        maxVal = -INFINITY;
         sId = (int)id;
         uFactor = (sId + sFactor > inSize) ? sFactor - ((sId + sFactor) - inSize) : sFactor;
-        for (int j = 0; j < uFactor; j++) {
-            if (in[sId + j] > maxVal) { maxVal = in[sId + j]; }
-        }
-        out[i] = maxVal;
+        out[i] = maximum(&in[sId], uFactor);
         id += factor;
     }
 }
@@ -606,18 +603,14 @@ namespace ImGui {
         int drawDataStart;
         // TODO: Maybe put on the stack for faster alloc?
         float* tempData = new float[dataWidth];
-        float pixel;
-        float dataRange = waterfallMax - waterfallMin;
+        auto palette = dsp::kernel::palette().get(dataWidth);
         int count = std::min<float>(waterfallHeight, fftLines);
         if (rawFFTs != NULL && fftLines >= 0) {
             for (int i = 0; i < count; i++) {
                 drawDataSize = (viewBandwidth / wholeBandwidth) * rawFFTSize;
                 drawDataStart = (((double)rawFFTSize / 2.0) * (offsetRatio + 1)) - (drawDataSize / 2);
                 doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, &rawFFTs[((i + currentFFTLine) % waterfallHeight) * rawFFTSize], tempData);
-                for (int j = 0; j < dataWidth; j++) {
-                    pixel = (std::clamp<float>(tempData[j], waterfallMin, waterfallMax) - waterfallMin) / dataRange;
-                    waterfallFb[(i * dataWidth) + j] = waterfallPallet[(int)(pixel * (WATERFALL_RESOLUTION - 1))];
-                }
+                palette(tempData, &waterfallFb[i * dataWidth], dataWidth, waterfallMin, waterfallMax, waterfallPallet, WATERFALL_RESOLUTION);
             }
 
             for (int i = count; i < waterfallHeight; i++) {
@@ -896,13 +889,7 @@ namespace ImGui {
         if (waterfallVisible) {
             doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, &rawFFTs[currentFFTLine * rawFFTSize], latestFFT);
             memmove(&waterfallFb[dataWidth], waterfallFb, dataWidth * (waterfallHeight - 1) * sizeof(uint32_t));
-            float pixel;
-            float dataRange = waterfallMax - waterfallMin;
-            for (int j = 0; j < dataWidth; j++) {
-                pixel = (std::clamp<float>(latestFFT[j], waterfallMin, waterfallMax) - waterfallMin) / dataRange;
-                int id = (int)(pixel * (WATERFALL_RESOLUTION - 1));
-                waterfallFb[j] = waterfallPallet[id];
-            }
+            dsp::kernel::palette().get(dataWidth)(latestFFT, waterfallFb, dataWidth, waterfallMin, waterfallMax, waterfallPallet, WATERFALL_RESOLUTION);
             waterfallUpdate = true;
         }
         else {
@@ -1,6 +1,7 @@
 #include <module.h>
 #include <filesystem>
 #include <utils/flog.h>
+#include <dsp/buffer/pool.h>
 
 ModuleManager::Module_t ModuleManager::loadModule(std::string path) {
     Module_t mod;
@@ -99,7 +100,10 @@ int ModuleManager::createInstance(std::string name, std::string module) {
     }
     Instance_t inst;
     inst.module = modules[module];
-    inst.instance = inst.module.createInstance(name);
+    {
+        dsp::buffer::pool::Scope scope("Module " + name);
+        inst.instance = inst.module.createInstance(name);
+    }
     instances[name] = inst;
     onInstanceCreated.emit(name);
     return 0;
@@ -128,6 +132,7 @@ int ModuleManager::enableInstance(std::string name) {
         flog::error("Cannot enable '{0}', instance doesn't exist", name);
         return -1;
     }
+    dsp::buffer::pool::Scope scope("Module " + name);
     instances[name].instance->enable();
     return 0;
 }
@@ -154,6 +159,7 @@ void ModuleManager::postInit(std::string name) {
         flog::error("Cannot post-init '{0}', instance doesn't exist", name);
         return;
     }
+    dsp::buffer::pool::Scope scope("Module " + name);
     instances[name].instance->postInit();
 }
 
@@ -181,6 +187,7 @@ int ModuleManager::countModuleInstances(std::string module) {
 void ModuleManager::doPostInitAll() {
     for (auto& [name, inst] : instances) {
         flog::info("Running post-init for {0}", name);
+        dsp::buffer::pool::Scope scope("Module " + name);
         inst.instance->postInit();
     }
 }
@@ -8,13 +8,15 @@
 IQFrontEnd::~IQFrontEnd() {
     if (!_init) { return; }
     stop();
+    delete chan;
+    delete chanIn;
     dsp::buffer::free(fftWindowBuf);
-    fftwf_destroy_plan(fftwPlan);
+    fftPlan.destroy();
     fftwf_free(fftInBuf);
     fftwf_free(fftOutBuf);
 }
 
-void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool buffering, int decimRatio, bool dcBlocking, int fftSize, double fftRate, FFTWindow fftWindow, float* (*acquireFFTBuffer)(void* ctx), void (*releaseFFTBuffer)(void* ctx), void* fftCtx) {
+void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool buffering, double bufferDepth, int decimRatio, bool dcBlocking, int fftSize, double fftRate, FFTWindow fftWindow, float* (*acquireFFTBuffer)(void* ctx), void (*releaseFFTBuffer)(void* ctx), void* fftCtx) {
     _sampleRate = sampleRate;
     _decimRatio = decimRatio;
     _fftSize = fftSize;
@@ -26,20 +28,27 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
 
     effectiveSr = _sampleRate / _decimRatio;
 
-    inBuf.init(in);
-    inBuf.bypass = !buffering;
+    inBuf.init(in, _sampleRate, bufferDepth);
+    inBuf.setBypass(!buffering);
 
     decim.init(NULL, _decimRatio);
+    decim.setThreadCount(genDecimThreads(_sampleRate));
+    rawDecim.init(NULL, _decimRatio, 32768.0f);
+    rawDecim.setThreadCount(genDecimThreads(_sampleRate));
     dcBlock.init(NULL, genDCBlockRate(effectiveSr));
     conjugate.init(NULL);
 
     preproc.init(&inBuf.out);
+    preproc.setFused(true, [](dsp::stream<dsp::complex_t>* out){});
     preproc.addBlock(&decim, _decimRatio > 1);
     preproc.addBlock(&dcBlock, dcBlocking);
     preproc.addBlock(&conjugate, false); // TODO: Replace by parameter
 
     split.init(preproc.out);
 
+    // All IQ consumers only read their input, so they can share the same buffers instead of getting a copy each
+    split.setSharedMode(true);
+
     // TODO: Do something to avoid basically repeating this code twice
     int skip;
     genReshapeParams(effectiveSr, _fftSize, _fftRate, skip, _nzFFTSize);
@@ -59,7 +68,7 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
 
     fftInBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
     fftOutBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
-    fftwPlan = fftwf_plan_dft_1d(_fftSize, fftInBuf, fftOutBuf, FFTW_FORWARD, FFTW_ESTIMATE);
+    fftPlan.create(dsp::fft::FORWARD, _fftSize, fftInBuf, fftOutBuf);
 
     // Clear the rest of the FFT input buffer
     dsp::buffer::clear(fftInBuf, _fftSize - _nzFFTSize, _nzFFTSize);
@@ -70,9 +79,30 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
 }
 
 void IQFrontEnd::setInput(dsp::stream<dsp::complex_t>* in) {
+    // Move the decimation back to the pre-processing chain
+    if (rawInput) {
+        rawDecim.stop();
+        rawInput = false;
+        inBuf.setSamplerate(_sampleRate);
+        preproc.setBlockEnabled(&decim, _decimRatio > 1, [=](dsp::stream<dsp::complex_t>* out){ split.setInput(out); });
+    }
     inBuf.setInput(in);
 }
 
+void IQFrontEnd::setInput(dsp::stream<dsp::complex16_t>* in, float scale) {
+    rawDecim.setInput(in);
+    rawDecim.setScale(scale);
+    if (rawInput) { return; }
+
+    // The raw decimator does all of the decimation, the input buffer then works at the decimated rate
+    rawInput = true;
+    rawDecim.setRatio(_decimRatio);
+    preproc.setBlockEnabled(&decim, false, [=](dsp::stream<dsp::complex_t>* out){ split.setInput(out); });
+    inBuf.setSamplerate(effectiveSr);
+    inBuf.setInput(&rawDecim.out);
+    if (running) { rawDecim.start(); }
+}
+
 void IQFrontEnd::setSampleRate(double sampleRate) {
     // Temp stop the necessary blocks
     dcBlock.tempStop();
@@ -83,6 +113,9 @@ void IQFrontEnd::setSampleRate(double sampleRate) {
     // Update the samplerate
     _sampleRate = sampleRate;
     effectiveSr = _sampleRate / _decimRatio;
+    inBuf.setSamplerate(rawInput ? effectiveSr : _sampleRate);
+    decim.setThreadCount(genDecimThreads(_sampleRate));
+    rawDecim.setThreadCount(genDecimThreads(_sampleRate));
     dcBlock.setRate(genDCBlockRate(effectiveSr));
     for (auto& [name, vfo] : vfos) {
         vfo->setInSamplerate(effectiveSr);
@@ -99,7 +132,19 @@ void IQFrontEnd::setSampleRate(double sampleRate) {
 }
 
 void IQFrontEnd::setBuffering(bool enabled) {
-    inBuf.bypass = !enabled;
+    inBuf.setBypass(!enabled);
+}
+
+void IQFrontEnd::setBufferDepth(double depth) {
+    inBuf.setDepth(depth);
+}
+
+dsp::buffer::SampleFrameBuffer<dsp::complex_t>::Stats IQFrontEnd::getInputBufferStats() {
+    return inBuf.getStats();
+}
+
+void IQFrontEnd::resetInputBufferStats() {
+    inBuf.resetStats();
 }
 
 void IQFrontEnd::setDecimation(int ratio) {
@@ -109,13 +154,14 @@ void IQFrontEnd::setDecimation(int ratio) {
     // Update the decimation ratio
     _decimRatio = ratio;
     if (_decimRatio > 1) { decim.setRatio(_decimRatio); }
+    rawDecim.setRatio(_decimRatio);
     setSampleRate(_sampleRate);
 
     // Restart the decimator if it was running
     decim.tempStart();
 
-    // Enable or disable in the chain
-    preproc.setBlockEnabled(&decim, _decimRatio > 1, [=](dsp::stream<dsp::complex_t>* out){ split.setInput(out); });
+    // Enable or disable in the chain, the raw decimator takes care of it with fixed-point input
+    preproc.setBlockEnabled(&decim, _decimRatio > 1 && !rawInput, [=](dsp::stream<dsp::complex_t>* out){ split.setInput(out); });
 
     // Update the DSP sample rate (TODO: Find a way to get rid of this)
     core::setInputSampleRate(_sampleRate);
@@ -144,14 +190,24 @@ dsp::channel::RxVFO* IQFrontEnd::addVFO(std::string name, double sampleRate, dou
         return NULL;
     }
 
-    // Create VFO and its input stream
-    dsp::stream<dsp::complex_t>* vfoIn = new dsp::stream<dsp::complex_t>;
+    // Account everything the VFO allocates to it
+    dsp::buffer::pool::Scope scope("VFO " + name);
+
+    // Create VFO and its input stream, with a few extra slots so that a slow VFO doesn't stall the splitter.
+    // The splitter grows the stream to the size of the chunks it gets, and doesn't use it at all in shared mode.
+    dsp::stream<dsp::complex_t>* vfoIn = new dsp::stream<dsp::complex_t>(VFO_STREAM_SLOT_COUNT, STREAM_MIN_BUFFER_SIZE);
     dsp::channel::RxVFO* vfo = new dsp::channel::RxVFO(vfoIn, effectiveSr, sampleRate, bandwidth, offset);
 
     // Register them
     vfoStreams[name] = vfoIn;
     vfos[name] = vfo;
-    bindIQStream(vfoIn);
+    if (chan) {
+        chan->bindStream(vfoIn);
+        vfo->setChannelizer(chan);
+    }
+    else {
+        bindIQStream(vfoIn);
+    }
 
     // Start VFO
     vfo->start();
@@ -173,7 +229,12 @@ void IQFrontEnd::removeVFO(std::string name) {
     // Stop the VFO
     vfo->stop();
 
-    unbindIQStream(vfoIn);
+    if (chan) {
+        chan->unbindStream(vfoIn);
+    }
+    else {
+        unbindIQStream(vfoIn);
+    }
     vfoStreams.erase(name);
     vfos.erase(name);
 
@@ -182,6 +243,45 @@ void IQFrontEnd::removeVFO(std::string name) {
     delete vfoIn;
 }
 
+void IQFrontEnd::setVFOChannels(int count) {
+    if (count == _vfoChannels) { return; }
+
+    // Move the VFOs back to the splitter and delete the current channelizer
+    if (chan) {
+        for (auto& [name, vfo] : vfos) {
+            vfo->tempStop();
+            vfo->setChannelizer(NULL);
+            chan->unbindStream(vfoStreams[name]);
+            bindIQStream(vfoStreams[name]);
+            vfo->tempStart();
+        }
+        unbindIQStream(chanIn);
+        delete chan;
+        delete chanIn;
+        chan = NULL;
+        chanIn = NULL;
+    }
+
+    _vfoChannels = count;
+    if (!_vfoChannels) { return; }
+
+    // Account everything the channelizer allocates to it
+    dsp::buffer::pool::Scope scope("VFO channelizer");
+
+    // Create the channelizer and move the VFOs to it, it only reads its input like the VFOs
+    chanIn = new dsp::stream<dsp::complex_t>(VFO_STREAM_SLOT_COUNT, STREAM_MIN_BUFFER_SIZE);
+    chan = new dsp::channel::Channelizer(chanIn, _vfoChannels);
+    bindIQStream(chanIn);
+    for (auto& [name, vfo] : vfos) {
+        vfo->tempStop();
+        unbindIQStream(vfoStreams[name]);
+        chan->bindStream(vfoStreams[name]);
+        vfo->setChannelizer(chan);
+        vfo->tempStart();
+    }
+    chan->start();
+}
+
 void IQFrontEnd::setFFTSize(int size) {
     _fftSize = size;
     updateFFTPath(true);
@@ -202,7 +302,8 @@ void IQFrontEnd::flushInputBuffer() {
 }
 
 void IQFrontEnd::start() {
-    // Start input buffer
+    // Start the decimator of fixed-point input and the input buffer
+    if (rawInput) { rawDecim.start(); }
     inBuf.start();
 
     // Start pre-proc chain (automatically start all bound blocks)
@@ -211,7 +312,8 @@ void IQFrontEnd::start() {
     // Start IQ splitter
     split.start();
 
-    // Start all VFOs
+    // Start the VFO channelizer and all VFOs
+    if (chan) { chan->start(); }
     for (auto& [name, vfo] : vfos) {
         vfo->start();
     }
@@ -219,10 +321,13 @@ void IQFrontEnd::start() {
     // Start FFT chain
     reshape.start();
     fftSink.start();
+
+    running = true;
 }
 
 void IQFrontEnd::stop() {
-    // Stop input buffer
+    // Stop the decimator of fixed-point input and the input buffer
+    rawDecim.stop();
     inBuf.stop();
 
     // Stop pre-proc chain (automatically start all bound blocks)
@@ -231,7 +336,8 @@ void IQFrontEnd::stop() {
     // Stop IQ splitter
     split.stop();
 
-    // Stop all VFOs
+    // Stop the VFO channelizer and all VFOs
+    if (chan) { chan->stop(); }
     for (auto& [name, vfo] : vfos) {
         vfo->stop();
     }
@@ -239,6 +345,8 @@ void IQFrontEnd::stop() {
     // Stop FFT chain
     reshape.stop();
     fftSink.stop();
+
+    running = false;
 }
 
 double IQFrontEnd::getEffectiveSamplerate() {
@@ -252,7 +360,7 @@ void IQFrontEnd::handler(dsp::complex_t* data, int count, void* ctx) {
     volk_32fc_32f_multiply_32fc((lv_32fc_t*)_this->fftInBuf, (lv_32fc_t*)data, _this->fftWindowBuf, _this->_nzFFTSize);
 
     // Execute FFT
-    fftwf_execute(_this->fftwPlan);
+    _this->fftPlan.execute((dsp::complex_t*)_this->fftInBuf, (dsp::complex_t*)_this->fftOutBuf);
 
     // Aquire buffer
     float* fftBuf = _this->_acquireFFTBuffer(_this->_fftCtx);
@@ -290,12 +398,12 @@ void IQFrontEnd::updateFFTPath(bool updateWaterfall) {
         for (int i = 0; i < _nzFFTSize; i++) { fftWindowBuf[i] = dsp::window::nuttall(i, _nzFFTSize) * ((i % 2) ? -1.0f : 1.0f); }
     }
 
-    // Update FFT plan
+    // Update FFT plan, the previous one is released to the plan cache
     fftwf_free(fftInBuf);
     fftwf_free(fftOutBuf);
     fftInBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
     fftOutBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
-    fftwPlan = fftwf_plan_dft_1d(_fftSize, fftInBuf, fftOutBuf, FFTW_FORWARD, FFTW_ESTIMATE);
+    fftPlan.create(dsp::fft::FORWARD, _fftSize, fftInBuf, fftOutBuf);
 
     // Clear the rest of the FFT input buffer
     dsp::buffer::clear(fftInBuf, _fftSize - _nzFFTSize, _nzFFTSize);
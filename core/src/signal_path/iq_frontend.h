@@ -2,14 +2,24 @@
 #include "../dsp/buffer/frame_buffer.h"
 #include "../dsp/buffer/reshaper.h"
 #include "../dsp/multirate/power_decimator.h"
+#include "../dsp/multirate/raw_decimator.h"
 #include "../dsp/correction/dc_blocker.h"
 #include "../dsp/chain.h"
 #include "../dsp/routing/splitter.h"
 #include "../dsp/channel/rx_vfo.h"
 #include "../dsp/sink/handler_sink.h"
 #include "../dsp/math/conjugate.h"
+#include "../dsp/fft/plan.h"
 #include <fftw3.h>
 
+#define VFO_STREAM_SLOT_COUNT   4
+
+// Input samplerate a single thread of the decimator is given, faster inputs are decimated by several threads
+#define IQFRONTEND_DECIM_RATE_PER_THREAD    40e6
+
+// Most threads used by the decimator
+#define IQFRONTEND_DECIM_MAX_THREADS        4
+
 class IQFrontEnd {
 public:
     ~IQFrontEnd();
@@ -20,23 +30,39 @@ public:
         NUTTALL
     };
 
-    void init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool buffering, int decimRatio, bool dcBlocking, int fftSize, double fftRate, FFTWindow fftWindow, float* (*acquireFFTBuffer)(void* ctx), void (*releaseFFTBuffer)(void* ctx), void* fftCtx);
+    void init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool buffering, double bufferDepth, int decimRatio, bool dcBlocking, int fftSize, double fftRate, FFTWindow fftWindow, float* (*acquireFFTBuffer)(void* ctx), void (*releaseFFTBuffer)(void* ctx), void* fftCtx);
 
     void setInput(dsp::stream<dsp::complex_t>* in);
+
+    // Take 16bit samples instead, scale being the value of a full scale sample. They're converted while decimating.
+    void setInput(dsp::stream<dsp::complex16_t>* in, float scale);
     void setSampleRate(double sampleRate);
     inline double getSampleRate() { return _sampleRate / _decimRatio; }
 
     void setBuffering(bool enabled);
+    void setBufferDepth(double depth);
+    dsp::buffer::SampleFrameBuffer<dsp::complex_t>::Stats getInputBufferStats();
+    void resetInputBufferStats();
     void setDecimation(int ratio);
     void setInvertIQ(bool enabled);
     void setDCBlocking(bool enabled);
 
+    // The buffers read from a bound IQ stream are shared with the other consumers and must not be modified
     void bindIQStream(dsp::stream<dsp::complex_t>* stream);
     void unbindIQStream(dsp::stream<dsp::complex_t>* stream);
+    inline int getIQStreamLag(dsp::stream<dsp::complex_t>* stream) { return split.getLag(stream); }
 
     dsp::channel::RxVFO* addVFO(std::string name, double sampleRate, double bandwidth, double offset);
     void removeVFO(std::string name);
 
+    /**
+     * Feed the VFOs from a polyphase channelizer splitting the band into the given number of channels,
+     * or feed each of them the whole band if 0. With many narrow VFOs, the channelizer replaces the
+     * full rate translation and decimation of each VFO by a single filter bank shared by all of them.
+     */
+    void setVFOChannels(int count);
+    inline int getVFOChannels() { return _vfoChannels; }
+
     void setFFTSize(int size);
     void setFFTRate(double rate);
     void setFFTWindow(FFTWindow fftWindow);
@@ -56,12 +82,23 @@ protected:
         return 50.0 / sampleRate;
     }
 
+    // One thread per IQFRONTEND_DECIM_RATE_PER_THREAD of input, keeping a core for the rest of the DSP
+    static inline int genDecimThreads(double sampleRate) {
+        int cores = std::max<int>(std::thread::hardware_concurrency(), 1);
+        int threads = ceil(sampleRate / IQFRONTEND_DECIM_RATE_PER_THREAD);
+        return std::clamp<int>(threads, 1, std::min<int>(IQFRONTEND_DECIM_MAX_THREADS, std::max<int>(cores - 1, 1)));
+    }
+
     static inline void genReshapeParams(double sampleRate, int size, double rate, int& skip, int& nzSampCount) {
         int fftInterval = round(sampleRate / rate);
         nzSampCount = std::min<int>(fftInterval, size);
         skip = fftInterval - nzSampCount;
     }
 
+    // Decimation of fixed-point input, done before the input buffer instead of by the pre-processing chain
+    dsp::multirate::RawDecimator<dsp::complex16_t> rawDecim;
+    bool rawInput = false;
+
     // Input buffer
     dsp::buffer::SampleFrameBuffer<dsp::complex_t> inBuf;
 
@@ -83,6 +120,11 @@ protected:
     std::map<std::string, dsp::stream<dsp::complex_t>*> vfoStreams;
     std::map<std::string, dsp::channel::RxVFO*> vfos;
 
+    // VFO channelizer, feeding the VFOs instead of the splitter when enabled
+    dsp::stream<dsp::complex_t>* chanIn = NULL;
+    dsp::channel::Channelizer* chan = NULL;
+    int _vfoChannels = 0;
+
     // Parameters
     double _sampleRate;
     double _decimRatio;
@@ -97,11 +139,12 @@ protected:
     int _nzFFTSize;
     float* fftWindowBuf;
     fftwf_complex *fftInBuf, *fftOutBuf;
-    fftwf_plan fftwPlan;
+    dsp::fft::Plan fftPlan;
     float* fftDbOut;
 
     double effectiveSr;
 
     bool _init = false;
+    bool running = false;
 
 };
\ No newline at end of file
@@ -27,6 +27,7 @@ void SourceManager::unregisterSource(std::string name) {
             sources[selectedName]->deselectHandler(sources[selectedName]->ctx);
         }
         sigpath::iqFrontEnd.setInput(&nullSource);
+        serverConv.stop();
         selectedHandler = NULL;
     }
     sources.erase(name);
@@ -50,13 +51,7 @@ void SourceManager::selectSource(std::string name) {
     selectedHandler = sources[name];
     selectedHandler->selectHandler(selectedHandler->ctx);
     selectedName = name;
-    if (core::args["server"].b()) {
-        server::setInput(selectedHandler->stream);
-    }
-    else {
-        sigpath::iqFrontEnd.setInput(selectedHandler->stream);
-    }
-    // Set server input here
+    connectInput();
 }
 
 void SourceManager::showSelectedMenu() {
@@ -70,6 +65,9 @@ void SourceManager::start() {
     if (selectedHandler == NULL) {
         return;
     }
+
+    // The source may write to another stream than last time
+    connectInput();
     selectedHandler->startHandler(selectedHandler->ctx);
 }
 
@@ -80,6 +78,35 @@ void SourceManager::stop() {
     selectedHandler->stopHandler(selectedHandler->ctx);
 }
 
+void SourceManager::connectInput() {
+    if (!serverConvInit) {
+        serverConv.init(NULL, 1, 32768.0f);
+        serverConvInit = true;
+    }
+
+    // The server only takes complex_t, so fixed-point samples are converted for it
+    if (core::args["server"].b()) {
+        if (selectedHandler->rawStream) {
+            serverConv.setInput(selectedHandler->rawStream);
+            serverConv.setScale(selectedHandler->rawScale);
+            server::setInput(&serverConv.out);
+            serverConv.start();
+        }
+        else {
+            serverConv.stop();
+            server::setInput(selectedHandler->stream);
+        }
+        return;
+    }
+
+    if (selectedHandler->rawStream) {
+        sigpath::iqFrontEnd.setInput(selectedHandler->rawStream, selectedHandler->rawScale);
+    }
+    else {
+        sigpath::iqFrontEnd.setInput(selectedHandler->stream);
+    }
+}
+
 void SourceManager::tune(double freq) {
     if (selectedHandler == NULL) {
         return;
@@ -4,6 +4,7 @@
 #include <map>
 #include <dsp/stream.h>
 #include <dsp/types.h>
+#include <dsp/multirate/raw_decimator.h>
 #include <utils/event.h>
 
 class SourceManager {
@@ -19,6 +20,11 @@ public:
         void (*stopHandler)(void* ctx);
         void (*tuneHandler)(double freq, void* ctx);
         void* ctx;
+
+        // Optional stream of 16bit samples, set by sources able to write to it instead of stream. It's checked
+        // when the source is started, the samples are then converted by the front end while it decimates them.
+        dsp::stream<dsp::complex16_t>* rawStream = NULL;
+        float rawScale = 32768.0f;  // Value of a full scale sample
     };
 
     enum TuningMode {
@@ -45,6 +51,9 @@ public:
     Event<double> onRetune;
 
 private:
+    // Connect the front end or the server to the stream the selected source writes to
+    void connectInput();
+
     std::map<std::string, SourceHandler*> sources;
     std::string selectedName;
     SourceHandler* selectedHandler = NULL;
@@ -53,4 +62,8 @@ private:
     double ifFreq = 0.0;
     TuningMode tuneMode = TuningMode::NORMAL;
     dsp::stream<dsp::complex_t> nullSource;
+
+    // Conversion of fixed-point samples for the server, which only takes complex_t
+    dsp::multirate::RawDecimator<dsp::complex16_t> serverConv;
+    bool serverConvInit = false;
 };
\ No newline at end of file
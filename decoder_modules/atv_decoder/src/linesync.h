@@ -227,6 +227,9 @@ public:
     bool fastLock = true;
 
 protected:
+    // Several lines can be sent per run, so this block needs its own thread
+    bool schedulable() { return false; }
+
     void generateInterpTaps() {
         double bw = 0.5 / (double)_interpPhaseCount;
         dsp::tap<float> lp = dsp::taps::windowedSinc<float>(_interpPhaseCount * _interpTapCount, dsp::math::hzToRads(bw, 1.0), dsp::window::nuttall, _interpPhaseCount);
@@ -1,7 +1,7 @@
 #pragma once
 #include <dsp/processor.h>
 #include <utils/flog.h>
-#include <fftw3.h>
+#include <dsp/fft/plan.h>
 #include "dab_phase_sym.h"
 
 namespace dab {
@@ -116,6 +116,9 @@ namespace dab {
         }
 
     protected:
+        // Several symbols can be sent per run, so this block needs its own thread
+        bool schedulable() { return false; }
+
         int symbolSamps;
         int prefixSamps;
 
@@ -157,7 +160,7 @@ namespace dab {
             memcpy(conjRef, DAB_PHASE_SYM_CONJ, 2048 * sizeof(dsp::complex_t));
 
             // Plan the FFT computation
-            plan = fftwf_plan_dft_1d(2048, (fftwf_complex*)corrIn, (fftwf_complex*)corrOut, FFTW_FORWARD, FFTW_ESTIMATE);
+            plan.create(dsp::fft::FORWARD, 2048, corrIn, corrOut);
 
             // Compute the correlation AGC configuration
             this->agcRate = agcRate;
@@ -214,7 +217,7 @@ namespace dab {
             if (sym == 1) {
                 // Output the symbols (DEBUG ONLY)
                 memcpy(corrIn, _in->readBuf, 2048 * sizeof(dsp::complex_t));
-                fftwf_execute(plan);
+                plan.execute(corrIn, corrOut);
                 volk_32fc_magnitude_32f(amps, (lv_32fc_t*)corrOut, 2048);
                 int outCount = 0;
                 dsp::complex_t pi4 = { cos(3.1415926535*0.25), sin(3.1415926535*0.25) };
@@ -230,7 +233,7 @@ namespace dab {
                 volk_32fc_x2_multiply_32fc((lv_32fc_t*)corrIn, (lv_32fc_t*)_in->readBuf, (lv_32fc_t*)conjRef, 2048);
             
                 // Compute the FFT of the product
-                fftwf_execute(plan);
+                plan.execute(corrIn, corrOut);
 
                 // Compute the amplitude of the bins
                 volk_32fc_magnitude_32f(amps, (lv_32fc_t*)corrOut, 2048);
@@ -263,7 +266,7 @@ namespace dab {
         }
 
     protected:
-        fftwf_plan plan;
+        dsp::fft::Plan plan;
 
         float* amps;
         dsp::complex_t* conjRef;
@@ -107,6 +107,9 @@ namespace dsp {
         stream<uint8_t> out;
 
     private:
+        // Several packets can be sent per run, so this block needs its own thread
+        bool schedulable() { return false; }
+
         int count;
         uint32_t lastCounter = 0;
 
@@ -264,6 +264,10 @@ namespace dsp {
         stream<uint8_t> streamOut;
         stream<uint8_t> packetOut;
 
+    protected:
+        // Several frames can be sent per run, so this block needs its own thread
+        bool schedulable() { return false; }
+
     private:
         stream<uint8_t>* _in;
 
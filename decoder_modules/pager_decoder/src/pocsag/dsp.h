@@ -37,9 +37,10 @@ public:
     }
 
     int process(int count, dsp::complex_t* in, float* softOut, uint8_t* out) {
-        count = demod.process(count, in, demod.out.readBuf);
-        count = fir.process(count, demod.out.readBuf, demod.out.readBuf);
-        count = recov.process(count, demod.out.readBuf, softOut);
+        demod.out.reserve(count);
+        count = demod.process(count, in, demod.out.writeBuf);
+        count = fir.process(count, demod.out.writeBuf, demod.out.writeBuf);
+        count = recov.process(count, demod.out.writeBuf, softOut);
         dsp::digital::BinarySlicer::process(count, softOut, out);
         return count;
     }
@@ -69,6 +69,7 @@ public:
         ifChainOutputChanged.ctx = this;
         ifChainOutputChanged.handler = ifChainOutputChangeHandler;
         ifChain.init(vfo->output);
+        ifChain.setFused(true, [](dsp::stream<dsp::complex_t>* out){});
 
         nb.init(NULL, 500.0 / 24000.0, 10.0);
         fmnr.init(NULL, 32);
@@ -80,6 +81,7 @@ public:
 
         // Initialize audio DSP chain
         afChain.init(&dummyAudioStream);
+        afChain.setFused(true, [](dsp::stream<dsp::stereo_t>* out){});
 
         resamp.init(NULL, 250000.0, 48000.0);
         deemp.init(NULL, 50e-6, 48000.0);
@@ -56,6 +56,9 @@ namespace ryfi {
     private:
         int run();
 
+        // Several frames can be sent per run, so this block needs its own thread
+        bool schedulable() { return false; }
+
         inline static constexpr int distance(uint64_t a, uint64_t b) {
             int dist = 0;
             for (int i = 0; i < 64; i++) {
@@ -43,6 +43,12 @@ namespace vor {
         }
         
         int process(dsp::complex_t* in, float* out, int count) {
+            // Make sure the outputs used as work buffers can hold the chunk
+            fmx.out.reserve(count);
+            fmd.out.reserve(count);
+            amv.out.reserve(amv.maxOutputCount(count));
+            fmv.out.reserve(fmv.maxOutputCount(count));
+
             // Demodulate the AM outer modulation
             volk_32fc_magnitude_32f(amd.out.writeBuf, (lv_32fc_t*)in, count);
             amr2c.process(count, amd.out.writeBuf, amr2c.out.writeBuf);
@@ -44,6 +44,7 @@ public:
         handler.stopHandler = stop;
         handler.tuneHandler = tune;
         handler.stream = &stream;
+        handler.rawStream = &rawStream;
         sigpath::sourceManager.registerSource("File", &handler);
     }
 
@@ -101,8 +102,10 @@ private:
         if (!_this->running) { return; }
         if (_this->reader == NULL) { return; }
         _this->stream.stopWriter();
+        _this->rawStream.stopWriter();
         _this->workerThread.join();
         _this->stream.clearWriteStop();
+        _this->rawStream.clearWriteStop();
         _this->running = false;
         _this->reader->rewind();
         flog::info("FileSourceModule '{0}': Stop!", _this->name);
@@ -148,22 +151,21 @@ private:
             }
         }
 
-        ImGui::Checkbox("Float32 Mode##_file_source", &_this->float32Mode);
+        // Int16 samples are given to the front end as is, it converts them while decimating
+        if (ImGui::Checkbox("Float32 Mode##_file_source", &_this->float32Mode)) {
+            _this->handler.rawStream = _this->float32Mode ? NULL : &_this->rawStream;
+        }
     }
 
     static void worker(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
         double sampleRate = std::max(_this->reader->getSampleRate(), (uint32_t)1);
         int blockSize = std::min((int)(sampleRate / 200.0f), (int)STREAM_BUFFER_SIZE);
-        int16_t* inBuf = new int16_t[blockSize * 2];
 
         while (true) {
-            _this->reader->readSamples(inBuf, blockSize * 2 * sizeof(int16_t));
-            volk_16i_s32f_convert_32f((float*)_this->stream.writeBuf, inBuf, 32768.0f, blockSize * 2);
-            if (!_this->stream.swap(blockSize)) { break; };
+            _this->reader->readSamples(_this->rawStream.writeBuf, blockSize * sizeof(dsp::complex16_t));
+            if (!_this->rawStream.swap(blockSize)) { break; };
         }
-
-        delete[] inBuf;
     }
 
     static void floatWorker(void* ctx) {
@@ -192,6 +194,7 @@ private:
     FileSelect fileSelect;
     std::string name;
     dsp::stream<dsp::complex_t> stream;
+    dsp::stream<dsp::complex16_t> rawStream;
     SourceManager::SourceHandler handler;
     WavReader* reader = NULL;
     bool running = false;
@@ -451,6 +451,8 @@ private:
     void worker() {
         // Select different processing depending on the mode
         if (port == PORT_RF && sampleRate >= 50e6) {
+            // The DDC isn't running, its output is filled directly
+            ddc.out.reserve(STREAM_BUFFER_SIZE);
             while (run) {
                 // Read samples
                 unsigned int sampCount = 0;
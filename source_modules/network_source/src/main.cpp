@@ -96,6 +96,7 @@ public:
         // Set menu IDs
         protoId = protocols.valueId(proto);
         sampTypeId = sampleTypes.valueId(sampType);
+        updateRawStream();
 
         sigpath::sourceManager.registerSource("Network", &handler);
     }
@@ -191,8 +192,10 @@ private:
 
         // Stop worker thread
         _this->stream.stopWriter();
+        _this->rawStream.stopWriter();
         if (_this->workerThread.joinable()) { _this->workerThread.join(); }
         _this->stream.clearWriteStop();
+        _this->rawStream.clearWriteStop();
 
         _this->running = false;
         flog::info("NetworkSourceModule '{0}': Stop!", _this->name);
@@ -242,6 +245,7 @@ private:
         SmGui::FillWidth();
         if (SmGui::Combo(("##network_source_samp_" + _this->name).c_str(), &_this->sampTypeId, _this->sampleTypes.txt)) {
             _this->sampType = _this->sampleTypes.value(_this->sampTypeId);
+            _this->updateRawStream();
             config.acquire();
             config.conf[_this->name]["sampleType"] = _this->sampleTypes.key(_this->sampTypeId);
             config.release(true);
@@ -273,6 +277,12 @@ private:
         if (_this->running) { SmGui::EndDisabled(); }
     }
 
+    // Int16 samples are given to the front end as is, it converts them while decimating
+    void updateRawStream() {
+        handler.rawStream = (sampType == SAMPLE_TYPE_INT16) ? &rawStream : NULL;
+        handler.rawScale = 32768.0f;
+    }
+
     void worker() {
         // Compute sizes
         int blockSize = samplerate / 200;
@@ -290,15 +300,19 @@ private:
             int bytes = sock->recv(buffer, frameSize, forceSize);
             if (bytes <= 0) { break; }
 
-            // Convert to CF32 (note: problem if partial sample)
+            // Int16 samples are sent out as is
             int count = bytes / sampleSize;
+            if (sampType == SAMPLE_TYPE_INT16) {
+                memcpy(rawStream.writeBuf, buffer, count * sampleSize);
+                if (!rawStream.swap(count)) { break; }
+                continue;
+            }
+
+            // Convert to CF32 (note: problem if partial sample)
             switch (sampType) {
             case SAMPLE_TYPE_INT8:
                 volk_8i_s32f_convert_32f((float*)stream.writeBuf, (int8_t*)buffer, 128.0f, count*2);
                 break;
-            case SAMPLE_TYPE_INT16:
-                volk_16i_s32f_convert_32f((float*)stream.writeBuf, (int16_t*)buffer, 32768.0f, count*2);
-                break;
             case SAMPLE_TYPE_INT32:
                 volk_32i_s32f_convert_32f((float*)stream.writeBuf, (int32_t*)buffer, 2147483647.0f, count*2);
                 break;
@@ -320,6 +334,7 @@ private:
     std::string name;
     bool enabled = true;
     dsp::stream<dsp::complex_t> stream;
+    dsp::stream<dsp::complex16_t> rawStream;
     SourceManager::SourceHandler handler;
     bool running = false;
     double freq;